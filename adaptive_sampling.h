@@ -0,0 +1,210 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkWeakPointer.h>
+#include <vtkObjectFactory.h>
+#include <vtkCommand.h>
+#include <vtkVolume.h>
+#include <vtkFixedPointVolumeRayCastMapper.h>
+#include <vtkGPUVolumeRayCastMapper.h>
+#include <vtkSmartVolumeMapper.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkInteractorObserver.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    struct SampleDistanceState
+    {
+        double frame_time = 0;    // last render time in seconds
+        double smoothed_time = 0; // exponential moving average of the render time
+        double target_time = 0;
+        double scale = 1; // quality scale, 1 is the configured full quality
+        double sample_distance = 0;
+        double image_sample_distance = 0;
+        int adjustments = 0;
+    };
+
+    std::ostream& operator<<(std::ostream& os, SampleDistanceState const& state)
+    {
+        return os << "frame " << state.frame_time * 1000 << " ms (smoothed " << state.smoothed_time * 1000
+                  << " ms, target " << state.target_time * 1000 << " ms), scale " << state.scale
+                  << ", sample distance " << state.sample_distance << ", image sample distance "
+                  << state.image_sample_distance << ", adjustments " << state.adjustments;
+    }
+
+    // Closed loop control of the sample distances of a volume's mapper from the renderer's last render time
+    // (the value the FPS overlays print), replacing the mapper's AutoAdjustSampleDistances.
+    // A single quality scale s >= 1 sets the sample distance to s times and the image sample distance to sqrt(s)
+    // times the configured ones, so the cost of a frame goes roughly with 1 / s^2. The render time is smoothed,
+    // nothing changes while it stays inside the dead band around the target (hysteresis), and after a change a
+    // few frames are left to settle before the next one, so the distances do not oscillate.
+    // With an interactor the controller only runs while the style is interacting and the configured quality is
+    // back for the render the style does when the interaction ends; the next interaction starts from the scale the
+    // last one settled on.
+    class MSampleDistanceController: public vtkCommand
+    {
+    public:
+        static MSampleDistanceController* New();
+        vtkTypeMacro(MSampleDistanceController, vtkCommand);
+
+        void Setup(vtkVolume* volume, vtkRenderer* renderer, vtkRenderWindowInteractor* interactor = nullptr,
+                   double target_seconds = 1.0 / 20)
+        {
+            m_volume = volume;
+            m_state.target_time = target_seconds;
+            if (!ReadMapper()) return;
+
+            renderer->AddObserver(vtkCommand::EndEvent, this);
+            m_interacting = interactor == nullptr;
+            if (interactor)
+            {
+                auto* style = interactor->GetInteractorStyle();
+                style->AddObserver(vtkCommand::StartInteractionEvent, this);
+                style->AddObserver(vtkCommand::EndInteractionEvent, this);
+            }
+        }
+
+        void SetMaximumScale(double scale) { m_max_scale = std::max(scale, 1.0); }
+
+        // print the state after every adjustment
+        void SetVerbose(bool verbose) { m_verbose = verbose; }
+
+        SampleDistanceState const& GetState() const { return m_state; }
+
+        void Execute(vtkObject* caller, unsigned long eventId, void*) override
+        {
+            if (!m_volume) return;
+            switch (eventId)
+            {
+            case vtkCommand::StartInteractionEvent:
+                m_interacting = true;
+                m_state.smoothed_time = 0;
+                Apply(m_interactive_scale);
+                break;
+            case vtkCommand::EndInteractionEvent:
+                m_interacting = false;
+                m_interactive_scale = m_state.scale;
+                // the style renders right after this event
+                if (m_state.scale != 1) Apply(1);
+                break;
+            case vtkCommand::EndEvent:
+                if (m_interacting) Update(static_cast<vtkRenderer*>(caller)->GetLastRenderTimeInSeconds());
+                break;
+            default:
+                break;
+            }
+        }
+
+    private:
+        static constexpr double smoothing = 0.3;  // weight of the newest frame
+        static constexpr double band_high = 1.15; // slower than target * band_high: coarser
+        static constexpr double band_low = 0.7;   // faster than target * band_low: finer
+        static constexpr double gain = 0.7;       // fraction of the estimated correction applied per step
+        static constexpr int settle_frames = 2;   // frames ignored after a change
+        static constexpr double max_image_sample_distance = 4;
+
+        // full quality distances are the ones the mapper has now
+        bool ReadMapper()
+        {
+            auto* mapper = m_volume->GetMapper();
+            if (auto* fixed = vtkFixedPointVolumeRayCastMapper::SafeDownCast(mapper))
+            {
+                fixed->AutoAdjustSampleDistancesOff();
+                m_sample_distance = fixed->GetSampleDistance();
+                m_image_sample_distance = fixed->GetImageSampleDistance();
+            }
+            else if (auto* gpu = vtkGPUVolumeRayCastMapper::SafeDownCast(mapper))
+            {
+                gpu->AutoAdjustSampleDistancesOff();
+                m_sample_distance = gpu->GetSampleDistance();
+                m_image_sample_distance = gpu->GetImageSampleDistance();
+            }
+            else if (auto* smart = vtkSmartVolumeMapper::SafeDownCast(mapper))
+            {
+                smart->AutoAdjustSampleDistancesOff();
+                m_sample_distance = smart->GetSampleDistance();
+                m_image_sample_distance = 0; // not exposed by the smart mapper
+            }
+            else
+                return false;
+            m_state.sample_distance = m_sample_distance;
+            m_state.image_sample_distance = m_image_sample_distance;
+            return true;
+        }
+
+        void Update(double seconds)
+        {
+            if (seconds <= 0) return;
+            m_state.frame_time = seconds;
+            m_state.smoothed_time = m_state.smoothed_time > 0
+                                        ? (1 - smoothing) * m_state.smoothed_time + smoothing * seconds
+                                        : seconds;
+            if (m_settle > 0)
+            {
+                m_settle--;
+                return;
+            }
+
+            auto const ratio = m_state.smoothed_time / m_state.target_time;
+            if (ratio < band_high && (ratio > band_low || m_state.scale <= 1)) return;
+            // cost ~ 1 / scale^2: the scale that hits the target is scale * sqrt(ratio)
+            auto const scale = std::clamp(m_state.scale * std::pow(ratio, 0.5 * gain), 1.0, m_max_scale);
+            if (std::abs(scale - m_state.scale) < 1e-3) return;
+            Apply(scale);
+            m_state.adjustments++;
+            if (m_verbose) std::cout << m_state << std::endl;
+        }
+
+        void Apply(double scale)
+        {
+            m_state.scale = scale;
+            m_state.sample_distance = m_sample_distance * scale;
+            auto const max_image = std::max(max_image_sample_distance, m_image_sample_distance);
+            m_state.image_sample_distance = std::min(m_image_sample_distance * std::sqrt(scale), max_image);
+            m_settle = settle_frames;
+            auto* mapper = m_volume->GetMapper();
+            auto const sample_distance = static_cast<float>(m_state.sample_distance);
+            auto const image_sample_distance = static_cast<float>(m_state.image_sample_distance);
+            if (auto* fixed = vtkFixedPointVolumeRayCastMapper::SafeDownCast(mapper))
+            {
+                fixed->SetSampleDistance(sample_distance);
+                fixed->SetImageSampleDistance(image_sample_distance);
+            }
+            else if (auto* gpu = vtkGPUVolumeRayCastMapper::SafeDownCast(mapper))
+            {
+                gpu->SetSampleDistance(sample_distance);
+                gpu->SetImageSampleDistance(image_sample_distance);
+            }
+            else if (auto* smart = vtkSmartVolumeMapper::SafeDownCast(mapper))
+                smart->SetSampleDistance(sample_distance);
+        }
+
+    private:
+        vtkWeakPointer<vtkVolume> m_volume;
+        double m_sample_distance = 1;
+        double m_image_sample_distance = 1;
+        double m_max_scale = 8;
+        double m_interactive_scale = 1;
+        bool m_interacting = false;
+        bool m_verbose = false;
+        int m_settle = 0;
+        SampleDistanceState m_state;
+    };
+    vtkStandardNewMacro(MSampleDistanceController);
+
+    // hold the frame time of the volume at target_seconds while interacting
+    vtkSmartPointer<MSampleDistanceController> SetupSampleDistanceController(vtkVolume* volume, vtkRenderer* renderer,
+                                                                             vtkRenderWindowInteractor* interactor,
+                                                                             double target_seconds = 1.0 / 20)
+    {
+        auto controller = vtkSmartPointer<MSampleDistanceController>::New();
+        controller->Setup(volume, renderer, interactor, target_seconds);
+        return controller;
+    }
+} // namespace
@@ -15,6 +15,8 @@
 #include <vtkImagePermute.h>
 #include <vtkLookupTable.h>
 #include <vtkImageResliceToColors.h>
+#include <vtkImageActor.h>
+#include <vtkImageMapper3D.h>
 
 #include <vtkCornerAnnotation.h>
 #include <vtkTextProperty.h>
@@ -29,6 +31,16 @@
 #include <iostream>
 #include <sstream>
 
+#include "label_overlay.h"
+
+// colorize and blend only the displayed slice when the slice changes instead of the whole volumes up front:
+// no filter is updated eagerly and the image mapper streams, so the pipeline is only asked for one slice
+#define PER_SLICE_BLEND
+
+// window/level, label lookup and blending fused in one multithreaded pass (MLabelOverlayFilter)
+// instead of two vtkImageResliceToColors and a vtkImageBlend
+#define FUSED_OVERLAY
+
 class myInteractorStyler final: public vtkInteractorStyleImage
 {
 public:
@@ -142,16 +154,34 @@ int main(int argc, char* argv[])
     // https://discourse.vtk.org/t/how-to-compute-surface-and-volume-based-center-of-masses-for-3d-geometries/3215
     // https://discourse.vtk.org/t/bounding-box-of-vtkimagedata/2178
 
-    vtkNew<vtkImageCast> img_cast;
-    img_cast->SetInputData(nii_img_data);
-    img_cast->SetOutputScalarTypeToShort();
-    img_cast->Update();
-
     constexpr int window = 1400;
     constexpr int level = -500;
 
     std::cout << "dicom image data scalar range: " << dicom_img_data->GetScalarRange()[0] << ", "
               << dicom_img_data->GetScalarRange()[1] << '\n';
+
+#ifdef FUSED_OVERLAY
+    vtkNew<vtkLookupTable> nii_table;
+    nii_table->SetNumberOfColors(2);
+    nii_table->SetTableRange(nii_img_data->GetScalarRange());
+    nii_table->SetTableValue(0, 0, 0, 0, 0);
+    nii_table->SetTableValue(1, 1, 0, 0, 1);
+    nii_table->Build();
+
+    // reads the double labels directly, no cast needed
+    vtkNew<MLabelOverlayFilter> overlay;
+    overlay->SetInputData(dicom_img_data);
+    overlay->SetWindow(window);
+    overlay->SetLevel(level);
+    overlay->AddLabelInputData(nii_img_data, nii_table);
+#else
+    vtkNew<vtkImageCast> img_cast;
+    img_cast->SetInputData(nii_img_data);
+    img_cast->SetOutputScalarTypeToShort();
+#ifndef PER_SLICE_BLEND
+    img_cast->Update();
+#endif
+
     vtkNew<vtkLookupTable> dicom_table;
     dicom_table->SetRange(level - window / 2.0, level + window / 2.0); // L - W/2.0, L + W/2.0
     dicom_table->SetValueRange(0, 1);
@@ -163,11 +193,17 @@ int main(int argc, char* argv[])
     dicom_reslice->SetOutputFormatToRGB();
     dicom_reslice->SetLookupTable(dicom_table);
     dicom_reslice->SetInputData(dicom_img_data);
+#ifndef PER_SLICE_BLEND
     dicom_reslice->Update();
+#endif
 
     vtkNew<vtkLookupTable> nii_table;
     nii_table->SetNumberOfColors(2);
+#ifdef PER_SLICE_BLEND
+    nii_table->SetTableRange(nii_img_data->GetScalarRange()); // the cast output is not computed yet
+#else
     nii_table->SetTableRange(img_cast->GetOutput()->GetScalarRange());
+#endif
     nii_table->SetTableValue(0, 0, 0, 0, 0);
     nii_table->SetTableValue(1, 1, 0, 0, 1);
     nii_table->Build();
@@ -175,20 +211,33 @@ int main(int argc, char* argv[])
     vtkNew<vtkImageResliceToColors> nii_reslice;
     nii_reslice->SetOutputFormatToRGBA();
     nii_reslice->SetLookupTable(nii_table);
+#ifdef PER_SLICE_BLEND
+    nii_reslice->SetInputConnection(img_cast->GetOutputPort());
+#else
     nii_reslice->SetInputData(img_cast->GetOutput());
     nii_reslice->Update();
+#endif
 
     vtkNew<vtkImageBlend> blender;
     blender->AddInputConnection(dicom_reslice->GetOutputPort());
     blender->AddInputConnection(nii_reslice->GetOutputPort());
     blender->SetOpacity(1, 1);
+#endif
 
     vtkNew<vtkImageViewer2> viewer;
+#ifdef FUSED_OVERLAY
+    viewer->SetInputConnection(overlay->GetOutputPort());
+#else
     viewer->SetInputConnection(blender->GetOutputPort());
+#endif
     // TODO: window/level will affect the displaying color of slices
     //viewer->GetWindowLevel()->SetWindow(window);
     //viewer->GetWindowLevel()->SetLevel(level);
     viewer->SetSliceOrientationToXY();
+#ifdef PER_SLICE_BLEND
+    // pull only the display extent (one slice) through the blend pipeline
+    viewer->GetImageActor()->GetMapper()->StreamingOn();
+#endif
 
     vtkNew<vtkRenderWindowInteractor> interactor;
     vtkNew<myInteractorStyler> style;
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkMatrix3x3.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    // spread the lower 10 bits of v so that two zero bits sit between each of them
+    inline std::uint32_t MortonSpread3(std::uint32_t v)
+    {
+        v &= 0x000003ff;
+        v = (v ^ (v << 16)) & 0xff0000ff;
+        v = (v ^ (v << 8)) & 0x0300f00f;
+        v = (v ^ (v << 4)) & 0x030c30c3;
+        v = (v ^ (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    inline std::uint32_t MortonEncode3(std::uint32_t x, std::uint32_t y, std::uint32_t z)
+    {
+        return MortonSpread3(x) | (MortonSpread3(y) << 1) | (MortonSpread3(z) << 2);
+    }
+
+    // Volume split into BrickSize^3 bricks (x-fastest inside a brick), bricks stored along a Morton curve.
+    // vtkImageData is x-fastest, so a YZ slice reads one voxel per row and every read is a cache miss;
+    // here every orientation only touches whole bricks, which makes sagittal/coronal extraction as cheap as axial.
+    // Border bricks are padded to full size to keep the addressing branch free.
+    // The slice orientation follows vtkImageViewer2: 0 -> YZ, 1 -> XZ, 2 -> XY
+    class BrickedVolume
+    {
+    public:
+        explicit BrickedVolume(int brick_size = 16)
+        {
+            m_brick_bits = 0;
+            while ((1 << (m_brick_bits + 1)) <= std::max(brick_size, 2))
+                m_brick_bits++;
+            m_brick_size = 1 << m_brick_bits;
+        }
+
+        // copy the image into bricks, one brick per task
+        bool SetInputData(vtkImageData* img)
+        {
+            if (!img || !img->GetPointData()->GetScalars()) return false;
+
+            img->GetOrigin(m_origin);
+            img->GetSpacing(m_spacing);
+            m_direction->DeepCopy(img->GetDirectionMatrix());
+            img->GetExtent(m_extent);
+            img->GetDimensions(m_dims);
+            m_scalar_type = img->GetScalarType();
+            m_components = img->GetNumberOfScalarComponents();
+            m_voxel_size = img->GetScalarSize() * m_components;
+
+            auto const bs = m_brick_size;
+            for (int i = 0; i < 3; i++)
+                m_brick_dims[i] = (m_dims[i] + bs - 1) >> m_brick_bits;
+            if (std::max({m_brick_dims[0], m_brick_dims[1], m_brick_dims[2]}) > 1024) return false;
+
+            // rank the bricks by their morton code
+            auto const brick_count = static_cast<size_t>(m_brick_dims[0]) * m_brick_dims[1] * m_brick_dims[2];
+            std::vector<std::uint32_t> codes(brick_count);
+            for (int bz = 0; bz < m_brick_dims[2]; bz++)
+                for (int by = 0; by < m_brick_dims[1]; by++)
+                    for (int bx = 0; bx < m_brick_dims[0]; bx++)
+                        codes[BrickIndex(bx, by, bz)] = MortonEncode3(bx, by, bz);
+            std::vector<size_t> order(brick_count);
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&codes](size_t a, size_t b) { return codes[a] < codes[b]; });
+            m_brick_slot.resize(brick_count);
+            for (size_t slot = 0; slot < brick_count; slot++)
+                m_brick_slot[order[slot]] = slot;
+
+            m_brick_bytes = static_cast<size_t>(bs) * bs * bs * m_voxel_size;
+            m_bricks.assign(brick_count * m_brick_bytes, 0);
+
+            auto const* src = static_cast<unsigned char const*>(img->GetScalarPointer());
+            auto const row_bytes = static_cast<size_t>(m_dims[0]) * m_voxel_size;
+            auto const slice_bytes = row_bytes * m_dims[1];
+            vtkSMPTools::For(0, static_cast<vtkIdType>(brick_count), [&](vtkIdType begin, vtkIdType end) {
+                for (auto i = begin; i < end; i++)
+                {
+                    auto const bx = static_cast<int>(i % m_brick_dims[0]);
+                    auto const by = static_cast<int>((i / m_brick_dims[0]) % m_brick_dims[1]);
+                    auto const bz = static_cast<int>(i / (static_cast<vtkIdType>(m_brick_dims[0]) * m_brick_dims[1]));
+                    auto* brick = m_bricks.data() + m_brick_slot[i] * m_brick_bytes;
+                    auto const x0 = bx * bs, y0 = by * bs, z0 = bz * bs;
+                    auto const w = std::min(bs, m_dims[0] - x0), h = std::min(bs, m_dims[1] - y0),
+                               d = std::min(bs, m_dims[2] - z0);
+                    for (int lz = 0; lz < d; lz++)
+                        for (int ly = 0; ly < h; ly++)
+                            std::memcpy(brick + (static_cast<size_t>(lz) * bs + ly) * bs * m_voxel_size,
+                                        src + (z0 + lz) * slice_bytes + (y0 + ly) * row_bytes + x0 * m_voxel_size,
+                                        w * m_voxel_size);
+                }
+            });
+
+            for (auto& slice : m_slices)
+                slice = nullptr;
+            return true;
+        }
+
+        int const* GetDimensions() const { return m_dims; }
+
+        int GetBrickSize() const { return m_brick_size; }
+
+        size_t GetMemorySize() const { return m_bricks.size(); }
+
+        void GetSliceRange(int orientation, int range[2]) const
+        {
+            auto const axis = SliceAxis(orientation);
+            range[0] = m_extent[axis * 2];
+            range[1] = m_extent[axis * 2 + 1];
+        }
+
+        // write the slice into out (x-fastest in the slice plane, same layout as the matching vtkImageData slab)
+        void ExtractSlice(int orientation, int slice, void* out) const
+        {
+            switch (m_voxel_size)
+            {
+            case 1:
+                ExtractSliceImpl<std::uint8_t>(orientation, slice, out);
+                break;
+            case 2:
+                ExtractSliceImpl<std::uint16_t>(orientation, slice, out);
+                break;
+            case 4:
+                ExtractSliceImpl<std::uint32_t>(orientation, slice, out);
+                break;
+            case 8:
+                ExtractSliceImpl<std::uint64_t>(orientation, slice, out);
+                break;
+            default:
+                ExtractSliceImpl<void>(orientation, slice, out);
+                break;
+            }
+        }
+
+        // single slab image placed exactly where the slice sits in the full volume, so it can be fed to
+        // vtkImageViewer2 in place of the volume; the image is reused per orientation
+        vtkImageData* GetSlice(int orientation, int slice)
+        {
+            if (m_bricks.empty()) return nullptr;
+
+            auto const axis = SliceAxis(orientation);
+            slice = std::clamp(slice, m_extent[axis * 2], m_extent[axis * 2 + 1]);
+
+            auto& img = m_slices[axis];
+            if (!img)
+            {
+                img = vtkSmartPointer<vtkImageData>::New();
+                img->SetOrigin(m_origin);
+                img->SetSpacing(m_spacing);
+                img->SetDirectionMatrix(m_direction);
+                int ext[6];
+                std::copy(m_extent, m_extent + 6, ext);
+                ext[axis * 2] = ext[axis * 2 + 1] = slice;
+                img->SetExtent(ext);
+                img->AllocateScalars(m_scalar_type, m_components);
+            }
+            else
+            {
+                int ext[6];
+                img->GetExtent(ext);
+                ext[axis * 2] = ext[axis * 2 + 1] = slice;
+                img->SetExtent(ext);
+            }
+            ExtractSlice(orientation, slice, img->GetScalarPointer());
+            img->GetPointData()->GetScalars()->Modified();
+            img->Modified();
+            return img;
+        }
+
+    private:
+        static int SliceAxis(int orientation) { return std::clamp(orientation, 0, 2); }
+
+        size_t BrickIndex(int bx, int by, int bz) const
+        {
+            return (static_cast<size_t>(bz) * m_brick_dims[1] + by) * m_brick_dims[0] + bx;
+        }
+
+        unsigned char const* Brick(int bx, int by, int bz) const
+        {
+            return m_bricks.data() + m_brick_slot[BrickIndex(bx, by, bz)] * m_brick_bytes;
+        }
+
+        // Word is the voxel sized integer used to move one voxel, void falls back to memcpy
+        template <typename Word>
+        void CopyVoxel(unsigned char* dst, unsigned char const* src) const
+        {
+            if constexpr (std::is_void_v<Word>)
+                std::memcpy(dst, src, m_voxel_size);
+            else
+                *reinterpret_cast<Word*>(dst) = *reinterpret_cast<Word const*>(src);
+        }
+
+        template <typename Word>
+        void ExtractSliceImpl(int orientation, int slice, void* out) const
+        {
+            auto const axis = SliceAxis(orientation);
+            auto const bs = m_brick_size;
+            auto const vs = static_cast<size_t>(m_voxel_size);
+            auto* dst = static_cast<unsigned char*>(out);
+            auto const local = std::clamp(slice - m_extent[axis * 2], 0, m_dims[axis] - 1);
+            auto const b = local >> m_brick_bits;
+            auto const l = local & (bs - 1);
+
+            if (axis == 2) // XY: rows inside a brick plane are contiguous
+            {
+                vtkSMPTools::For(0, m_brick_dims[1], [&](vtkIdType begin, vtkIdType end) {
+                    for (auto by = static_cast<int>(begin); by < end; by++)
+                        for (int bx = 0; bx < m_brick_dims[0]; bx++)
+                        {
+                            auto const* brick = Brick(bx, by, b) + static_cast<size_t>(l) * bs * bs * vs;
+                            auto const w = std::min(bs, m_dims[0] - bx * bs), h = std::min(bs, m_dims[1] - by * bs);
+                            for (int ly = 0; ly < h; ly++)
+                                std::memcpy(dst + ((static_cast<size_t>(by) * bs + ly) * m_dims[0] + bx * bs) * vs,
+                                            brick + static_cast<size_t>(ly) * bs * vs, w * vs);
+                        }
+                });
+            }
+            else if (axis == 1) // XZ: still one contiguous row per brick plane
+            {
+                vtkSMPTools::For(0, m_brick_dims[2], [&](vtkIdType begin, vtkIdType end) {
+                    for (auto bz = static_cast<int>(begin); bz < end; bz++)
+                        for (int bx = 0; bx < m_brick_dims[0]; bx++)
+                        {
+                            auto const* brick = Brick(bx, b, bz) + static_cast<size_t>(l) * bs * vs;
+                            auto const w = std::min(bs, m_dims[0] - bx * bs), d = std::min(bs, m_dims[2] - bz * bs);
+                            for (int lz = 0; lz < d; lz++)
+                                std::memcpy(dst + ((static_cast<size_t>(bz) * bs + lz) * m_dims[0] + bx * bs) * vs,
+                                            brick + static_cast<size_t>(lz) * bs * bs * vs, w * vs);
+                        }
+                });
+            }
+            else // YZ: strided reads, but they stay within one brick
+            {
+                vtkSMPTools::For(0, m_brick_dims[2], [&](vtkIdType begin, vtkIdType end) {
+                    for (auto bz = static_cast<int>(begin); bz < end; bz++)
+                        for (int by = 0; by < m_brick_dims[1]; by++)
+                        {
+                            auto const* brick = Brick(b, by, bz) + static_cast<size_t>(l) * vs;
+                            auto const h = std::min(bs, m_dims[1] - by * bs), d = std::min(bs, m_dims[2] - bz * bs);
+                            for (int lz = 0; lz < d; lz++)
+                            {
+                                auto* row = dst + ((static_cast<size_t>(bz) * bs + lz) * m_dims[1] + by * bs) * vs;
+                                auto const* col = brick + static_cast<size_t>(lz) * bs * bs * vs;
+                                for (int ly = 0; ly < h; ly++)
+                                    CopyVoxel<Word>(row + ly * vs, col + static_cast<size_t>(ly) * bs * vs);
+                            }
+                        }
+                });
+            }
+        }
+
+    private:
+        int m_brick_bits = 4;
+        int m_brick_size = 16;
+        int m_brick_dims[3]{};
+        int m_dims[3]{};
+        int m_extent[6]{};
+        int m_scalar_type = 0;
+        int m_components = 1;
+        int m_voxel_size = 1;
+        size_t m_brick_bytes = 0;
+        std::vector<size_t> m_brick_slot;
+        std::vector<unsigned char> m_bricks;
+        double m_origin[3]{};
+        double m_spacing[3]{1, 1, 1};
+        vtkNew<vtkMatrix3x3> m_direction;
+        vtkSmartPointer<vtkImageData> m_slices[3] = {};
+    };
+} // namespace
@@ -0,0 +1,432 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    // Single component volume kept as independently compressed bricks, decoded on demand.
+    // A brick covers BrickSize^3 cells, i.e. BrickSize + 1 voxels per axis: it overlaps its upper neighbours by one
+    // voxel, so the 8 corners of a trilinear sample always come from one decoded brick.
+    // Per brick the values are either
+    //  - lossless: value - brick min (integer scalar types only), or
+    //  - quantized: (value - brick min) / brick scale rounded to 8 bits, at most half a step of error.
+    // Each value is then predicted from its x (row start: y, slice start: z) neighbour, the zigzag residuals are
+    // bit packed in groups of 64 with one width per group. Bricks holding a single value only keep the value.
+    // Use a Reader per thread to sample it, the reader keeps the recently decoded bricks.
+    class CompressedVolume
+    {
+    public:
+        enum class Mode
+        {
+            Lossless,
+            Quantized8
+        };
+
+        // false for multi component input, or lossless mode on a floating point volume
+        bool SetInputData(vtkImageData* img, Mode mode = Mode::Lossless, int brick_size = 16)
+        {
+            m_bricks.clear();
+            m_payload.clear();
+            if (!img || img->GetNumberOfScalarComponents() != 1 || !img->GetPointData()->GetScalars()) return false;
+            auto const type = img->GetScalarType();
+            if (mode == Mode::Lossless && (type == VTK_FLOAT || type == VTK_DOUBLE || img->GetScalarSize() > 4))
+                return false;
+
+            m_mode = mode;
+            m_brick_size = std::max(brick_size, 2);
+            img->GetDimensions(m_dims);
+            img->GetOrigin(m_origin);
+            img->GetSpacing(m_spacing);
+            img->GetScalarRange(m_range);
+            for (int i = 0; i < 3; i++)
+                m_brick_dims[i] = std::max((m_dims[i] - 1 + m_brick_size - 1) / m_brick_size, 1);
+            m_bricks.resize(static_cast<size_t>(m_brick_dims[0]) * m_brick_dims[1] * m_brick_dims[2]);
+
+            // encode every brick on its own, then pack the payloads in brick order
+            std::vector<std::vector<std::uint64_t>> payloads(m_bricks.size());
+            switch (type)
+            {
+                vtkTemplateMacro(Encode(static_cast<VTK_TT const*>(img->GetScalarPointer()), payloads));
+            default:
+                m_bricks.clear();
+                return false;
+            }
+            size_t offset = 0;
+            for (size_t b = 0; b < m_bricks.size(); b++)
+            {
+                m_bricks[b].offset = offset;
+                offset += payloads[b].size();
+            }
+            m_payload.resize(offset);
+            vtkSMPTools::For(0, static_cast<vtkIdType>(m_bricks.size()), [&](vtkIdType begin, vtkIdType end) {
+                for (auto b = begin; b < end; b++)
+                    std::copy(payloads[b].begin(), payloads[b].end(), m_payload.begin() + m_bricks[b].offset);
+            });
+            return true;
+        }
+
+        int const* GetDimensions() const { return m_dims; }
+
+        double const* GetOrigin() const { return m_origin; }
+
+        double const* GetSpacing() const { return m_spacing; }
+
+        double const* GetScalarRange() const { return m_range; }
+
+        int GetBrickSize() const { return m_brick_size; }
+
+        int const* GetBrickDimensions() const { return m_brick_dims; }
+
+        size_t GetNumberOfBricks() const { return m_bricks.size(); }
+
+        // bytes of the brick table and the compressed payload
+        size_t GetMemorySize() const
+        {
+            return m_bricks.size() * sizeof(Brick) + m_payload.size() * sizeof(std::uint64_t);
+        }
+
+        size_t GetDenseMemorySize(int scalar_size = 2) const
+        {
+            return static_cast<size_t>(m_dims[0]) * m_dims[1] * m_dims[2] * scalar_size;
+        }
+
+        // voxels of one decoded brick, (brick_size + 1)^3 x-fastest, the border bricks use part of it
+        size_t GetBrickVoxels() const
+        {
+            auto const n = static_cast<size_t>(m_brick_size) + 1;
+            return n * n * n;
+        }
+
+        // decode brick index into out (GetBrickVoxels values)
+        void DecodeBrick(size_t index, float* out) const
+        {
+            std::vector<std::int64_t> values;
+            DecodeBrick(index, out, values);
+        }
+
+        // same, values is the scratch space of the residuals, kept by the caller across calls
+        void DecodeBrick(size_t index, float* out, std::vector<std::int64_t>& values) const
+        {
+            auto const& brick = m_bricks[index];
+            int size[3];
+            BrickSize(index, size);
+            auto const n = m_brick_size + 1;
+            if (brick.uniform)
+            {
+                for (int z = 0; z < size[2]; z++)
+                    for (int y = 0; y < size[1]; y++)
+                        std::fill_n(out + (static_cast<size_t>(z) * n + y) * n, size[0], static_cast<float>(brick.min));
+                return;
+            }
+
+            BitReader bits{m_payload.data() + brick.offset};
+            std::uint64_t group[group_size];
+            int in_group = group_size;
+            auto const next = [&]() {
+                if (in_group == group_size)
+                {
+                    auto const width = static_cast<int>(bits.Read(6));
+                    for (int g = 0; g < group_size; g++)
+                        group[g] = width ? bits.Read(width) : 0;
+                    in_group = 0;
+                }
+                auto const zigzag = group[in_group++];
+                return static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1);
+            };
+
+            // residuals back to (quantized) values, then to scalars
+            values.resize(static_cast<size_t>(n) * n * n);
+            for (int z = 0; z < size[2]; z++)
+                for (int y = 0; y < size[1]; y++)
+                    for (int x = 0; x < size[0]; x++)
+                    {
+                        auto const i = (static_cast<size_t>(z) * n + y) * n + x;
+                        values[i] = Predict(values.data(), x, y, z, n) + next();
+                    }
+            auto const scale = m_mode == Mode::Quantized8 ? brick.scale : 1.0;
+            for (int z = 0; z < size[2]; z++)
+                for (int y = 0; y < size[1]; y++)
+                    for (int x = 0; x < size[0]; x++)
+                    {
+                        auto const i = (static_cast<size_t>(z) * n + y) * n + x;
+                        out[i] = static_cast<float>(brick.min + values[i] * scale);
+                    }
+        }
+
+        // Trilinear sampling through a cache of decoded bricks, one reader per thread.
+        // The cache is set associative: a brick hashes to a set of `ways` slots and replaces the least recently
+        // used of them, so bricks whose indices differ by a power of two (z neighbours of a power of two sized
+        // slice) do not keep evicting each other like in a direct mapped cache.
+        class Reader
+        {
+        public:
+            Reader() = default;
+
+            // cache_bricks is rounded up to a power of two number of sets, the cache is allocated on the first
+            // sample so copies of an exemplar reader (vtkSMPThreadLocal) are cheap
+            Reader(CompressedVolume const* volume, int cache_bricks) : m_volume(volume)
+            {
+                size_t sets = 1;
+                while (sets * ways < static_cast<size_t>(std::max(cache_bricks, 1)))
+                    sets *= 2;
+                m_set_bits = 0;
+                while ((size_t(1) << m_set_bits) < sets)
+                    m_set_bits++;
+                m_tags.assign(sets * ways, -1);
+                m_used.assign(sets * ways, 0);
+            }
+
+            // continuous index (x, y, z), clamped to the volume like CpuMipRenderer's dense sampling
+            float Sample(double x, double y, double z)
+            {
+                auto const* dims = m_volume->m_dims;
+                auto const bs = m_volume->m_brick_size, n = bs + 1;
+                auto const i = std::clamp(static_cast<int>(x), 0, std::max(dims[0] - 2, 0));
+                auto const j = std::clamp(static_cast<int>(y), 0, std::max(dims[1] - 2, 0));
+                auto const k = std::clamp(static_cast<int>(z), 0, std::max(dims[2] - 2, 0));
+                auto const fx = static_cast<float>(std::clamp(x - i, 0.0, 1.0));
+                auto const fy = static_cast<float>(std::clamp(y - j, 0.0, 1.0));
+                auto const fz = static_cast<float>(std::clamp(z - k, 0.0, 1.0));
+                auto const* bd = m_volume->m_brick_dims;
+                auto const bx = std::min(i / bs, bd[0] - 1), by = std::min(j / bs, bd[1] - 1),
+                           bz = std::min(k / bs, bd[2] - 1);
+                auto const* brick = GetBrick((static_cast<size_t>(bz) * bd[1] + by) * bd[0] + bx);
+                // neighbours collapse on axes of size 1
+                auto const dx = dims[0] > 1 ? 1 : 0;
+                auto const dy = dims[1] > 1 ? n : 0;
+                auto const dz = dims[2] > 1 ? n * n : 0;
+                auto const* c = brick + ((k - bz * bs) * n + (j - by * bs)) * n + (i - bx * bs);
+                auto const c00 = c[0] + fx * (c[dx] - c[0]);
+                auto const c10 = c[dy] + fx * (c[dy + dx] - c[dy]);
+                auto const c01 = c[dz] + fx * (c[dz + dx] - c[dz]);
+                auto const c11 = c[dz + dy] + fx * (c[dz + dy + dx] - c[dz + dy]);
+                auto const c0 = c00 + fy * (c10 - c00);
+                auto const c1 = c01 + fy * (c11 - c01);
+                return c0 + fz * (c1 - c0);
+            }
+
+            size_t GetHits() const { return m_hits; }
+
+            size_t GetMisses() const { return m_misses; }
+
+        private:
+            float const* GetBrick(size_t index)
+            {
+                if (m_cache.empty()) m_cache.resize(m_tags.size() * m_volume->GetBrickVoxels());
+                // Fibonacci hashing, the top bits of the product pick the set
+                auto const hash = static_cast<std::uint64_t>(index) * 0x9E3779B97F4A7C15ull;
+                auto const first = m_set_bits ? static_cast<size_t>(hash >> (64 - m_set_bits)) * ways : 0;
+                auto const tag = static_cast<std::int64_t>(index);
+                m_clock++;
+                auto victim = first;
+                for (auto slot = first; slot < first + ways; slot++)
+                {
+                    if (m_tags[slot] == tag)
+                    {
+                        m_hits++;
+                        m_used[slot] = m_clock;
+                        return m_cache.data() + slot * m_volume->GetBrickVoxels();
+                    }
+                    if (m_used[slot] < m_used[victim]) victim = slot;
+                }
+                m_misses++;
+                auto* brick = m_cache.data() + victim * m_volume->GetBrickVoxels();
+                m_volume->DecodeBrick(index, brick, m_values);
+                m_tags[victim] = tag;
+                m_used[victim] = m_clock;
+                return brick;
+            }
+
+        private:
+            static constexpr size_t ways = 4;
+
+            CompressedVolume const* m_volume = nullptr;
+            int m_set_bits = 0;
+            std::vector<std::int64_t> m_tags;
+            std::vector<std::uint64_t> m_used; // m_clock of the last use per slot, 0 when empty
+            std::uint64_t m_clock = 0;
+            std::vector<float> m_cache;
+            std::vector<std::int64_t> m_values; // DecodeBrick scratch
+            size_t m_hits = 0;
+            size_t m_misses = 0;
+        };
+
+        // Bricks a tile of rays keeps touching: the bricks along the longest axis for a few neighbouring columns
+        int GetDefaultCacheBricks() const
+        {
+            auto const depth = std::max({m_brick_dims[0], m_brick_dims[1], m_brick_dims[2]});
+            return static_cast<int>(std::min<size_t>(static_cast<size_t>(depth) * 16, m_bricks.size()));
+        }
+
+    private:
+        static constexpr int group_size = 64;
+
+        struct Brick
+        {
+            double min = 0;
+            double scale = 1;
+            size_t offset = 0; // in m_payload
+            bool uniform = true;
+        };
+
+        struct BitWriter
+        {
+            std::vector<std::uint64_t>& words;
+            int used = 64;
+
+            void Write(std::uint64_t value, int bits)
+            {
+                if (used == 64)
+                {
+                    words.push_back(0);
+                    used = 0;
+                }
+                words.back() |= value << used;
+                if (used + bits > 64)
+                {
+                    words.push_back(value >> (64 - used));
+                    used = used + bits - 64;
+                }
+                else
+                    used += bits;
+            }
+        };
+
+        struct BitReader
+        {
+            std::uint64_t const* words;
+            int used = 0;
+
+            std::uint64_t Read(int bits)
+            {
+                auto value = words[0] >> used;
+                if (used + bits >= 64)
+                {
+                    words++;
+                    if (used + bits > 64) value |= words[0] << (64 - used);
+                    used = used + bits - 64;
+                }
+                else
+                    used += bits;
+                return bits == 64 ? value : value & ((std::uint64_t(1) << bits) - 1);
+            }
+        };
+
+        // previous voxel along x, at row start along y, at slice start along z
+        static std::int64_t Predict(std::int64_t const* values, int x, int y, int z, int n)
+        {
+            auto const i = (static_cast<size_t>(z) * n + y) * n + x;
+            if (x > 0) return values[i - 1];
+            if (y > 0) return values[i - n];
+            if (z > 0) return values[i - static_cast<size_t>(n) * n];
+            return 0;
+        }
+
+        void BrickSize(size_t index, int size[3]) const
+        {
+            int const b[3]{static_cast<int>(index % m_brick_dims[0]),
+                           static_cast<int>((index / m_brick_dims[0]) % m_brick_dims[1]),
+                           static_cast<int>(index / (static_cast<size_t>(m_brick_dims[0]) * m_brick_dims[1]))};
+            for (int i = 0; i < 3; i++)
+                size[i] = std::min(m_brick_size, m_dims[i] - 1 - b[i] * m_brick_size) + 1;
+        }
+
+        template <typename T>
+        void Encode(T const* data, std::vector<std::vector<std::uint64_t>>& payloads)
+        {
+            auto const nx = static_cast<vtkIdType>(m_dims[0]), nxy = nx * m_dims[1];
+            auto const n = m_brick_size + 1;
+            vtkSMPTools::For(0, static_cast<vtkIdType>(m_bricks.size()), [&](vtkIdType begin, vtkIdType end) {
+                std::vector<std::int64_t> values(static_cast<size_t>(n) * n * n);
+                for (auto index = begin; index < end; index++)
+                {
+                    int size[3];
+                    BrickSize(index, size);
+                    auto const x0 = static_cast<int>(index % m_brick_dims[0]) * m_brick_size;
+                    auto const y0 = static_cast<int>((index / m_brick_dims[0]) % m_brick_dims[1]) * m_brick_size;
+                    auto const z0 =
+                        static_cast<int>(index / (static_cast<vtkIdType>(m_brick_dims[0]) * m_brick_dims[1])) *
+                        m_brick_size;
+                    auto lo = std::numeric_limits<double>::max(), hi = std::numeric_limits<double>::lowest();
+                    for (int z = 0; z < size[2]; z++)
+                        for (int y = 0; y < size[1]; y++)
+                        {
+                            auto const* row = data + (z0 + z) * nxy + (y0 + y) * nx + x0;
+                            for (int x = 0; x < size[0]; x++)
+                            {
+                                lo = std::min(lo, static_cast<double>(row[x]));
+                                hi = std::max(hi, static_cast<double>(row[x]));
+                            }
+                        }
+                    auto& brick = m_bricks[index];
+                    brick.min = lo;
+                    brick.uniform = lo == hi;
+                    if (brick.uniform) continue;
+                    brick.scale = m_mode == Mode::Quantized8 ? (hi - lo) / 255 : 1.0;
+
+                    // (quantized) values relative to the brick min
+                    for (int z = 0; z < size[2]; z++)
+                        for (int y = 0; y < size[1]; y++)
+                        {
+                            auto const* row = data + (z0 + z) * nxy + (y0 + y) * nx + x0;
+                            auto* out = values.data() + (static_cast<size_t>(z) * n + y) * n;
+                            for (int x = 0; x < size[0]; x++)
+                                out[x] = m_mode == Mode::Quantized8
+                                             ? std::llround((row[x] - lo) / brick.scale)
+                                             : static_cast<std::int64_t>(row[x]) - static_cast<std::int64_t>(lo);
+                        }
+
+                    // zigzag residuals, packed per group of 64 with the group's bit width
+                    BitWriter bits{payloads[index]};
+                    std::uint64_t group[group_size];
+                    int in_group = 0;
+                    auto const flush = [&]() {
+                        std::uint64_t all = 0;
+                        for (int g = 0; g < in_group; g++)
+                            all |= group[g];
+                        int width = 0;
+                        while (width < 64 && (all >> width) != 0)
+                            width++;
+                        bits.Write(width, 6);
+                        for (int g = 0; g < group_size && width; g++)
+                            bits.Write(g < in_group ? group[g] : 0, width);
+                        in_group = 0;
+                    };
+                    for (int z = 0; z < size[2]; z++)
+                        for (int y = 0; y < size[1]; y++)
+                            for (int x = 0; x < size[0]; x++)
+                            {
+                                auto const r = values[(static_cast<size_t>(z) * n + y) * n + x] -
+                                               Predict(values.data(), x, y, z, n);
+                                group[in_group++] =
+                                    (static_cast<std::uint64_t>(r) << 1) ^ static_cast<std::uint64_t>(r >> 63);
+                                if (in_group == group_size) flush();
+                            }
+                    if (in_group > 0) flush();
+                }
+            });
+        }
+
+    private:
+        Mode m_mode = Mode::Lossless;
+        int m_brick_size = 16;
+        int m_dims[3]{0, 0, 0};
+        int m_brick_dims[3]{0, 0, 0};
+        double m_origin[3]{0, 0, 0};
+        double m_spacing[3]{1, 1, 1};
+        double m_range[2]{0, 1};
+        std::vector<Brick> m_bricks;
+        std::vector<std::uint64_t> m_payload;
+    };
+} // namespace
@@ -0,0 +1,552 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkMath.h>
+#include <vtkPlane.h>
+#include <vtkPlaneCollection.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "compressed_volume.h"
+#include "empty_space.h"
+#include "gradient_cache.h"
+#include "preintegration.h"
+
+namespace
+{
+    // Software maximum intensity projection, no OpenGL context needed (GPU-less batch nodes).
+    // The image is split into tiles that vtkSMPTools hands out to its thread pool. Each ray is clipped to the
+    // volume bounding box (rays missing it only write the background), then the trilinear samples are gathered in
+    // blocks and reduced with a fixed number of independent max lanes so the reduction vectorizes.
+    // The maximum is mapped through the color/opacity transfer functions and blended over the background,
+    // like vtkVolumeMapper's MAXIMUM_INTENSITY_BLEND. The volume is assumed axis aligned (direction ignored).
+    // The composite blend mode accumulates the samples front to back instead, shaded with a headlight from the
+    // cached gradients (gradient_cache.h) when shading is on, like COMPOSITE_BLEND with ShadeOn.
+    // Clipping planes keep the side their normal points to, like the vtkVolumeMapper ones; each ray is cut to
+    // the visible segment before marching, so clipped samples are never generated.
+    // With pre-integration (preintegration.h) it composites whole segments between samples, which keeps thin
+    // opacity features free of banding at 2-4x larger sample distances.
+    // Compositing a dense input jumps over the bricks that are fully transparent under the opacity function
+    // (empty_space.h), the min/max bricks are built once per input and reclassified every frame.
+    // A CompressedVolume input is sampled through one brick cache per thread, the tiles keep neighbouring rays on
+    // the same bricks so most samples hit a decoded brick.
+    class CpuMipRenderer
+    {
+    public:
+        void SetInputData(vtkImageData* img)
+        {
+            m_input = img;
+            m_compressed = nullptr;
+        }
+
+        // block compressed input, shading then needs SetGradients
+        void SetInputData(std::shared_ptr<CompressedVolume const> volume)
+        {
+            m_compressed = std::move(volume);
+            m_input = nullptr;
+        }
+
+        // decoded bricks kept per thread for a compressed input, GetDefaultCacheBricks when <= 0
+        void SetBrickCacheSize(int bricks) { m_cache_bricks = bricks; }
+
+        // fraction of the samples of the last compressed render that found their brick decoded
+        double GetCacheHitRate() const { return m_cache_hit_rate; }
+
+        void SetColor(vtkColorTransferFunction* color) { m_color = color; }
+
+        void SetScalarOpacity(vtkPiecewiseFunction* opacity) { m_opacity = opacity; }
+
+        void SetBackground(double r, double g, double b)
+        {
+            m_background[0] = r;
+            m_background[1] = g;
+            m_background[2] = b;
+        }
+
+        // distance between samples along a ray in world units, the smallest spacing when <= 0
+        void SetSampleDistance(double distance) { m_sample_distance = distance; }
+
+        void SetTileSize(int size) { m_tile_size = std::max(size, 1); }
+
+        void SetBlendModeToMaximumIntensity() { m_composite = false; }
+
+        void SetBlendModeToComposite() { m_composite = true; }
+
+        // phong terms of the composite blend mode, like vtkVolumeProperty
+        void SetShading(bool shade, double ambient = 0.4, double diffuse = 0.6, double specular = 0.2,
+                        double specular_power = 10)
+        {
+            m_shade = shade;
+            m_ambient = ambient;
+            m_diffuse = diffuse;
+            m_specular = specular;
+            m_specular_power = specular_power;
+        }
+
+        void AddClippingPlane(vtkPlane* plane) { m_clipping_planes.emplace_back(plane); }
+
+        void RemoveAllClippingPlanes() { m_clipping_planes.clear(); }
+
+        // same planes as a volume mapper, e.g. volume->GetMapper()->GetClippingPlanes()
+        void SetClippingPlanes(vtkPlaneCollection* planes)
+        {
+            RemoveAllClippingPlanes();
+            if (!planes) return;
+            for (int i = 0; i < planes->GetNumberOfItems(); i++)
+                AddClippingPlane(planes->GetItem(i));
+        }
+
+        // composite segments with a pre-integrated transfer function table instead of single samples
+        void SetPreIntegration(bool preintegrate) { m_preintegrate = preintegrate; }
+
+        // skip the transparent bricks while compositing, on by default
+        void SetEmptySpaceSkipping(bool skip) { m_skip_empty = skip; }
+
+        // gradients used for shading, taken from GetGradientVolume when not set
+        void SetGradients(std::shared_ptr<GradientVolume const> gradients) { m_gradients = std::move(gradients); }
+
+        // render the volume seen by camera into a width x height RGB image (row 0 at the bottom, like VTK images)
+        vtkSmartPointer<vtkImageData> Render(vtkCamera* camera, int width, int height)
+        {
+            auto out = vtkSmartPointer<vtkImageData>::New();
+            out->SetExtent(0, width - 1, 0, height - 1, 0, 0);
+            out->AllocateScalars(VTK_UNSIGNED_CHAR, 3);
+            if (m_compressed ? m_compressed->GetNumberOfBricks() == 0
+                             : !m_input || m_input->GetNumberOfScalarComponents() != 1 ||
+                                   !m_input->GetPointData()->GetScalars())
+                return out;
+
+            BuildTables();
+            SetupCamera(camera, width, height);
+            if (m_composite) BuildStepOpacity(); // also for rays too short for a segment
+            if (m_composite && m_preintegrate) m_preintegrated.Build(m_color, m_opacity, m_range, m_step);
+            m_skipping = m_composite && m_skip_empty && m_input && m_opacity && BuildOccupancy();
+            if (m_composite && m_shade && (!m_gradients || m_gradients->GetDimensions()[0] != m_dims[0] ||
+                                           m_gradients->GetDimensions()[1] != m_dims[1] ||
+                                           m_gradients->GetDimensions()[2] != m_dims[2]))
+                m_gradients = m_input ? GetGradientVolume(m_input) : nullptr;
+            auto* pixels = static_cast<unsigned char*>(out->GetScalarPointer());
+            if (m_compressed)
+            {
+                auto const bricks = m_cache_bricks > 0 ? m_cache_bricks : m_compressed->GetDefaultCacheBricks();
+                CompressedVolume::Reader const exemplar(m_compressed.get(), bricks);
+                vtkSMPThreadLocal<CompressedVolume::Reader> readers(exemplar);
+                RenderTiles(&readers, pixels, width, height);
+                size_t hits = 0, misses = 0;
+                for (auto const& reader : readers)
+                {
+                    hits += reader.GetHits();
+                    misses += reader.GetMisses();
+                }
+                m_cache_hit_rate = hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0;
+                return out;
+            }
+            switch (m_input->GetScalarType())
+            {
+                vtkTemplateMacro(RenderTiles(static_cast<VTK_TT const*>(m_input->GetScalarPointer()), pixels, width,
+                                             height));
+            }
+            return out;
+        }
+
+    private:
+        static constexpr int table_size = 4096;
+        static constexpr int lanes = 8;
+        static constexpr int block = 64;
+
+        void BuildTables()
+        {
+            if (m_compressed)
+                std::copy_n(m_compressed->GetScalarRange(), 2, m_range);
+            else
+                m_input->GetScalarRange(m_range);
+            if (m_range[1] <= m_range[0]) m_range[1] = m_range[0] + 1;
+            m_rgb.assign(table_size * 3, 1.0);
+            m_alpha.assign(table_size, 1.0);
+            if (m_color) m_color->GetTable(m_range[0], m_range[1], table_size, m_rgb.data());
+            if (m_opacity) m_opacity->GetTable(m_range[0], m_range[1], table_size, m_alpha.data());
+        }
+
+        // bricks of the dense input, rebuilt when the input changes, classified with the current opacity
+        bool BuildOccupancy()
+        {
+            if (m_occupancy_input != m_input || m_occupancy_time < m_input->GetMTime())
+            {
+                m_occupancy_input = m_input;
+                m_occupancy_time = m_input->GetMTime();
+                m_occupancy_valid = m_occupancy.SetInputData(m_input);
+            }
+            if (!m_occupancy_valid) return false;
+            // everything visible, nothing to skip
+            return m_occupancy.Classify(m_opacity) < m_occupancy.GetNumberOfBricks();
+        }
+
+        // opacity of one composite step, the transfer function opacity is per unit distance (vtkVolumeProperty's
+        // scalar opacity unit distance of 1)
+        void BuildStepOpacity()
+        {
+            m_step_alpha.resize(table_size);
+            for (int i = 0; i < table_size; i++)
+                m_step_alpha[i] = 1 - std::pow(1 - std::clamp(m_alpha[i], 0.0, 1.0), m_step);
+        }
+
+        void SetupCamera(vtkCamera* camera, int width, int height)
+        {
+            camera->GetPosition(m_eye);
+            camera->GetDirectionOfProjection(m_forward);
+            camera->GetViewUp(m_up);
+            vtkMath::Cross(m_forward, m_up, m_right);
+            vtkMath::Normalize(m_right);
+            vtkMath::Cross(m_right, m_forward, m_up);
+            vtkMath::Normalize(m_up);
+            m_parallel = camera->GetParallelProjection() != 0;
+            // half extent of the image plane at distance 1 (perspective) or in world units (parallel)
+            m_half_height = m_parallel ? camera->GetParallelScale()
+                                       : std::tan(vtkMath::RadiansFromDegrees(camera->GetViewAngle()) / 2);
+            m_half_width = m_half_height * width / std::max(height, 1);
+
+            if (m_compressed)
+            {
+                std::copy_n(m_compressed->GetOrigin(), 3, m_origin);
+                std::copy_n(m_compressed->GetSpacing(), 3, m_spacing);
+                std::copy_n(m_compressed->GetDimensions(), 3, m_dims);
+            }
+            else
+            {
+                m_input->GetOrigin(m_origin);
+                m_input->GetSpacing(m_spacing);
+                m_input->GetDimensions(m_dims);
+            }
+            m_step = m_sample_distance > 0 ? m_sample_distance
+                                           : std::min({std::abs(m_spacing[0]), std::abs(m_spacing[1]),
+                                                       std::abs(m_spacing[2])});
+
+            // planes in continuous index space: n . (origin + i * spacing - o) = (n * spacing) . i + n . (origin - o)
+            m_planes.clear();
+            for (auto const& plane : m_clipping_planes)
+            {
+                auto const* n = plane->GetNormal();
+                auto const* o = plane->GetOrigin();
+                for (int i = 0; i < 3; i++)
+                    m_planes.push_back(n[i] * m_spacing[i]);
+                m_planes.push_back(n[0] * (m_origin[0] - o[0]) + n[1] * (m_origin[1] - o[1]) +
+                                   n[2] * (m_origin[2] - o[2]));
+            }
+        }
+
+        // data is the dense scalar pointer, or the per thread readers of the compressed input
+        template <typename Data>
+        void RenderTiles(Data data, unsigned char* pixels, int width, int height) const
+        {
+            auto const tiles_x = (width + m_tile_size - 1) / m_tile_size;
+            auto const tiles_y = (height + m_tile_size - 1) / m_tile_size;
+            vtkSMPTools::For(0, static_cast<vtkIdType>(tiles_x) * tiles_y, 1, [&](vtkIdType begin, vtkIdType end) {
+                float samples[block];
+                auto source = Local(data);
+                for (auto tile = begin; tile < end; tile++)
+                {
+                    auto const x0 = static_cast<int>(tile % tiles_x) * m_tile_size;
+                    auto const y0 = static_cast<int>(tile / tiles_x) * m_tile_size;
+                    for (auto y = y0; y < std::min(y0 + m_tile_size, height); y++)
+                        for (auto x = x0; x < std::min(x0 + m_tile_size, width); x++)
+                            if (m_composite)
+                                Composite(source, x, y, width, height, pixels + (y * width + x) * 3);
+                            else
+                                Shade(CastRay(source, x, y, width, height, samples), pixels + (y * width + x) * 3);
+                }
+            });
+        }
+
+        // ray through pixel (x, y) in continuous index space (p + t * d, t in world units), clipped to the volume
+        // box with a slab test; false when the ray misses the volume
+        bool SetupRay(int x, int y, int width, int height, double p[3], double d[3], double& t0, double& t1,
+                      double dir[3]) const
+        {
+            auto const u = (2.0 * (x + 0.5) / width - 1) * m_half_width;
+            auto const v = (2.0 * (y + 0.5) / height - 1) * m_half_height;
+            double origin[3];
+            for (int i = 0; i < 3; i++)
+            {
+                origin[i] = m_parallel ? m_eye[i] + u * m_right[i] + v * m_up[i] : m_eye[i];
+                dir[i] = m_parallel ? m_forward[i] : m_forward[i] + u * m_right[i] + v * m_up[i];
+            }
+            vtkMath::Normalize(dir);
+
+            t0 = 0.0;
+            t1 = std::numeric_limits<double>::max();
+            for (int i = 0; i < 3; i++)
+            {
+                p[i] = (origin[i] - m_origin[i]) / m_spacing[i];
+                d[i] = dir[i] / m_spacing[i];
+                auto const hi = static_cast<double>(m_dims[i] - 1);
+                if (d[i] == 0)
+                {
+                    if (p[i] < 0 || p[i] > hi) return false;
+                    continue;
+                }
+                auto a = (0 - p[i]) / d[i], b = (hi - p[i]) / d[i];
+                if (a > b) std::swap(a, b);
+                t0 = std::max(t0, a);
+                t1 = std::min(t1, b);
+            }
+
+            // visible part of the ray: f(t) = f0 + t * df >= 0 for every plane
+            for (size_t c = 0; c < m_planes.size() && t0 <= t1; c += 4)
+            {
+                auto const* plane = &m_planes[c];
+                auto const f0 = plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3];
+                auto const df = plane[0] * d[0] + plane[1] * d[1] + plane[2] * d[2];
+                if (df > 0)
+                    t0 = std::max(t0, -f0 / df);
+                else if (df < 0)
+                    t1 = std::min(t1, -f0 / df);
+                else if (f0 < 0)
+                    return false;
+            }
+            return t0 <= t1;
+        }
+
+        // maximum along the ray through pixel (x, y), NaN when the ray misses the volume
+        template <typename Source>
+        float CastRay(Source data, int x, int y, int width, int height, float* samples) const
+        {
+            double p[3], d[3], dir[3], t0, t1;
+            if (!SetupRay(x, y, width, height, p, d, t0, t1, dir)) return std::numeric_limits<float>::quiet_NaN();
+
+            auto const count = static_cast<vtkIdType>((t1 - t0) / m_step) + 1;
+            float lane_max[lanes];
+            std::fill(lane_max, lane_max + lanes, std::numeric_limits<float>::lowest());
+            for (vtkIdType first = 0; first < count; first += block)
+            {
+                auto const n = static_cast<int>(std::min<vtkIdType>(block, count - first));
+                for (int s = 0; s < n; s++)
+                {
+                    auto const t = t0 + (first + s) * m_step;
+                    samples[s] = Sample(data, p[0] + t * d[0], p[1] + t * d[1], p[2] + t * d[2]);
+                }
+                // pad the tail, so every block runs the same branch free lane loop
+                std::fill(samples + n, samples + block, std::numeric_limits<float>::lowest());
+                for (int s = 0; s < block; s += lanes)
+                    for (int l = 0; l < lanes; l++)
+                        lane_max[l] = lane_max[l] < samples[s + l] ? samples[s + l] : lane_max[l];
+            }
+            return *std::max_element(lane_max, lane_max + lanes);
+        }
+
+        // front to back compositing along the ray through pixel (x, y), stops once the ray is opaque
+        // with pre-integration every pair of consecutive samples is one segment looked up in the 2D table
+        template <typename Source>
+        void Composite(Source data, int x, int y, int width, int height, unsigned char* rgb) const
+        {
+            double color[3]{0, 0, 0};
+            auto alpha = 0.0;
+            double p[3], d[3], dir[3], t0, t1;
+            if (SetupRay(x, y, width, height, p, d, t0, t1, dir))
+            {
+                auto const count = static_cast<vtkIdType>((t1 - t0) / m_step) + 1;
+                auto const nx = static_cast<vtkIdType>(m_dims[0]), nxy = nx * m_dims[1];
+                auto const preintegrated = m_preintegrate && count > 1;
+                auto front = preintegrated ? m_preintegrated.Bin(Sample(data, p[0] + t0 * d[0], p[1] + t0 * d[1],
+                                                                        p[2] + t0 * d[2]))
+                                           : 0;
+                for (vtkIdType s = preintegrated ? 1 : 0; s < count && alpha < 0.99; s++)
+                {
+                    auto const t = t0 + s * m_step;
+                    double const q[3]{p[0] + t * d[0], p[1] + t * d[1], p[2] + t * d[2]};
+                    auto const value = Sample(data, q[0], q[1], q[2]);
+                    // opacity weighted color and opacity of this step
+                    double c[3];
+                    double a;
+                    if (preintegrated)
+                    {
+                        auto const back = m_preintegrated.Bin(value);
+                        auto const* rgba = m_preintegrated.Lookup(front, back);
+                        front = back;
+                        a = rgba[3];
+                        for (int i = 0; i < 3; i++)
+                            c[i] = rgba[i];
+                    }
+                    else
+                    {
+                        auto const index = TableIndex(value);
+                        a = m_step_alpha[index];
+                        for (int i = 0; i < 3; i++)
+                            c[i] = m_rgb[index * 3 + i] * a;
+                    }
+                    // the following samples of an empty brick are transparent, continue from the last of them
+                    // (its value is the front of the next segment)
+                    if (m_skipping)
+                    {
+                        auto const last = LastEmptySample(p, d, q, t0, s, count);
+                        if (last > s)
+                        {
+                            s = last;
+                            auto const tl = t0 + s * m_step;
+                            if (preintegrated)
+                                front = m_preintegrated.Bin(Sample(data, p[0] + tl * d[0], p[1] + tl * d[1],
+                                                                   p[2] + tl * d[2]));
+                        }
+                    }
+                    if (a <= 0) continue;
+                    if (m_shade && m_gradients)
+                    {
+                        // nearest voxel normal, headlight: light and view direction are both -dir
+                        auto const voxel = static_cast<vtkIdType>(q[2] + 0.5) * nxy +
+                                           static_cast<vtkIdType>(q[1] + 0.5) * nx + static_cast<vtkIdType>(q[0] + 0.5);
+                        float n[3];
+                        m_gradients->GetNormal(voxel, n);
+                        auto const ndotl = std::abs(n[0] * dir[0] + n[1] * dir[1] + n[2] * dir[2]);
+                        auto const diffuse = m_ambient + m_diffuse * ndotl;
+                        auto const specular = m_specular * std::pow(ndotl, m_specular_power);
+                        for (int i = 0; i < 3; i++)
+                            c[i] = c[i] * diffuse + specular * a;
+                    }
+                    for (int i = 0; i < 3; i++)
+                        color[i] += (1 - alpha) * c[i];
+                    alpha += (1 - alpha) * a;
+                }
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                auto const value = color[i] + (1 - alpha) * m_background[i];
+                rgb[i] = static_cast<unsigned char>(std::clamp(value, 0.0, 1.0) * 255 + 0.5);
+            }
+        }
+
+        // last sample of the ray (p + t * d, t = t0 + s * step) in the brick holding q when that brick is empty,
+        // s otherwise; a brick covers the continuous indices [b * size, (b + 1) * size] on each axis
+        vtkIdType LastEmptySample(double const p[3], double const d[3], double const q[3], double t0, vtkIdType s,
+                                  vtkIdType count) const
+        {
+            auto const size = m_occupancy.GetBrickSize();
+            auto const* bricks = m_occupancy.GetBrickDimensions();
+            int b[3];
+            for (int i = 0; i < 3; i++)
+                b[i] = std::clamp(static_cast<int>(q[i]) / size, 0, bricks[i] - 1);
+            if (m_occupancy.IsOccupied(m_occupancy.BrickIndex(b[0], b[1], b[2]))) return s;
+            auto exit = std::numeric_limits<double>::max();
+            for (int i = 0; i < 3; i++)
+            {
+                if (d[i] > 0)
+                    exit = std::min(exit, ((b[i] + 1) * size - p[i]) / d[i]);
+                else if (d[i] < 0)
+                    exit = std::min(exit, (b[i] * size - p[i]) / d[i]);
+            }
+            // samples strictly before the exit, the one on the face may interpolate the next brick
+            auto const last = static_cast<vtkIdType>(std::ceil((exit - t0) / m_step)) - 1;
+            return std::clamp(last, s, count - 1);
+        }
+
+        int TableIndex(float value) const
+        {
+            return std::clamp(
+                static_cast<int>((value - m_range[0]) / (m_range[1] - m_range[0]) * (table_size - 1) + 0.5), 0,
+                table_size - 1);
+        }
+
+        // dense data is shared by all threads, every thread samples a compressed input through its own reader
+        template <typename T>
+        static T const* Local(T const* data)
+        {
+            return data;
+        }
+
+        static CompressedVolume::Reader* Local(vtkSMPThreadLocal<CompressedVolume::Reader>* readers)
+        {
+            return &readers->Local();
+        }
+
+        static float Sample(CompressedVolume::Reader* reader, double x, double y, double z)
+        {
+            return reader->Sample(x, y, z);
+        }
+
+        template <typename T>
+        float Sample(T const* data, double x, double y, double z) const
+        {
+            auto const nx = static_cast<vtkIdType>(m_dims[0]), nxy = nx * m_dims[1];
+            auto const i = std::clamp(static_cast<int>(x), 0, std::max(m_dims[0] - 2, 0));
+            auto const j = std::clamp(static_cast<int>(y), 0, std::max(m_dims[1] - 2, 0));
+            auto const k = std::clamp(static_cast<int>(z), 0, std::max(m_dims[2] - 2, 0));
+            auto const fx = static_cast<float>(std::clamp(x - i, 0.0, 1.0));
+            auto const fy = static_cast<float>(std::clamp(y - j, 0.0, 1.0));
+            auto const fz = static_cast<float>(std::clamp(z - k, 0.0, 1.0));
+            // neighbours collapse on axes of size 1
+            auto const dx = m_dims[0] > 1 ? 1 : 0;
+            auto const dy = m_dims[1] > 1 ? nx : 0;
+            auto const dz = m_dims[2] > 1 ? nxy : 0;
+            auto const* c = data + k * nxy + j * nx + i;
+            auto const c00 = c[0] + fx * (static_cast<float>(c[dx]) - c[0]);
+            auto const c10 = c[dy] + fx * (static_cast<float>(c[dy + dx]) - c[dy]);
+            auto const c01 = c[dz] + fx * (static_cast<float>(c[dz + dx]) - c[dz]);
+            auto const c11 = c[dz + dy] + fx * (static_cast<float>(c[dz + dy + dx]) - c[dz + dy]);
+            auto const c0 = c00 + fy * (c10 - c00);
+            auto const c1 = c01 + fy * (c11 - c01);
+            return c0 + fz * (c1 - c0);
+        }
+
+        void Shade(float value, unsigned char* rgb) const
+        {
+            double color[3]{m_background[0], m_background[1], m_background[2]};
+            if (!std::isnan(value))
+            {
+                auto const index = TableIndex(value);
+                auto const a = m_alpha[index];
+                for (int i = 0; i < 3; i++)
+                    color[i] = m_rgb[index * 3 + i] * a + color[i] * (1 - a);
+            }
+            for (int i = 0; i < 3; i++)
+                rgb[i] = static_cast<unsigned char>(std::clamp(color[i], 0.0, 1.0) * 255 + 0.5);
+        }
+
+    private:
+        vtkSmartPointer<vtkImageData> m_input = nullptr;
+        std::shared_ptr<CompressedVolume const> m_compressed;
+        int m_cache_bricks = 0;
+        double m_cache_hit_rate = 0;
+        vtkSmartPointer<vtkColorTransferFunction> m_color = nullptr;
+        vtkSmartPointer<vtkPiecewiseFunction> m_opacity = nullptr;
+        double m_background[3]{0, 0, 0};
+        double m_sample_distance = 0;
+        int m_tile_size = 32;
+        bool m_composite = false;
+        bool m_shade = false;
+        bool m_preintegrate = false;
+        double m_ambient = 0.4, m_diffuse = 0.6, m_specular = 0.2, m_specular_power = 10;
+        std::shared_ptr<GradientVolume const> m_gradients;
+        std::vector<vtkSmartPointer<vtkPlane>> m_clipping_planes;
+        bool m_skip_empty = true;
+        BrickOccupancy m_occupancy;
+        vtkImageData* m_occupancy_input = nullptr; // identity only, m_input keeps it alive
+        vtkMTimeType m_occupancy_time = 0;
+        bool m_occupancy_valid = false;
+
+        // per frame state
+        double m_range[2]{0, 1};
+        std::vector<double> m_rgb;
+        std::vector<double> m_alpha;
+        std::vector<double> m_step_alpha;
+        PreIntegratedTable m_preintegrated; // rebuilt incrementally, kept across frames
+        double m_eye[3], m_forward[3], m_up[3], m_right[3];
+        bool m_parallel = false;
+        double m_half_width = 1, m_half_height = 1;
+        double m_origin[3], m_spacing[3];
+        int m_dims[3];
+        double m_step = 1;
+        std::vector<double> m_planes; // a, b, c, d per clipping plane, index space
+        bool m_skipping = false;
+    };
+} // namespace
@@ -0,0 +1,522 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkPointData.h>
+#include <vtkIdTypeArray.h>
+#include <vtkCellArray.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    // Delaunay triangulation of the xy projection of a point set, a parallel stand-in for vtkDelaunay2D (default
+    // projection, no alpha, no bounding triangulation): the output holds all input points and the triangles,
+    // counter clockwise seen from +z, with the input point data.
+    //  - like vtkDelaunay2D::SetTolerance, a point closer than tolerance * bounding box diagonal to a point kept
+    //    before it (in id order) is left out, neighbours are found through a parallel sorted cell hash
+    //  - the points are snapped to a 2^30 lattice over their xy bounds (finer than float input), sorted in parallel
+    //    and triangulated by Guibas and Stolfi's divide and conquer on quad edges, with exact predicates on the
+    //    lattice (64 bit orientation, filtered incircle with a 128 bit fallback), so degenerate input cannot break it
+    //  - the sorted points are cut into one strip per task, strips are triangulated in parallel, then neighbouring
+    //    strips are merged pairwise, every level of merges in parallel; a merge only walks the seam
+    //  - each strip allocates its edges from its own slice of the edge arrays, merged groups pool their free slots,
+    //    so no two tasks ever share an edge
+    //  - edge ids are 32 bit, Execute returns nullptr when more than GetMaximumNumberOfPoints() points are left
+    class ParallelDelaunay2D
+    {
+    public:
+        // most points, after the tolerance, the 32 bit edge ids can index (about 178 million)
+        static constexpr std::int64_t GetMaximumNumberOfPoints()
+        {
+            // 4 edge ids per quad edge, up to 3 quad edges per point and 8 more per strip
+            return (std::numeric_limits<std::int32_t>::max() / 4 - std::int64_t(8) * max_strips) / 3;
+        }
+
+        // fraction of the bounding box diagonal, 0.00001 like vtkDelaunay2D
+        void SetTolerance(double tolerance) { m_tolerance = std::max(tolerance, 0.0); }
+
+        // input points left out by the tolerance (or on the same lattice node) in the last Execute
+        vtkIdType GetNumberOfDiscardedPoints() const { return m_discarded; }
+
+        vtkSmartPointer<vtkPolyData> Execute(vtkPolyData* input)
+        {
+            auto* points = input->GetPoints();
+            auto output = vtkSmartPointer<vtkPolyData>::New();
+            output->SetPoints(points);
+            output->GetPointData()->PassData(input->GetPointData());
+            output->SetPolys(vtkSmartPointer<vtkCellArray>::New());
+            m_discarded = 0;
+            auto const count = points->GetNumberOfPoints();
+            if (count < 3) return output;
+
+            Sites(points);
+            m_discarded = count - static_cast<vtkIdType>(m_ids.size());
+            if (static_cast<std::int64_t>(m_ids.size()) > GetMaximumNumberOfPoints())
+            {
+                m_x = m_y = std::vector<std::int64_t>();
+                m_ids = std::vector<vtkIdType>();
+                return nullptr;
+            }
+            auto const n = static_cast<std::int32_t>(m_ids.size());
+            if (n < 3) return output;
+
+            // strips of at least min_strip points, a few per thread, a power of two for the pairwise merges
+            int strips = 1;
+            while (strips * 2 <= std::min(vtkSMPTools::GetEstimatedNumberOfThreads() * 4, max_strips) &&
+                   n / (strips * 2) >= min_strip)
+                strips *= 2;
+            auto const first_point = [&](int strip) {
+                return static_cast<std::int32_t>(std::int64_t(n) * strip / strips);
+            };
+            // a triangulation of k points has at most 3k - 6 edges
+            std::vector<std::int32_t> first_quad(strips + 1, 0);
+            for (int s = 0; s < strips; s++)
+                first_quad[s + 1] = first_quad[s] + 3 * (first_point(s + 1) - first_point(s)) + 8;
+            m_next.assign(std::size_t(first_quad[strips]) * 4, 0);
+            m_data.assign(std::size_t(first_quad[strips]) * 4, 0);
+
+            std::vector<Group> groups(strips);
+            vtkSMPTools::For(0, strips, 1, [&](vtkIdType begin, vtkIdType end) {
+                for (auto s = begin; s < end; s++)
+                {
+                    auto& group = groups[s];
+                    group.arena.fresh.emplace_back(first_quad[s], first_quad[s + 1]);
+                    auto const hull = Triangulate(first_point(s), first_point(s + 1), group.arena);
+                    group.left = hull.first;
+                    group.right = hull.second;
+                }
+            });
+            for (; groups.size() > 1;)
+            {
+                std::vector<Group> merged(groups.size() / 2);
+                vtkSMPTools::For(0, static_cast<vtkIdType>(merged.size()), 1, [&](vtkIdType begin, vtkIdType end) {
+                    for (auto g = begin; g < end; g++)
+                    {
+                        auto& left = groups[g * 2];
+                        auto& right = groups[g * 2 + 1];
+                        auto& group = merged[g];
+                        group.arena = std::move(left.arena);
+                        group.arena.Take(right.arena);
+                        auto const hull = Merge(left.left, left.right, right.left, right.right, group.arena);
+                        group.left = hull.first;
+                        group.right = hull.second;
+                    }
+                });
+                groups.swap(merged);
+            }
+
+            output->SetPolys(Triangles());
+            m_next = std::vector<std::int32_t>();
+            m_data = std::vector<std::int32_t>();
+            m_x = m_y = std::vector<std::int64_t>();
+            m_ids = std::vector<vtkIdType>();
+            return output;
+        }
+
+    private:
+        static constexpr std::int32_t min_strip = 2048;
+        static constexpr int max_strips = 1024;
+        static constexpr double lattice = 1073741823; // 2^30 - 1
+
+        // free quad edges of a strip or of merged strips
+        struct Arena
+        {
+            std::vector<std::int32_t> free;
+            std::vector<std::pair<std::int32_t, std::int32_t>> fresh; // never used quad ranges
+
+            std::int32_t Allocate()
+            {
+                if (!free.empty())
+                {
+                    auto const q = free.back();
+                    free.pop_back();
+                    return q;
+                }
+                auto& range = fresh.back();
+                auto const q = range.first++;
+                if (range.first == range.second) fresh.pop_back();
+                return q;
+            }
+
+            void Take(Arena& other)
+            {
+                free.insert(free.end(), other.free.begin(), other.free.end());
+                fresh.insert(fresh.end(), other.fresh.begin(), other.fresh.end());
+                other = Arena();
+            }
+        };
+
+        // triangulation of a run of sorted points: its arena and the counter clockwise convex hull edge out of the
+        // leftmost point, the clockwise one out of the rightmost
+        struct Group
+        {
+            Arena arena;
+            std::int32_t left = -1;
+            std::int32_t right = -1;
+        };
+
+        // kept points: tolerance, lattice coordinates, sorted by x then y, one point per lattice node
+        void Sites(vtkPoints* points)
+        {
+            auto const count = points->GetNumberOfPoints();
+            double bounds[6];
+            points->GetBounds(bounds);
+            auto const diagonal = std::sqrt((bounds[1] - bounds[0]) * (bounds[1] - bounds[0]) +
+                                            (bounds[3] - bounds[2]) * (bounds[3] - bounds[2]) +
+                                            (bounds[5] - bounds[4]) * (bounds[5] - bounds[4]));
+            auto const keep = KeepPoints(points, bounds, m_tolerance * diagonal);
+
+            auto const range = std::max(bounds[1] - bounds[0], bounds[3] - bounds[2]);
+            auto const scale = range > 0 ? lattice / range : 0.0;
+            struct Site
+            {
+                std::int64_t x, y;
+                vtkIdType id;
+                bool operator<(Site const& o) const
+                {
+                    return x != o.x ? x < o.x : y != o.y ? y < o.y : id < o.id;
+                }
+            };
+            std::vector<Site> sites(count);
+            vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+                for (auto id = begin; id < end; id++)
+                {
+                    double x[3];
+                    points->GetPoint(id, x);
+                    // dropped points sort last
+                    sites[id] = keep[id] ? Site{std::llround((x[0] - bounds[0]) * scale),
+                                                std::llround((x[1] - bounds[2]) * scale), id}
+                                         : Site{std::numeric_limits<std::int64_t>::max(), 0, id};
+                }
+            });
+            vtkSMPTools::Sort(sites.begin(), sites.end());
+
+            m_x.clear();
+            m_y.clear();
+            m_ids.clear();
+            for (auto const& site : sites)
+            {
+                if (site.x == std::numeric_limits<std::int64_t>::max()) break;
+                if (!m_ids.empty() && site.x == m_x.back() && site.y == m_y.back()) continue;
+                m_x.push_back(site.x);
+                m_y.push_back(site.y);
+                m_ids.push_back(site.id);
+            }
+        }
+
+        // greedy in id order like vtkDelaunay2D's insertion: a point is left out when it lies within distance (in
+        // xy) of a point kept before it. Points without any closer point of smaller id are kept in parallel, only the
+        // rest is decided in id order against the kept ones.
+        std::vector<char> KeepPoints(vtkPoints* points, double const bounds[6], double distance) const
+        {
+            auto const count = points->GetNumberOfPoints();
+            std::vector<char> keep(count, 1);
+            if (!(distance > 0)) return keep;
+            // cells of the size of distance, row by row
+            auto const columns = static_cast<std::uint64_t>((bounds[1] - bounds[0]) / distance) + 3;
+            auto const cell = [&](double const x[3]) {
+                return (static_cast<std::uint64_t>((x[1] - bounds[2]) / distance) + 1) * columns +
+                       static_cast<std::uint64_t>((x[0] - bounds[0]) / distance) + 1;
+            };
+            std::vector<std::pair<std::uint64_t, vtkIdType>> cells(count);
+            vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+                for (auto id = begin; id < end; id++)
+                {
+                    double x[3];
+                    points->GetPoint(id, x);
+                    cells[id] = {cell(x), id};
+                }
+            });
+            vtkSMPTools::Sort(cells.begin(), cells.end());
+
+            // true when a point of smaller id within distance passes the filter
+            auto const distance2 = distance * distance;
+            auto const near = [&](vtkIdType id, auto&& filter) {
+                double x[3];
+                points->GetPoint(id, x);
+                auto const c = cell(x);
+                // the 3 cells of each neighbouring row are one run of the sorted cells
+                for (auto row : {c - columns, c, c + columns})
+                {
+                    auto it = std::lower_bound(cells.begin(), cells.end(), std::make_pair(row - 1, vtkIdType(0)));
+                    for (; it != cells.end() && it->first <= row + 1; ++it)
+                    {
+                        if (it->second >= id || !filter(it->second)) continue;
+                        double y[3];
+                        points->GetPoint(it->second, y);
+                        if ((x[0] - y[0]) * (x[0] - y[0]) + (x[1] - y[1]) * (x[1] - y[1]) <= distance2) return true;
+                    }
+                }
+                return false;
+            };
+            constexpr char undecided = 2;
+            vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+                for (auto id = begin; id < end; id++)
+                    if (near(id, [](vtkIdType) { return true; })) keep[id] = undecided;
+            });
+            // every smaller id is final when a point is decided
+            for (vtkIdType id = 0; id < count; id++)
+                if (keep[id] == undecided) keep[id] = !near(id, [&](vtkIdType other) { return keep[other] == 1; });
+            return keep;
+        }
+
+        // quad edge algebra: edge e = 4 * quad + rotation, rotation 0 and 2 are the two directions of the edge
+        static std::int32_t Rot(std::int32_t e) { return (e & ~3) | ((e + 1) & 3); }
+        static std::int32_t Sym(std::int32_t e) { return (e & ~3) | ((e + 2) & 3); }
+        static std::int32_t RotInv(std::int32_t e) { return (e & ~3) | ((e + 3) & 3); }
+        std::int32_t Onext(std::int32_t e) const { return m_next[e]; }
+        std::int32_t Oprev(std::int32_t e) const { return Rot(m_next[Rot(e)]); }
+        std::int32_t Lnext(std::int32_t e) const { return Rot(m_next[RotInv(e)]); }
+        std::int32_t Rprev(std::int32_t e) const { return m_next[Sym(e)]; }
+        std::int32_t Org(std::int32_t e) const { return m_data[e]; }
+        std::int32_t Dest(std::int32_t e) const { return m_data[Sym(e)]; }
+
+        std::int32_t MakeEdge(std::int32_t org, std::int32_t dest, Arena& arena)
+        {
+            auto const e = arena.Allocate() * 4;
+            m_next[e] = e;
+            m_next[e + 1] = e + 3;
+            m_next[e + 2] = e + 2;
+            m_next[e + 3] = e + 1;
+            m_data[e] = org;
+            m_data[e + 1] = 1; // alive
+            m_data[e + 2] = dest;
+            return e;
+        }
+
+        void Splice(std::int32_t a, std::int32_t b)
+        {
+            auto const alpha = Rot(m_next[a]);
+            auto const beta = Rot(m_next[b]);
+            std::swap(m_next[a], m_next[b]);
+            std::swap(m_next[alpha], m_next[beta]);
+        }
+
+        std::int32_t Connect(std::int32_t a, std::int32_t b, Arena& arena)
+        {
+            auto const e = MakeEdge(Dest(a), Org(b), arena);
+            Splice(e, Lnext(a));
+            Splice(Sym(e), b);
+            return e;
+        }
+
+        void DeleteEdge(std::int32_t e, Arena& arena)
+        {
+            Splice(e, Oprev(e));
+            Splice(Sym(e), Oprev(Sym(e)));
+            m_data[(e & ~3) + 1] = 0;
+            arena.free.push_back(e >> 2);
+        }
+
+        // > 0 when a, b, c turn counter clockwise; exact, the lattice differences stay below 2^31
+        std::int64_t Orient(std::int32_t a, std::int32_t b, std::int32_t c) const
+        {
+            return (m_x[b] - m_x[a]) * (m_y[c] - m_y[a]) - (m_y[b] - m_y[a]) * (m_x[c] - m_x[a]);
+        }
+
+        bool RightOf(std::int32_t p, std::int32_t e) const { return Orient(p, Dest(e), Org(e)) > 0; }
+
+        bool LeftOf(std::int32_t p, std::int32_t e) const { return Orient(p, Org(e), Dest(e)) > 0; }
+
+        // d strictly inside the circle through a, b, c (counter clockwise)
+        bool InCircle(std::int32_t a, std::int32_t b, std::int32_t c, std::int32_t d) const
+        {
+            std::int64_t const adx = m_x[a] - m_x[d], ady = m_y[a] - m_y[d];
+            std::int64_t const bdx = m_x[b] - m_x[d], bdy = m_y[b] - m_y[d];
+            std::int64_t const cdx = m_x[c] - m_x[d], cdy = m_y[c] - m_y[d];
+            std::int64_t const alift = adx * adx + ady * ady;
+            std::int64_t const blift = bdx * bdx + bdy * bdy;
+            std::int64_t const clift = cdx * cdx + cdy * cdy;
+            std::int64_t const bc = bdx * cdy - cdx * bdy;
+            std::int64_t const ca = cdx * ady - adx * cdy;
+            std::int64_t const ab = adx * bdy - bdx * ady;
+
+            // floating point first, with Shewchuk's error bound; the inputs are exact in double
+            auto const det = double(alift) * double(bc) + double(blift) * double(ca) + double(clift) * double(ab);
+            auto const permanent =
+                (std::abs(double(bdx) * double(cdy)) + std::abs(double(cdx) * double(bdy))) * double(alift) +
+                (std::abs(double(cdx) * double(ady)) + std::abs(double(adx) * double(cdy))) * double(blift) +
+                (std::abs(double(adx) * double(bdy)) + std::abs(double(bdx) * double(ady))) * double(clift);
+            constexpr double epsilon = std::numeric_limits<double>::epsilon() / 2;
+            if (std::abs(det) > (10 + 96 * epsilon) * epsilon * permanent) return det > 0;
+
+            auto const exact = Wide::Product(alift, bc) + Wide::Product(blift, ca) + Wide::Product(clift, ab);
+            return exact.Positive();
+        }
+
+        // signed 128 bit integer, enough for the incircle terms (below 2^124)
+        struct Wide
+        {
+            std::uint64_t high = 0, low = 0;
+
+            static Wide Product(std::int64_t a, std::int64_t b)
+            {
+                auto const negative = (a < 0) != (b < 0);
+                auto const x = static_cast<std::uint64_t>(a < 0 ? -a : a);
+                auto const y = static_cast<std::uint64_t>(b < 0 ? -b : b);
+                auto const x0 = x & 0xffffffff, x1 = x >> 32, y0 = y & 0xffffffff, y1 = y >> 32;
+                auto const p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+                auto const middle = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+                Wide w;
+                w.low = (middle << 32) | (p00 & 0xffffffff);
+                w.high = p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+                return negative ? -w : w;
+            }
+
+            Wide operator-() const
+            {
+                Wide w;
+                w.low = ~low + 1;
+                w.high = ~high + (w.low == 0 ? 1 : 0);
+                return w;
+            }
+
+            Wide operator+(Wide const& o) const
+            {
+                Wide w;
+                w.low = low + o.low;
+                w.high = high + o.high + (w.low < low ? 1 : 0);
+                return w;
+            }
+
+            bool Positive() const { return static_cast<std::int64_t>(high) > 0 || (high == 0 && low != 0); }
+        };
+
+        // Guibas and Stolfi: the hull edges (ccw out of the leftmost point, cw out of the rightmost) of the
+        // triangulation of the sorted points [begin, end), at least 2
+        std::pair<std::int32_t, std::int32_t> Triangulate(std::int32_t begin, std::int32_t end, Arena& arena)
+        {
+            auto const n = end - begin;
+            if (n == 2)
+            {
+                auto const a = MakeEdge(begin, begin + 1, arena);
+                return {a, Sym(a)};
+            }
+            if (n == 3)
+            {
+                auto const a = MakeEdge(begin, begin + 1, arena);
+                auto const b = MakeEdge(begin + 1, begin + 2, arena);
+                Splice(Sym(a), b);
+                auto const orient = Orient(begin, begin + 1, begin + 2);
+                if (orient > 0)
+                {
+                    Connect(b, a, arena);
+                    return {a, Sym(b)};
+                }
+                if (orient < 0)
+                {
+                    auto const c = Connect(b, a, arena);
+                    return {Sym(c), c};
+                }
+                return {a, Sym(b)}; // collinear
+            }
+            auto const middle = begin + n / 2;
+            auto const left = Triangulate(begin, middle, arena);
+            auto const right = Triangulate(middle, end, arena);
+            return Merge(left.first, left.second, right.first, right.second, arena);
+        }
+
+        std::pair<std::int32_t, std::int32_t> Merge(std::int32_t ldo, std::int32_t ldi, std::int32_t rdi,
+                                                    std::int32_t rdo, Arena& arena)
+        {
+            // lower common tangent
+            for (;;)
+            {
+                if (LeftOf(Org(rdi), ldi))
+                    ldi = Lnext(ldi);
+                else if (RightOf(Org(ldi), rdi))
+                    rdi = Rprev(rdi);
+                else
+                    break;
+            }
+            auto basel = Connect(Sym(rdi), ldi, arena);
+            if (Org(ldi) == Org(ldo)) ldo = Sym(basel);
+            if (Org(rdi) == Org(rdo)) rdo = basel;
+
+            // zip up the seam
+            for (;;)
+            {
+                auto const valid = [&](std::int32_t e) { return RightOf(Dest(e), basel); };
+                auto lcand = Onext(Sym(basel));
+                if (valid(lcand))
+                    while (InCircle(Dest(basel), Org(basel), Dest(lcand), Dest(Onext(lcand))))
+                    {
+                        auto const t = Onext(lcand);
+                        DeleteEdge(lcand, arena);
+                        lcand = t;
+                    }
+                auto rcand = Oprev(basel);
+                if (valid(rcand))
+                    while (InCircle(Dest(basel), Org(basel), Dest(rcand), Dest(Oprev(rcand))))
+                    {
+                        auto const t = Oprev(rcand);
+                        DeleteEdge(rcand, arena);
+                        rcand = t;
+                    }
+                auto const lvalid = valid(lcand), rvalid = valid(rcand);
+                if (!lvalid && !rvalid) break;
+                if (!lvalid || (rvalid && InCircle(Dest(lcand), Org(lcand), Org(rcand), Dest(rcand))))
+                    basel = Connect(rcand, Sym(basel), arena);
+                else
+                    basel = Connect(Sym(basel), Sym(lcand), arena);
+            }
+            return {ldo, rdo};
+        }
+
+        // every counter clockwise face of three edges, reported by its smallest edge
+        vtkSmartPointer<vtkCellArray> Triangles() const
+        {
+            auto const quads = static_cast<vtkIdType>(m_data.size() / 4);
+            vtkSMPThreadLocal<std::vector<vtkIdType>> local;
+            vtkSMPTools::For(0, quads, [&](vtkIdType begin, vtkIdType end) {
+                auto& triangles = local.Local();
+                for (auto q = begin; q < end; q++)
+                {
+                    if (!m_data[q * 4 + 1]) continue;
+                    for (auto e : {static_cast<std::int32_t>(q * 4), static_cast<std::int32_t>(q * 4 + 2)})
+                    {
+                        auto const f = Lnext(e), g = Lnext(f);
+                        if (Lnext(g) != e || f < e || g < e || Orient(Org(e), Org(f), Org(g)) <= 0) continue;
+                        triangles.insert(triangles.end(), {m_ids[Org(e)], m_ids[Org(f)], m_ids[Org(g)]});
+                    }
+                }
+            });
+            vtkIdType size = 0;
+            for (auto& triangles : local)
+                size += static_cast<vtkIdType>(triangles.size());
+
+            vtkNew<vtkIdTypeArray> offsets, connectivity;
+            offsets->SetNumberOfValues(size / 3 + 1);
+            connectivity->SetNumberOfValues(size);
+            auto* ids = connectivity->GetPointer(0);
+            for (auto& triangles : local)
+                ids = std::copy(triangles.begin(), triangles.end(), ids);
+            auto* offset = offsets->GetPointer(0);
+            vtkSMPTools::For(0, size / 3 + 1, [&](vtkIdType begin, vtkIdType end) {
+                for (auto i = begin; i < end; i++)
+                    offset[i] = i * 3;
+            });
+            auto polys = vtkSmartPointer<vtkCellArray>::New();
+            polys->SetData(offsets, connectivity);
+            return polys;
+        }
+
+    private:
+        double m_tolerance = 0.00001;
+        vtkIdType m_discarded = 0;
+        std::vector<std::int64_t> m_x, m_y; // lattice coordinates of the kept points, sorted
+        std::vector<vtkIdType> m_ids;       // their input ids
+        std::vector<std::int32_t> m_next;   // Onext of every edge
+        std::vector<std::int32_t> m_data;   // origin point of rotation 0 and 2, alive flag in rotation 1
+    };
+} // namespace
@@ -0,0 +1,134 @@
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkCellArray.h>
+#include <vtkDelaunay2D.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "delaunay_2d.h"
+
+// scattered heights over a unit square, a smooth terrain like the scans gen_mesh triangulates
+vtkSmartPointer<vtkPolyData> RandomHeights(vtkIdType count)
+{
+    std::mt19937_64 generator(count);
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+    vtkNew<vtkPoints> points;
+    points->SetDataTypeToFloat();
+    points->SetNumberOfPoints(count);
+    for (vtkIdType i = 0; i < count; i++)
+    {
+        auto const x = uniform(generator), y = uniform(generator);
+        points->SetPoint(i, x, y, 0.1 * std::sin(6 * x) * std::cos(4 * y));
+    }
+    auto polydata = vtkSmartPointer<vtkPolyData>::New();
+    polydata->SetPoints(points);
+    return polydata;
+}
+
+// the same terrain sampled on a regular grid, row by row like a scanner writes it
+vtkSmartPointer<vtkPolyData> GridHeights(vtkIdType count)
+{
+    auto const side = static_cast<vtkIdType>(std::sqrt(static_cast<double>(count)));
+    vtkNew<vtkPoints> points;
+    points->SetDataTypeToFloat();
+    points->SetNumberOfPoints(side * side);
+    for (vtkIdType j = 0; j < side; j++)
+        for (vtkIdType i = 0; i < side; i++)
+        {
+            auto const x = static_cast<double>(i) / side, y = static_cast<double>(j) / side;
+            points->SetPoint(j * side + i, x, y, 0.1 * std::sin(6 * x) * std::cos(4 * y));
+        }
+    auto polydata = vtkSmartPointer<vtkPolyData>::New();
+    polydata->SetPoints(points);
+    return polydata;
+}
+
+// points used by the triangles, the ones a triangulation kept
+vtkIdType UsedPoints(vtkPolyData* polydata)
+{
+    std::vector<char> used(polydata->GetNumberOfPoints(), 0);
+    auto* polys = polydata->GetPolys();
+    vtkIdType size;
+    vtkIdType const* ids;
+    for (polys->InitTraversal(); polys->GetNextCell(size, ids);)
+        for (vtkIdType i = 0; i < size; i++)
+            used[ids[i]] = 1;
+    return std::count(used.begin(), used.end(), 1);
+}
+
+void Compare(char const* name, vtkPolyData* polydata, double tolerance, int runs, bool reference)
+{
+    // best of runs
+    ParallelDelaunay2D delaunay;
+    delaunay.SetTolerance(tolerance);
+    vtkSmartPointer<vtkPolyData> output;
+    auto ms = std::numeric_limits<double>::max();
+    for (int run = 0; run < runs; run++)
+    {
+        auto const begin = std::chrono::steady_clock::now();
+        output = delaunay.Execute(polydata);
+        auto const end = std::chrono::steady_clock::now();
+        ms = std::min(ms, std::chrono::duration<double, std::milli>(end - begin).count());
+    }
+    if (!output)
+    {
+        std::cout << polydata->GetNumberOfPoints() << " " << name << " points: more than "
+                  << ParallelDelaunay2D::GetMaximumNumberOfPoints() << ", not triangulated" << std::endl;
+        return;
+    }
+    std::cout << polydata->GetNumberOfPoints() << " " << name << " points, tolerance " << tolerance
+              << ": ParallelDelaunay2D " << ms << " ms, " << output->GetNumberOfPolys() << " triangles, "
+              << UsedPoints(output) << " points kept";
+
+    // vtkDelaunay2D is serial and slow on large inputs, run it once
+    if (reference)
+    {
+        auto const begin = std::chrono::steady_clock::now();
+        vtkNew<vtkDelaunay2D> delaunay2d;
+        delaunay2d->SetInputData(polydata);
+        delaunay2d->SetTolerance(tolerance);
+        delaunay2d->Update();
+        auto const reference_ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "; vtkDelaunay2D " << reference_ms << " ms, " << delaunay2d->GetOutput()->GetNumberOfPolys()
+                  << " triangles, " << UsedPoints(delaunay2d->GetOutput()) << " points kept, speedup "
+                  << reference_ms / ms << "x";
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && std::string(argv[1]) == "-h")
+    {
+        std::cout << "Usage: " << argv[0]
+                  << " [max_points=10000000] [max_vtk_points=1000000] [tolerance=0.00001] [runs=3]" << std::endl;
+        std::cout << "times vtkDelaunay2D against the parallel ParallelDelaunay2D for 10k, 100k, ... random points, "
+                     "and for row ordered grids at gen_mesh's tolerance 0.001"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto const max_points = argc > 1 ? std::stoll(argv[1]) : 10000000;
+    auto const max_vtk_points = argc > 2 ? std::stoll(argv[2]) : 1000000;
+    auto const tolerance = argc > 3 ? std::stod(argv[3]) : 0.00001;
+    auto const runs = argc > 4 ? std::max(std::stoi(argv[4]), 1) : 3;
+    std::cout << vtkSMPTools::GetEstimatedNumberOfThreads() << " threads, " << vtkSMPTools::GetBackend()
+              << " backend" << std::endl;
+
+    for (vtkIdType count = 10000; count <= max_points; count *= 10)
+    {
+        Compare("random", RandomHeights(count), tolerance, runs, count <= max_vtk_points);
+        // most points of a dense scan are within the tolerance of a neighbour
+        Compare("grid", GridHeights(count), 0.001, runs, count <= max_vtk_points);
+    }
+    return EXIT_SUCCESS;
+}
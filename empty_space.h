@@ -0,0 +1,286 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkWeakPointer.h>
+#include <vtkObjectFactory.h>
+#include <vtkCommand.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkVolumeMapper.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace
+{
+    // Per-brick min/max of a single component volume, built once in parallel.
+    // Bricks overlap their neighbours by one voxel, so a brick also covers the samples interpolated across its
+    // upper faces. Classify marks the bricks whose scalar range reaches a non-zero opacity; it only looks at
+    // the per-brick ranges (O(1) per brick through a sparse max table), so it is cheap to redo whenever the
+    // opacity transfer function changes.
+    class BrickOccupancy
+    {
+    public:
+        explicit BrickOccupancy(int brick_size = 8) : m_brick_size(std::max(brick_size, 2)) {}
+
+        bool SetInputData(vtkImageData* img)
+        {
+            m_min.clear();
+            m_max.clear();
+            m_occupied.clear();
+            if (!img || img->GetNumberOfScalarComponents() != 1 || !img->GetPointData()->GetScalars()) return false;
+
+            img->GetDimensions(m_dims);
+            img->GetOrigin(m_origin);
+            img->GetSpacing(m_spacing);
+            img->GetExtent(m_extent);
+            for (int i = 0; i < 3; i++)
+                m_brick_dims[i] = std::max((m_dims[i] - 1 + m_brick_size - 1) / m_brick_size, 1);
+            auto const count = static_cast<size_t>(m_brick_dims[0]) * m_brick_dims[1] * m_brick_dims[2];
+            m_min.resize(count);
+            m_max.resize(count);
+            img->GetScalarRange(m_range);
+
+            switch (img->GetScalarType())
+            {
+                vtkTemplateMacro(BuildMinMax(static_cast<VTK_TT const*>(img->GetScalarPointer())));
+            default:
+                return false;
+            }
+            m_occupied.assign(count, 1);
+            return true;
+        }
+
+        int GetBrickSize() const { return m_brick_size; }
+
+        int const* GetBrickDimensions() const { return m_brick_dims; }
+
+        size_t GetNumberOfBricks() const { return m_min.size(); }
+
+        size_t BrickIndex(int bx, int by, int bz) const
+        {
+            return (static_cast<size_t>(bz) * m_brick_dims[1] + by) * m_brick_dims[0] + bx;
+        }
+
+        float GetBrickMin(size_t index) const { return m_min[index]; }
+
+        float GetBrickMax(size_t index) const { return m_max[index]; }
+
+        bool IsOccupied(size_t index) const { return m_occupied[index] != 0; }
+
+        // mark the bricks that hold at least one voxel with non-zero opacity, returns the number of occupied bricks
+        size_t Classify(vtkPiecewiseFunction* opacity)
+        {
+            if (m_min.empty()) return 0;
+            constexpr int table_size = 1024;
+            auto const lo = m_range[0], hi = m_range[1];
+            auto const scale = hi > lo ? (table_size - 1) / (hi - lo) : 0.0;
+
+            // sparse table: level k holds the max over [i, i + 2^k)
+            std::vector<std::vector<double>> levels(1, std::vector<double>(table_size));
+            // the table follows the clamping of the function like the mappers' lookups: with ClampingOn the first
+            // and last node values extend to the ends of the scalar range, so a non-zero end node makes every
+            // brick beyond it visible, with ClampingOff the values outside the nodes are transparent
+            opacity->GetTable(lo, hi > lo ? hi : lo + 1, table_size, levels[0].data());
+            // the table samples the function, make sure narrow peaks between two samples are not lost
+            for (int n = 0; n < opacity->GetSize(); n++)
+            {
+                double node[4];
+                opacity->GetNodeValue(n, node);
+                if (node[0] < lo || node[0] > hi) continue;
+                auto const t = (node[0] - lo) * scale;
+                for (auto i : {static_cast<int>(std::floor(t)), static_cast<int>(std::ceil(t))})
+                {
+                    auto& v = levels[0][std::clamp(i, 0, table_size - 1)];
+                    v = std::max(v, node[1]);
+                }
+            }
+            for (int k = 1; (1 << k) <= table_size; k++)
+            {
+                auto const& prev = levels[k - 1];
+                std::vector<double> level(table_size - (1 << k) + 1);
+                for (size_t i = 0; i < level.size(); i++)
+                    level[i] = std::max(prev[i], prev[i + (1 << (k - 1))]);
+                levels.push_back(std::move(level));
+            }
+
+            vtkSMPTools::For(0, static_cast<vtkIdType>(m_min.size()), 4096, [&](vtkIdType begin, vtkIdType end) {
+                for (auto b = begin; b < end; b++)
+                {
+                    // widen by one table entry, the table is sampled and interpolation may reach the neighbours
+                    auto const i0 =
+                        std::clamp(static_cast<int>(std::floor((m_min[b] - lo) * scale)) - 1, 0, table_size - 1);
+                    auto const i1 =
+                        std::clamp(static_cast<int>(std::ceil((m_max[b] - lo) * scale)) + 1, i0, table_size - 1);
+                    int k = 0;
+                    while ((2 << k) <= i1 - i0 + 1)
+                        k++;
+                    auto const max_opacity = std::max(levels[k][i0], levels[k][i1 - (1 << k) + 1]);
+                    m_occupied[b] = max_opacity > 0 ? 1 : 0;
+                }
+            });
+            return static_cast<size_t>(std::count(m_occupied.begin(), m_occupied.end(), 1));
+        }
+
+        // voxel extent covered by the occupied bricks, false when everything is transparent
+        bool GetOccupiedExtent(int ext[6]) const
+        {
+            int lower[3]{m_brick_dims[0], m_brick_dims[1], m_brick_dims[2]}, upper[3]{-1, -1, -1};
+            for (int bz = 0; bz < m_brick_dims[2]; bz++)
+                for (int by = 0; by < m_brick_dims[1]; by++)
+                    for (int bx = 0; bx < m_brick_dims[0]; bx++)
+                    {
+                        if (!m_occupied[BrickIndex(bx, by, bz)]) continue;
+                        int const b[3]{bx, by, bz};
+                        for (int i = 0; i < 3; i++)
+                        {
+                            lower[i] = std::min(lower[i], b[i]);
+                            upper[i] = std::max(upper[i], b[i]);
+                        }
+                    }
+            if (upper[0] < 0) return false;
+            for (int i = 0; i < 3; i++)
+            {
+                ext[i * 2] = m_extent[i * 2] + lower[i] * m_brick_size;
+                ext[i * 2 + 1] = std::min(m_extent[i * 2] + (upper[i] + 1) * m_brick_size, m_extent[i * 2 + 1]);
+            }
+            return true;
+        }
+
+        // same as GetOccupiedExtent in data coordinates (origin + index * spacing)
+        bool GetOccupiedBounds(double bounds[6]) const
+        {
+            int ext[6];
+            if (!GetOccupiedExtent(ext)) return false;
+            for (int i = 0; i < 6; i++)
+                bounds[i] = m_origin[i / 2] + ext[i] * m_spacing[i / 2];
+            return true;
+        }
+
+    private:
+        template <typename T>
+        void BuildMinMax(T const* data)
+        {
+            auto const nx = static_cast<vtkIdType>(m_dims[0]), ny = static_cast<vtkIdType>(m_dims[1]);
+            auto const bs = m_brick_size;
+            vtkSMPTools::For(0, static_cast<vtkIdType>(m_min.size()), [&](vtkIdType begin, vtkIdType end) {
+                for (auto b = begin; b < end; b++)
+                {
+                    auto const bx = static_cast<int>(b % m_brick_dims[0]);
+                    auto const by = static_cast<int>((b / m_brick_dims[0]) % m_brick_dims[1]);
+                    auto const bz = static_cast<int>(b / (static_cast<vtkIdType>(m_brick_dims[0]) * m_brick_dims[1]));
+                    auto const x0 = bx * bs, x1 = std::min(x0 + bs, m_dims[0] - 1);
+                    auto const y0 = by * bs, y1 = std::min(y0 + bs, m_dims[1] - 1);
+                    auto const z0 = bz * bs, z1 = std::min(z0 + bs, m_dims[2] - 1);
+                    auto lo = std::numeric_limits<double>::max(), hi = std::numeric_limits<double>::lowest();
+                    for (auto z = z0; z <= z1; z++)
+                        for (auto y = y0; y <= y1; y++)
+                        {
+                            auto const* row = data + (z * ny + y) * nx;
+                            for (auto x = x0; x <= x1; x++)
+                            {
+                                auto const v = static_cast<double>(row[x]);
+                                lo = std::min(lo, v);
+                                hi = std::max(hi, v);
+                            }
+                        }
+                    m_min[b] = static_cast<float>(lo);
+                    m_max[b] = static_cast<float>(hi);
+                }
+            });
+        }
+
+    private:
+        int m_brick_size;
+        int m_dims[3]{0, 0, 0};
+        int m_extent[6]{0, -1, 0, -1, 0, -1};
+        int m_brick_dims[3]{0, 0, 0};
+        double m_origin[3]{0, 0, 0};
+        double m_spacing[3]{1, 1, 1};
+        double m_range[2]{0, 1};
+        std::vector<float> m_min;
+        std::vector<float> m_max;
+        std::vector<unsigned char> m_occupied;
+    };
+
+    // Keeps the cropping region of a volume mapper on the occupied bricks of its input: rays of the CPU ray caster
+    // start and stop at the occupied box instead of marching through the transparent space around the anatomy.
+    // Only the box is cropped, vtkFixedPointVolumeRayCastMapper leaps over the empty space inside it with its own
+    // min/max volume; CpuMipRenderer (cpu_mip.h) skips the interior empty bricks itself.
+    // A sub volume cropping set on the mapper by the user is kept: the occupied box is intersected with it. Other
+    // cropping region flags cannot be intersected with a box, the mapper is left alone while they are set.
+    // Observe the scalar opacity function with it (ModifiedEvent), the bricks are reclassified on every change.
+    // Composite rendering is unchanged by the crop. With the maximum intensity blend it is too as long as the
+    // transparent scalars are the lowest ones (a ramp from zero, as in ray_cast_mip): a ray whose maximum lies in
+    // a cropped brick is transparent either way.
+    class MEmptySpaceSkipping: public vtkCommand
+    {
+    public:
+        static MEmptySpaceSkipping* New();
+        vtkTypeMacro(MEmptySpaceSkipping, vtkCommand);
+
+        void Setup(vtkVolumeMapper* mapper, vtkImageData* img, vtkPiecewiseFunction* opacity, int brick_size = 8)
+        {
+            m_mapper = mapper;
+            m_occupancy = BrickOccupancy(brick_size);
+            m_valid = m_occupancy.SetInputData(img);
+            m_user_cropping = mapper->GetCropping() != 0;
+            mapper->GetCroppingRegionPlanes(m_user_planes);
+            Update(opacity);
+            opacity->AddObserver(vtkCommand::ModifiedEvent, this);
+        }
+
+        BrickOccupancy const& GetOccupancy() const { return m_occupancy; }
+
+        void Execute(vtkObject* caller, unsigned long, void*) override
+        {
+            Update(static_cast<vtkPiecewiseFunction*>(caller));
+        }
+
+    private:
+        void Update(vtkPiecewiseFunction* opacity)
+        {
+            if (!m_valid || !m_mapper) return;
+            // planes changed since the last update were set by the user, they become the region to intersect with
+            double planes[6];
+            m_mapper->GetCroppingRegionPlanes(planes);
+            if (!std::equal(planes, planes + 6, m_planes))
+            {
+                m_user_cropping = m_mapper->GetCropping() != 0;
+                std::copy_n(planes, 6, m_user_planes);
+            }
+            if (m_user_cropping && m_mapper->GetCroppingRegionFlags() != VTK_CROP_SUBVOLUME) return;
+
+            m_occupancy.Classify(opacity);
+            double bounds[6];
+            auto visible = m_occupancy.GetOccupiedBounds(bounds);
+            for (int i = 0; i < 3 && visible && m_user_cropping; i++)
+            {
+                bounds[i * 2] = std::max(bounds[i * 2], std::min(m_user_planes[i * 2], m_user_planes[i * 2 + 1]));
+                bounds[i * 2 + 1] =
+                    std::min(bounds[i * 2 + 1], std::max(m_user_planes[i * 2], m_user_planes[i * 2 + 1]));
+                visible = bounds[i * 2] <= bounds[i * 2 + 1];
+            }
+            if (!visible) std::fill(bounds, bounds + 6, 0.0); // nothing visible, nothing to march through
+            std::copy_n(bounds, 6, m_planes);
+            m_mapper->SetCroppingRegionPlanes(bounds);
+            m_mapper->SetCroppingRegionFlagsToSubVolume();
+            m_mapper->CroppingOn();
+        }
+
+    private:
+        vtkWeakPointer<vtkVolumeMapper> m_mapper;
+        BrickOccupancy m_occupancy;
+        bool m_valid = false;
+        bool m_user_cropping = false;
+        double m_user_planes[6]{0, 0, 0, 0, 0, 0};
+        double m_planes[6]{0, 0, 0, 0, 0, 0}; // last planes set by Update
+    };
+    vtkStandardNewMacro(MEmptySpaceSkipping);
+} // namespace
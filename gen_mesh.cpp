@@ -1,9 +1,6 @@
 #include <vtkNew.h>
-#include <vtkDelimitedTextReader.h>
-#include <vtkTable.h>
 #include <vtkPoints.h>
 #include <vtkPolyData.h>
-#include <vtkDelaunay2D.h>
 
 #include <vtkSurfaceReconstructionFilter.h>
 #include <vtkContourFilter.h>
@@ -12,7 +9,6 @@
 #include <vtkImageData.h>
 #include <vtkImageAccumulate.h>
 
-#include <vtkPCANormalEstimation.h>
 #include <vtkSignedDistance.h>
 #include <vtkExtractSurface.h>
 
@@ -46,17 +42,26 @@
 #include <vtkTransformTextureCoords.h>
 #endif
 
+#include <charconv>
 #include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <string>
+
+#include "delaunay_2d.h"
+#include "height_grid.h"
+#include "point_cache.h"
+#include "point_normals.h"
+#include "tiled_surface.h"
 
 vtkSmartPointer<vtkPolyData> delaunay2d(vtkSmartPointer<vtkPolyData> polydata)
 {
-    vtkNew<vtkDelaunay2D> delaunay;
-    delaunay->SetInputData(polydata);
-    delaunay->SetTolerance(0.001);
-    delaunay->Update();
-
-    return delaunay->GetOutput();
+    // parallel divide and conquer in place of vtkDelaunay2D (compared in delaunay_bench)
+    ParallelDelaunay2D delaunay;
+    delaunay.SetTolerance(0.001);
+    return delaunay.Execute(polydata);
 }
 
 vtkSmartPointer<vtkPolyData> surface_reconstruction_filter(vtkSmartPointer<vtkPolyData> polydata)
@@ -83,8 +88,28 @@ vtkSmartPointer<vtkPolyData> surface_reconstruction_filter(vtkSmartPointer<vtkPo
     return reverse->GetOutput();
 }
 
+// outward normals for the signed distance (parallel PCA and graph traversal, point_normals.h)
+PointNormalEstimation normal_estimation(vtkIdType count)
+{
+    int sampleSize = count * 0.00005;
+    if (sampleSize < 10) sampleSize = 10;
+
+    PointNormalEstimation normals;
+    normals.SetSampleSize(sampleSize);
+    normals.SetOrientationToGraphTraversal();
+    return normals;
+}
+
+vtkSmartPointer<vtkPolyData> estimate_normals(vtkSmartPointer<vtkPolyData> polydata)
+{
+    return normal_estimation(polydata->GetNumberOfPoints()).Execute(polydata);
+}
+
 // seems same with vtkSurfaceReconstructionFilter
-vtkSmartPointer<vtkPolyData> extract_surface(vtkSmartPointer<vtkPolyData> polydata)
+// uses the normals of polydata when it has some (e.g. from the point cloud cache)
+// dense grid of dimension^3 voxels, vtkExtractSurface fills the holes of the scan (the sparse band of the tiled
+// reconstruction leaves them open)
+vtkSmartPointer<vtkPolyData> extract_surface(vtkSmartPointer<vtkPolyData> polydata, int dimension)
 {
     double bounds[6];
     polydata->GetBounds(bounds);
@@ -92,19 +117,9 @@ vtkSmartPointer<vtkPolyData> extract_surface(vtkSmartPointer<vtkPolyData> polyda
     for (int i = 0; i < 3; ++i)
         range[i] = bounds[2 * i + 1] - bounds[2 * i];
 
-    int sampleSize = polydata->GetNumberOfPoints() * 0.00005;
-    if (sampleSize < 10) sampleSize = 10;
-
-    vtkNew<vtkPCANormalEstimation> normals;
-    normals->SetInputData(polydata);
-    normals->SetSampleSize(sampleSize);
-    normals->SetNormalOrientationToGraphTraversal();
-    normals->FlipNormalsOn();
-
     vtkNew<vtkSignedDistance> distance;
-    distance->SetInputConnection(normals->GetOutputPort());
+    distance->SetInputData(polydata->GetPointData()->GetNormals() ? polydata : estimate_normals(polydata));
 
-    int dimension = 256;
     double radius = std::max(std::max(range[0], range[1]), range[2]) / static_cast<double>(dimension) * 4; // ~4 voxels
     // std::cout << "Radius: " << radius << std::endl;
 
@@ -126,44 +141,122 @@ int main(int argc, char* argv[])
 {
     // if (argc < 4)
     // {
-    //     std::cout << "Usage: " << argv[0] << " Filename e.g height.txt output.ply texture.png" << std::endl;
+    //     std::cout << "Usage: " << argv[0]
+    //               << " Filename e.g height.txt output.ply texture.png [resolution=256] [memory_budget_mb]"
+    //               << std::endl;
     //     return EXIT_FAILURE;
     // }
     std::cout << "Height Path: " << argv[1] << '\n'
               << "Mesh Path: " << argv[2] << '\n'
               << "Texture Path: " << argv[3] << std::endl;
 
-    auto tp = std::chrono::high_resolution_clock::now();
-
-    // vtkDelimitedTextReader can only skip the first row as header...
-    vtkNew<vtkDelimitedTextReader> reader;
-    reader->SetFileName(argv[1]);
-    reader->DetectNumericColumnsOn();
-    reader->SetFieldDelimiterCharacters(" ");
-    reader->Update();
+    // voxels along the longest side of the signed distance grid
+    int resolution = 256;
+    if (argc >= 5)
+    {
+        auto const* end = argv[4] + std::strlen(argv[4]);
+        auto const [last, error] = std::from_chars(argv[4], end, resolution);
+        if (error != std::errc() || last != end || resolution < 2)
+        {
+            std::cerr << "Invalid resolution " << argv[4] << ", expected an integer of at least 2" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-    vtkTable* table = reader->GetOutput();
+    auto tp = std::chrono::high_resolution_clock::now();
 
-    vtkNew<vtkPoints> points;
-    for (vtkIdType i = 0; i < table->GetNumberOfRows(); i += 1)
-        points->InsertNextPoint((table->GetValue(i, 0)).ToFloat(), (table->GetValue(i, 1)).ToFloat(),
-                                (table->GetValue(i, 2)).ToFloat());
+#if !defined(USE_DELAUNAY2D) && defined(USE_EXTRACT_SURFACE)
+    // a memory budget in MB as 5th argument: tiled out of core reconstruction streamed into the PLY, for scans
+    // that do not fit in memory
+    if (argc >= 6)
+    {
+        double budget_mb = 0;
+        auto const* end = argv[5] + std::strlen(argv[5]);
+        auto const [last, error] = std::from_chars(argv[5], end, budget_mb);
+        if (error != std::errc() || last != end || !std::isfinite(budget_mb) || budget_mb <= 0 ||
+            budget_mb >= static_cast<double>(std::numeric_limits<size_t>::max() >> 20))
+        {
+            std::cerr << "Invalid memory budget " << argv[5] << ", expected a positive number of MB" << std::endl;
+            return EXIT_FAILURE;
+        }
+        TiledSurfaceReconstruction tiled;
+        tiled.SetDimension(resolution);
+        tiled.SetMemoryBudget(static_cast<size_t>(budget_mb * (1 << 20)));
+        if (!tiled.Execute(argv[1], argv[2]))
+        {
+            std::cerr << "Cannot reconstruct " << argv[1] << " into " << argv[2] << std::endl;
+            return EXIT_FAILURE;
+        }
+        auto const tp1 = std::chrono::high_resolution_clock::now();
+        std::cout << "Tiled Reconstruction Consumes: "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(tp1 - tp).count() << " ms ("
+                  << tiled.GetNumberOfTiles() << " tiles, " << tiled.GetConcurrency() << " at a time, "
+                  << tiled.GetNumberOfVertices() << " vertices, " << tiled.GetNumberOfTriangles() << " triangles)"
+                  << std::endl;
+        return EXIT_SUCCESS;
+    }
+#endif
 
-    vtkNew<vtkPolyData> polydata;
-    polydata->SetPoints(points);
+    // binary cache next to the text (argv[1].pcloud) when up to date, else parsed in parallel and cached
+#if !defined(USE_DELAUNAY2D) && defined(USE_EXTRACT_SURFACE)
+    PointNormalSettings cachedNormals; // checked against the estimation settings below
+    auto polydata = LoadPointCloud(argv[1], &cachedNormals);
+#else
+    auto polydata = LoadPointCloud(argv[1]);
+#endif
+    if (!polydata)
+    {
+        std::cerr << "Cannot open " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
 
     auto tp1 = std::chrono::high_resolution_clock::now();
     std::cout << "Read XYZ Data Consumes: " << std::chrono::duration_cast<std::chrono::milliseconds>(tp1 - tp).count()
-              << " ms" << std::endl;
+              << " ms (" << polydata->GetNumberOfPoints() << " points)" << std::endl;
     tp = tp1;
 
+    // regularly gridded xy samples (a height map): two triangles per cell, no normals and no 3D grid
+    vtkSmartPointer<vtkPolyData> meshdata;
+    HeightGrid grid;
+    if (grid.Detect(polydata->GetPoints()))
+    {
+        meshdata = grid.Triangulate(polydata->GetPoints());
+        std::cout << "Height Grid: " << grid.GetDimensions()[0] << " x " << grid.GetDimensions()[1] << std::endl;
+    }
+    else
+    {
+#if !defined(USE_DELAUNAY2D) && defined(USE_EXTRACT_SURFACE)
+        // normals only depend on the points and the estimation settings, keep them in the cache for the next run
+        auto const normals = normal_estimation(polydata->GetNumberOfPoints());
+        if (cachedNormals != normals.GetSettings())
+        {
+            polydata = estimate_normals(polydata);
+            // the loaded points may still map the cache, which Windows does not let us replace
+            if (!PointCloudCache::Save(GetPointCloudCachePath(argv[1]), argv[1], polydata->GetPoints(),
+                                       polydata->GetPointData()->GetNormals(), normals.GetSettings()))
+                std::cerr << "Cannot update point cloud cache " << GetPointCloudCachePath(argv[1]) << std::endl;
+
+            tp1 = std::chrono::high_resolution_clock::now();
+            std::cout << "Estimate Normals Consumes: "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(tp1 - tp).count() << " ms" << std::endl;
+            tp = tp1;
+        }
+#endif
+
 #ifdef USE_DELAUNAY2D
-    auto meshdata = delaunay2d(polydata);
+        meshdata = delaunay2d(polydata);
+        if (!meshdata)
+        {
+            std::cerr << "Cannot triangulate more than " << ParallelDelaunay2D::GetMaximumNumberOfPoints()
+                      << " points" << std::endl;
+            return EXIT_FAILURE;
+        }
 #elif defined(USE_EXTRACT_SURFACE)
-    auto meshdata = extract_surface(polydata);
+        meshdata = extract_surface(polydata, resolution);
 #else
-    auto meshdata = surface_reconstruction_filter(polydata);
+        meshdata = surface_reconstruction_filter(polydata);
 #endif
+    }
 
     tp1 = std::chrono::high_resolution_clock::now();
     std::cout << "Surface Triangulation Consumes: "
@@ -182,18 +275,25 @@ int main(int argc, char* argv[])
         double bounds[6]{};
         meshdata->GetBounds(bounds);
 
-        vtkNew<vtkTextureMapToPlane> texturePlane;
-        texturePlane->SetOrigin(bounds[0], bounds[2], bounds[4]); // xmin, ymin, zmin -> BOTTOM LEFT CORNER
-        texturePlane->SetPoint1(bounds[1], bounds[2], bounds[4]); // xmax, ymin, zmin -> BOTTOM RIGHT CORNER
-        texturePlane->SetPoint2(bounds[0], bounds[3], bounds[4]); // xmin, ymax, zmin -> TOP LEFT CORNER
-        texturePlane->SetInputData(meshdata);
+        // the height grid path computes its texture coordinates itself
+        vtkSmartPointer<vtkPolyData> textured = meshdata;
+        if (!meshdata->GetPointData()->GetTCoords())
+        {
+            vtkNew<vtkTextureMapToPlane> texturePlane;
+            texturePlane->SetOrigin(bounds[0], bounds[2], bounds[4]); // xmin, ymin, zmin -> BOTTOM LEFT CORNER
+            texturePlane->SetPoint1(bounds[1], bounds[2], bounds[4]); // xmax, ymin, zmin -> BOTTOM RIGHT CORNER
+            texturePlane->SetPoint2(bounds[0], bounds[3], bounds[4]); // xmin, ymax, zmin -> TOP LEFT CORNER
+            texturePlane->SetInputData(meshdata);
+            texturePlane->Update();
+            textured = texturePlane->GetOutput();
+        }
 
         if (argc >= 4)
         {
             // write mesh to ply
             vtkNew<vtkPLYWriter> plyWriter;
             plyWriter->SetFileName(argv[2]);
-            plyWriter->SetInputConnection(texturePlane->GetOutputPort());
+            plyWriter->SetInputData(textured);
             plyWriter->Write();
             plyWriter->Update();
         }
@@ -208,7 +308,7 @@ int main(int argc, char* argv[])
         // need flip R (inverted y)
         // https://examples.vtk.org/site/VTKBook/08Chapter8/#Figure%208-10
         vtkNew<vtkTransformTextureCoords> transformTextureCoords;
-        transformTextureCoords->SetInputConnection(texturePlane->GetOutputPort());
+        transformTextureCoords->SetInputData(textured);
         transformTextureCoords->SetFlipR(true);
 
         //meshMapper->SetInputConnection(texturePlane->GetOutputPort());
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkCallbackCommand.h>
+#include <vtkCommand.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Gradient of a single component volume, computed once and shared by every renderer of that volume.
+    // Per voxel the normal is quantized to 16 bits (octahedral mapping, 8 bits per axis) and the magnitude to
+    // 8 bits relative to the largest magnitude, 3 bytes per voxel instead of 16 for float normal + magnitude.
+    // Central differences in world units (spacing aware), one sided on the borders.
+    // The gradients only depend on the scalars, so they stay valid across transfer function edits; Save/Load
+    // keep them next to the data so another executable opening the same volume does not compute them again.
+    class GradientVolume
+    {
+    public:
+        bool SetInputData(vtkImageData* img)
+        {
+            m_normals.clear();
+            m_magnitudes.clear();
+            if (!img || img->GetNumberOfScalarComponents() != 1 || !img->GetPointData()->GetScalars()) return false;
+
+            img->GetDimensions(m_dims);
+            img->GetSpacing(m_spacing);
+            auto const count = static_cast<size_t>(m_dims[0]) * m_dims[1] * m_dims[2];
+            m_normals.resize(count);
+            m_magnitudes.resize(count);
+            switch (img->GetScalarType())
+            {
+                vtkTemplateMacro(Compute(static_cast<VTK_TT const*>(img->GetScalarPointer())));
+            default:
+                m_normals.clear();
+                m_magnitudes.clear();
+                return false;
+            }
+            m_hash = Hash(img);
+            return true;
+        }
+
+        bool IsValid() const { return !m_normals.empty(); }
+
+        int const* GetDimensions() const { return m_dims; }
+
+        // unit normal of voxel index (x-fastest), zero where the volume is flat
+        void GetNormal(size_t index, float n[3]) const
+        {
+            if (m_magnitudes[index] == 0)
+            {
+                n[0] = n[1] = n[2] = 0;
+                return;
+            }
+            DecodeNormal(m_normals[index], n);
+        }
+
+        unsigned short GetEncodedNormal(size_t index) const { return m_normals[index]; }
+
+        float GetMagnitude(size_t index) const { return m_magnitudes[index] * m_magnitude_scale; }
+
+        unsigned char GetQuantizedMagnitude(size_t index) const { return m_magnitudes[index]; }
+
+        float GetMaxMagnitude() const { return m_magnitude_scale * 255; }
+
+        // bytes held by the normals and magnitudes
+        size_t GetMemorySize() const
+        {
+            return m_normals.size() * sizeof(m_normals[0]) + m_magnitudes.size() * sizeof(m_magnitudes[0]);
+        }
+
+        // true when the gradients were computed from img (same dimensions, spacing and scalars)
+        bool Matches(vtkImageData* img) const
+        {
+            if (!IsValid() || !img || !img->GetPointData()->GetScalars()) return false;
+            int dims[3];
+            double spacing[3];
+            img->GetDimensions(dims);
+            img->GetSpacing(spacing);
+            for (int i = 0; i < 3; i++)
+                if (dims[i] != m_dims[i] || spacing[i] != m_spacing[i]) return false;
+            return Hash(img) == m_hash;
+        }
+
+        bool Save(std::string const& path) const
+        {
+            if (!IsValid()) return false;
+            std::ofstream out(path, std::ios::binary);
+            if (!out) return false;
+            out.write(magic, sizeof(magic));
+            out.write(reinterpret_cast<char const*>(m_dims), sizeof(m_dims));
+            out.write(reinterpret_cast<char const*>(m_spacing), sizeof(m_spacing));
+            out.write(reinterpret_cast<char const*>(&m_hash), sizeof(m_hash));
+            out.write(reinterpret_cast<char const*>(&m_magnitude_scale), sizeof(m_magnitude_scale));
+            out.write(reinterpret_cast<char const*>(m_normals.data()), m_normals.size() * sizeof(m_normals[0]));
+            out.write(reinterpret_cast<char const*>(m_magnitudes.data()), m_magnitudes.size());
+            return out.good();
+        }
+
+        // load gradients saved for img, fails when the file is missing or was written for other data
+        bool Load(std::string const& path, vtkImageData* img)
+        {
+            std::ifstream in(path, std::ios::binary);
+            char header[sizeof(magic)];
+            if (!in || !in.read(header, sizeof(header)) || !std::equal(header, header + sizeof(magic), magic))
+                return false;
+            GradientVolume loaded;
+            in.read(reinterpret_cast<char*>(loaded.m_dims), sizeof(loaded.m_dims));
+            in.read(reinterpret_cast<char*>(loaded.m_spacing), sizeof(loaded.m_spacing));
+            in.read(reinterpret_cast<char*>(&loaded.m_hash), sizeof(loaded.m_hash));
+            in.read(reinterpret_cast<char*>(&loaded.m_magnitude_scale), sizeof(loaded.m_magnitude_scale));
+            if (!in || !img || !img->GetPointData()->GetScalars()) return false;
+            // the header has to describe img and the file has to hold exactly its voxels before anything is allocated
+            int dims[3];
+            double spacing[3];
+            img->GetDimensions(dims);
+            img->GetSpacing(spacing);
+            for (int i = 0; i < 3; i++)
+                if (loaded.m_dims[i] != dims[i] || loaded.m_spacing[i] != spacing[i]) return false;
+            auto const count = static_cast<size_t>(dims[0]) * dims[1] * dims[2];
+            auto const data_size = count * (sizeof(m_normals[0]) + sizeof(m_magnitudes[0]));
+            auto const data_begin = in.tellg();
+            in.seekg(0, std::ios::end);
+            if (!in || in.tellg() - data_begin != static_cast<std::streamoff>(data_size)) return false;
+            in.seekg(data_begin);
+            if (Hash(img) != loaded.m_hash) return false;
+            loaded.m_normals.resize(count);
+            loaded.m_magnitudes.resize(count);
+            in.read(reinterpret_cast<char*>(loaded.m_normals.data()), count * sizeof(loaded.m_normals[0]));
+            in.read(reinterpret_cast<char*>(loaded.m_magnitudes.data()), count);
+            if (!in) return false;
+            *this = std::move(loaded);
+            return true;
+        }
+
+        static unsigned short EncodeNormal(float x, float y, float z)
+        {
+            auto const l1 = std::abs(x) + std::abs(y) + std::abs(z);
+            if (l1 == 0) return static_cast<unsigned short>(Quantize(0) << 8 | Quantize(0));
+            auto u = x / l1, v = y / l1;
+            if (z < 0)
+            {
+                auto const fu = (1 - std::abs(v)) * (u < 0 ? -1 : 1);
+                auto const fv = (1 - std::abs(u)) * (v < 0 ? -1 : 1);
+                u = fu;
+                v = fv;
+            }
+            return static_cast<unsigned short>(Quantize(u) << 8 | Quantize(v));
+        }
+
+        static void DecodeNormal(unsigned short code, float n[3])
+        {
+            auto const u = (code >> 8) / 127.5f - 1, v = (code & 0xff) / 127.5f - 1;
+            n[0] = u;
+            n[1] = v;
+            n[2] = 1 - std::abs(u) - std::abs(v);
+            if (n[2] < 0)
+            {
+                n[0] = (1 - std::abs(v)) * (u < 0 ? -1 : 1);
+                n[1] = (1 - std::abs(u)) * (v < 0 ? -1 : 1);
+            }
+            auto const length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int i = 0; i < 3; i++)
+                n[i] /= length;
+        }
+
+    private:
+        static constexpr char magic[8]{'V', 'G', 'R', 'A', 'D', '0', '0', '1'};
+
+        static int Quantize(float f) { return std::clamp(static_cast<int>(std::lround((f + 1) * 127.5f)), 0, 255); }
+
+        template <typename T>
+        void Compute(T const* data)
+        {
+            auto const nx = static_cast<vtkIdType>(m_dims[0]), nxy = nx * m_dims[1];
+            vtkIdType const step[3]{1, nx, nxy};
+            // first pass: float gradients are not kept, only the largest magnitude of each slice
+            std::vector<float> slice_max(m_dims[2], 0.0f);
+            auto const gradient = [&](int x, int y, int z, float g[3]) {
+                int const p[3]{x, y, z};
+                auto const* c = data + z * nxy + y * nx + x;
+                for (int a = 0; a < 3; a++)
+                {
+                    auto const lo = p[a] > 0 ? 1 : 0, hi = p[a] < m_dims[a] - 1 ? 1 : 0;
+                    auto const d = lo + hi;
+                    g[a] = d == 0 ? 0.0f
+                                  : static_cast<float>((static_cast<double>(c[hi * step[a]]) - c[-lo * step[a]]) /
+                                                       (d * m_spacing[a]));
+                }
+            };
+            vtkSMPTools::For(0, m_dims[2], [&](vtkIdType begin, vtkIdType end) {
+                for (auto z = begin; z < end; z++)
+                {
+                    auto m = 0.0f;
+                    for (int y = 0; y < m_dims[1]; y++)
+                        for (int x = 0; x < m_dims[0]; x++)
+                        {
+                            float g[3];
+                            gradient(x, y, static_cast<int>(z), g);
+                            m = std::max(m, g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+                        }
+                    slice_max[z] = std::sqrt(m);
+                }
+            });
+            auto const max_magnitude = *std::max_element(slice_max.begin(), slice_max.end());
+            m_magnitude_scale = max_magnitude > 0 ? max_magnitude / 255 : 1.0f;
+
+            // second pass: recompute and quantize, cheaper than keeping 12 bytes per voxel around
+            vtkSMPTools::For(0, m_dims[2], [&](vtkIdType begin, vtkIdType end) {
+                for (auto z = begin; z < end; z++)
+                    for (int y = 0; y < m_dims[1]; y++)
+                    {
+                        auto const row = z * nxy + y * nx;
+                        for (int x = 0; x < m_dims[0]; x++)
+                        {
+                            float g[3];
+                            gradient(x, y, static_cast<int>(z), g);
+                            auto const m = std::sqrt(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+                            m_magnitudes[row + x] =
+                                static_cast<unsigned char>(std::min(std::lround(m / m_magnitude_scale), 255l));
+                            m_normals[row + x] = EncodeNormal(g[0], g[1], g[2]);
+                        }
+                    }
+            });
+        }
+
+        // FNV-1a of each slice, combined in slice order
+        static std::uint64_t Hash(vtkImageData* img)
+        {
+            int dims[3];
+            img->GetDimensions(dims);
+            auto const slice_bytes =
+                static_cast<size_t>(dims[0]) * dims[1] * img->GetScalarSize() * img->GetNumberOfScalarComponents();
+            auto const* bytes = static_cast<unsigned char const*>(img->GetScalarPointer());
+            std::vector<std::uint64_t> slices(dims[2]);
+            vtkSMPTools::For(0, dims[2], [&](vtkIdType begin, vtkIdType end) {
+                for (auto z = begin; z < end; z++)
+                {
+                    std::uint64_t h = 14695981039346656037ull;
+                    auto const* p = bytes + z * slice_bytes;
+                    for (size_t i = 0; i < slice_bytes; i++)
+                        h = (h ^ p[i]) * 1099511628211ull;
+                    slices[z] = h;
+                }
+            });
+            std::uint64_t h = 14695981039346656037ull ^ static_cast<std::uint64_t>(img->GetScalarType());
+            for (auto s : slices)
+                h = (h ^ s) * 1099511628211ull;
+            return h;
+        }
+
+    private:
+        int m_dims[3]{0, 0, 0};
+        double m_spacing[3]{1, 1, 1};
+        std::uint64_t m_hash = 0;
+        float m_magnitude_scale = 1;
+        std::vector<unsigned short> m_normals;
+        std::vector<unsigned char> m_magnitudes;
+    };
+
+    // sidecar file of the gradients of a volume file or dicom folder
+    std::string GetGradientCachePath(std::string path)
+    {
+        while (path.size() > 1 && (path.back() == '/' || path.back() == '\\'))
+            path.pop_back();
+        return path + ".vgrad";
+    }
+
+    // Gradients of img, shared by every caller in the process until img is modified.
+    // The entries are keyed by the image and dropped when it is deleted (DeleteEvent), so a later image allocated
+    // at the same address never sees them and their memory goes with the image.
+    // With a cache_path the gradients are loaded from that file when it matches img, or computed and saved there.
+    // Used by CpuMipRenderer's shaded compositing (ray_cast_mip's composite engine); the GPU mappers compute their
+    // own gradients on the GPU.
+    std::shared_ptr<GradientVolume const> GetGradientVolume(vtkImageData* img, std::string const& cache_path = {})
+    {
+        struct Entry
+        {
+            vtkMTimeType mtime;
+            std::shared_ptr<GradientVolume const> gradients;
+        };
+        static std::mutex mutex;
+        static std::map<vtkImageData*, Entry> cache;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(img);
+        if (it != cache.end() && it->second.mtime == img->GetMTime()) return it->second.gradients;
+
+        auto gradients = std::make_shared<GradientVolume>();
+        if (cache_path.empty() || !gradients->Load(cache_path, img))
+        {
+            if (!gradients->SetInputData(img)) return nullptr;
+            if (!cache_path.empty()) gradients->Save(cache_path);
+        }
+        if (it == cache.end())
+        {
+            vtkNew<vtkCallbackCommand> forget;
+            forget->SetCallback([](vtkObject* caller, unsigned long, void*, void*) {
+                std::lock_guard<std::mutex> lock(mutex);
+                cache.erase(static_cast<vtkImageData*>(caller));
+            });
+            img->AddObserver(vtkCommand::DeleteEvent, forget);
+        }
+        cache[img] = {img->GetMTime(), gradients};
+        return gradients;
+    }
+} // namespace
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkPointData.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkCellArray.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // Height map sampled on a regular xy grid, meshed directly: no normals, no distance grid, no Delaunay.
+    // Detect sorts the x and y values (vtkSMPTools::Sort) to find the grid lines, then drops every point into its
+    // grid node in parallel; it fails for points off the grid, two points on one node, or fewer points than half the
+    // nodes. Any point order works, and missing nodes (no data) leave holes.
+    // Triangulate emits two triangles per cell with 4 points (one with 3), counted per row and written per row in
+    // parallel, facing +z, over the input points as they are, with texture coordinates like vtkTextureMapToPlane
+    // over the xy bounds.
+    class HeightGrid
+    {
+    public:
+        bool Detect(vtkPoints* points)
+        {
+            m_nodes.reset();
+            auto const count = points->GetNumberOfPoints();
+            if (count < 4) return false;
+            for (int axis = 0; axis < 2; axis++)
+                if (!FindGridLines(points, axis)) return false;
+            auto const nodes = static_cast<vtkIdType>(m_dims[0]) * m_dims[1];
+            if (count * 2 < nodes) return false;
+
+            m_nodes.reset(new std::atomic<vtkIdType>[nodes]);
+            vtkSMPTools::For(0, nodes, [&](vtkIdType begin, vtkIdType end) {
+                for (auto i = begin; i < end; i++)
+                    m_nodes[i].store(-1, std::memory_order_relaxed);
+            });
+            std::atomic<bool> regular{true};
+            vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+                for (auto id = begin; id < end && regular.load(std::memory_order_relaxed); id++)
+                {
+                    double x[3];
+                    points->GetPoint(id, x);
+                    vtkIdType node = 0;
+                    for (int axis = 1; axis >= 0; axis--)
+                    {
+                        auto const f = (x[axis] - m_origin[axis]) / m_spacing[axis];
+                        auto const i = std::lround(f);
+                        // 1% of a step off the grid line at most
+                        if (std::abs(f - i) > 0.01 || i < 0 || i >= m_dims[axis]) regular = false;
+                        node = node * m_dims[0] + i;
+                    }
+                    vtkIdType empty = -1;
+                    if (!regular || !m_nodes[node].compare_exchange_strong(empty, id)) regular = false;
+                }
+            });
+            if (!regular) m_nodes.reset();
+            return regular;
+        }
+
+        // nodes along x and y, valid after a successful Detect
+        int const* GetDimensions() const { return m_dims; }
+
+        vtkSmartPointer<vtkPolyData> Triangulate(vtkPoints* points) const
+        {
+            auto const nx = m_dims[0], ny = m_dims[1];
+            auto const node = [&](int i, int j) { return m_nodes[static_cast<vtkIdType>(j) * nx + i].load(); };
+
+            // triangles of every row of cells, then their first index
+            std::vector<vtkIdType> first(ny, 0);
+            vtkSMPTools::For(0, ny - 1, [&](vtkIdType begin, vtkIdType end) {
+                for (auto j = static_cast<int>(begin); j < end; j++)
+                    for (int i = 0; i < nx - 1; i++)
+                    {
+                        auto const corners = (node(i, j) >= 0) + (node(i + 1, j) >= 0) + (node(i + 1, j + 1) >= 0) +
+                                             (node(i, j + 1) >= 0);
+                        first[j + 1] += corners == 4 ? 2 : corners == 3 ? 1 : 0;
+                    }
+            });
+            for (int j = 1; j < ny; j++)
+                first[j] += first[j - 1];
+            auto const triangles = first[ny - 1];
+
+            vtkNew<vtkIdTypeArray> offsets, connectivity;
+            offsets->SetNumberOfValues(triangles + 1);
+            connectivity->SetNumberOfValues(triangles * 3);
+            auto* offset = offsets->GetPointer(0);
+            auto* ids = connectivity->GetPointer(0);
+            vtkSMPTools::For(0, ny - 1, [&](vtkIdType begin, vtkIdType end) {
+                for (auto j = static_cast<int>(begin); j < end; j++)
+                {
+                    auto t = first[j];
+                    for (int i = 0; i < nx - 1; i++)
+                    {
+                        // counter clockwise seen from +z
+                        vtkIdType const quad[4]{node(i, j), node(i + 1, j), node(i + 1, j + 1), node(i, j + 1)};
+                        vtkIdType corners[4];
+                        int n = 0;
+                        for (auto id : quad)
+                            if (id >= 0) corners[n++] = id;
+                        if (n < 3) continue;
+                        for (int k = 0; k < (n == 4 ? 2 : 1); k++, t++)
+                        {
+                            offset[t] = t * 3;
+                            ids[t * 3] = corners[0];
+                            ids[t * 3 + 1] = corners[k + 1];
+                            ids[t * 3 + 2] = corners[k + 2];
+                        }
+                    }
+                }
+            });
+            offset[triangles] = triangles * 3;
+
+            // u, v over the xy bounds of the grid
+            auto const count = points->GetNumberOfPoints();
+            vtkNew<vtkFloatArray> tcoords;
+            tcoords->SetName("Texture Coordinates");
+            tcoords->SetNumberOfComponents(2);
+            tcoords->SetNumberOfTuples(count);
+            auto* uv = tcoords->GetPointer(0);
+            vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+                for (auto id = begin; id < end; id++)
+                {
+                    double x[3];
+                    points->GetPoint(id, x);
+                    for (int axis = 0; axis < 2; axis++)
+                        uv[id * 2 + axis] =
+                            static_cast<float>((x[axis] - m_origin[axis]) / (m_spacing[axis] * (m_dims[axis] - 1)));
+                }
+            });
+
+            vtkNew<vtkCellArray> polys;
+            polys->SetData(offsets, connectivity);
+            auto output = vtkSmartPointer<vtkPolyData>::New();
+            output->SetPoints(points);
+            output->SetPolys(polys);
+            output->GetPointData()->SetTCoords(tcoords);
+            return output;
+        }
+
+    private:
+        // distinct values along axis, evenly spaced; values closer than the float precision are one line
+        bool FindGridLines(vtkPoints* points, int axis)
+        {
+            auto const count = points->GetNumberOfPoints();
+            std::vector<double> values(count);
+            vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+                for (auto id = begin; id < end; id++)
+                {
+                    double x[3];
+                    points->GetPoint(id, x);
+                    values[id] = x[axis];
+                }
+            });
+            vtkSMPTools::Sort(values.begin(), values.end());
+            auto const eps = 4 * FLT_EPSILON * std::max(std::abs(values.front()), std::abs(values.back()));
+            std::vector<double> lines{values.front()};
+            for (auto v : values)
+                if (v - lines.back() > eps)
+                {
+                    lines.push_back(v);
+                    // a grid has far fewer lines than points
+                    if (static_cast<vtkIdType>(lines.size()) * 2 > count) return false;
+                }
+            if (lines.size() < 2) return false;
+
+            m_dims[axis] = static_cast<int>(lines.size());
+            m_origin[axis] = lines.front();
+            m_spacing[axis] = (lines.back() - lines.front()) / (lines.size() - 1);
+            for (size_t i = 0; i < lines.size(); i++)
+                if (std::abs(lines[i] - (m_origin[axis] + i * m_spacing[axis])) > 0.01 * m_spacing[axis]) return false;
+            return true;
+        }
+
+    private:
+        int m_dims[2]{0, 0};
+        double m_origin[2]{0, 0};
+        double m_spacing[2]{1, 1};
+        std::unique_ptr<std::atomic<vtkIdType>[]> m_nodes; // point of every node, -1 when missing, x fastest
+    };
+} // namespace
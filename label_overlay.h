@@ -0,0 +1,288 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkThreadedImageAlgorithm.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+#include <vtkAlgorithm.h>
+#include <vtkAlgorithmOutput.h>
+#include <vtkDataObject.h>
+#include <vtkScalarsToColors.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    // Fused replacement of vtkImageResliceToColors (grayscale) + vtkImageResliceToColors (labels) + vtkImageBlend:
+    // reads the image voxel and the label voxels, applies window/level, looks up each label color/opacity and
+    // alpha-composites the layers into one RGBA pixel, row by row in a single pass without intermediate volumes.
+    // Input port 0: the grayscale image (1 component), port 1 (repeatable, optional): label volumes on the same grid,
+    // drawn in the order they were added. Work is split into rows across threads (beam split).
+    // Like vtkImageBlend, the layers are matched by voxel index: each label layer is drawn over the intersection of
+    // its extent with the image and leaves the rest unchanged. A label volume whose spacing or origin is off the
+    // image grid by more than a tolerance is still drawn, with a warning.
+    // Labels are looked up through a dense table built from the lookup table range, so label lookup tables should
+    // span integer values (at most 65536 of them).
+    class MLabelOverlayFilter: public vtkThreadedImageAlgorithm
+    {
+    public:
+        static MLabelOverlayFilter* New();
+        vtkTypeMacro(MLabelOverlayFilter, vtkThreadedImageAlgorithm);
+
+        vtkSetMacro(Window, double);
+        vtkGetMacro(Window, double);
+        vtkSetMacro(Level, double);
+        vtkGetMacro(Level, double);
+
+        void AddLabelInputData(vtkDataObject* labels, vtkScalarsToColors* lut, double opacity = 1.0)
+        {
+            AddInputData(1, labels);
+            AddLayer(lut, opacity);
+        }
+
+        void AddLabelInputConnection(vtkAlgorithmOutput* labels, vtkScalarsToColors* lut, double opacity = 1.0)
+        {
+            AddInputConnection(1, labels);
+            AddLayer(lut, opacity);
+        }
+
+        int GetNumberOfLabelLayers() const { return static_cast<int>(m_layers.size()); }
+
+        void SetLabelOpacity(int layer, double opacity)
+        {
+            if (layer < 0 || layer >= GetNumberOfLabelLayers() || m_layers[layer].opacity == opacity) return;
+            m_layers[layer].opacity = opacity;
+            m_layers[layer].build_time = 0;
+            Modified();
+        }
+
+        vtkMTimeType GetMTime() override
+        {
+            auto mtime = Superclass::GetMTime();
+            for (auto const& layer : m_layers)
+                mtime = std::max(mtime, layer.lut->GetMTime());
+            return mtime;
+        }
+
+    protected:
+        MLabelOverlayFilter()
+        {
+            SetNumberOfInputPorts(2);
+            SetSplitModeToBeam();
+        }
+
+        ~MLabelOverlayFilter() override = default;
+
+        int FillInputPortInformation(int port, vtkInformation* info) override
+        {
+            info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkImageData");
+            if (port == 1)
+            {
+                info->Set(vtkAlgorithm::INPUT_IS_REPEATABLE(), 1);
+                info->Set(vtkAlgorithm::INPUT_IS_OPTIONAL(), 1);
+            }
+            return 1;
+        }
+
+        int RequestInformation(vtkInformation*, vtkInformationVector** inputVector,
+                               vtkInformationVector* outputVector) override
+        {
+            auto* img_info = inputVector[0]->GetInformationObject(0);
+            double spacing[3], origin[3];
+            img_info->Get(vtkDataObject::SPACING(), spacing);
+            img_info->Get(vtkDataObject::ORIGIN(), origin);
+            for (int l = 0; l < inputVector[1]->GetNumberOfInformationObjects(); l++)
+            {
+                auto* label_info = inputVector[1]->GetInformationObject(l);
+                double label_spacing[3], label_origin[3];
+                label_info->Get(vtkDataObject::SPACING(), label_spacing);
+                label_info->Get(vtkDataObject::ORIGIN(), label_origin);
+                // a hundredth of a voxel, the rounding of spacings and origins written by other tools
+                for (int i = 0; i < 3; i++)
+                    if (std::abs(label_spacing[i] - spacing[i]) > 1e-2 * std::abs(spacing[i]) ||
+                        std::abs(label_origin[i] - origin[i]) > 1e-2 * std::abs(spacing[i]))
+                    {
+                        vtkWarningMacro("label input " << l << " is not on the grid of the image, "
+                                                          "it is drawn by voxel index");
+                        break;
+                    }
+            }
+            vtkDataObject::SetPointDataActiveScalarInfo(outputVector->GetInformationObject(0), VTK_UNSIGNED_CHAR, 4);
+            return 1;
+        }
+
+        // the image provides the output extent, the labels are asked for the part of it they cover
+        int RequestUpdateExtent(vtkInformation*, vtkInformationVector** inputVector,
+                                vtkInformationVector* outputVector) override
+        {
+            int outExt[6];
+            outputVector->GetInformationObject(0)->Get(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), outExt);
+            inputVector[0]->GetInformationObject(0)->Set(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), outExt, 6);
+            for (int l = 0; l < inputVector[1]->GetNumberOfInformationObjects(); l++)
+            {
+                auto* label_info = inputVector[1]->GetInformationObject(l);
+                int whole[6], ext[6];
+                label_info->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), whole);
+                for (int i = 0; i < 3; i++)
+                {
+                    ext[i * 2] = std::max(outExt[i * 2], whole[i * 2]);
+                    ext[i * 2 + 1] = std::min(outExt[i * 2 + 1], whole[i * 2 + 1]);
+                }
+                // no overlap: an empty extent, the layer is skipped
+                if (ext[0] > ext[1] || ext[2] > ext[3] || ext[4] > ext[5])
+                    for (int i = 0; i < 3; i++)
+                    {
+                        ext[i * 2] = whole[i * 2];
+                        ext[i * 2 + 1] = whole[i * 2] - 1;
+                    }
+                label_info->Set(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), ext, 6);
+            }
+            return 1;
+        }
+
+        int RequestData(vtkInformation* request, vtkInformationVector** inputVector,
+                        vtkInformationVector* outputVector) override
+        {
+            auto* img = vtkImageData::GetData(inputVector[0]);
+            if (!img || img->GetNumberOfScalarComponents() != 1)
+            {
+                vtkErrorMacro("a single component image is required");
+                return 0;
+            }
+            if (inputVector[1]->GetNumberOfInformationObjects() != GetNumberOfLabelLayers())
+            {
+                vtkErrorMacro("every label input needs a lookup table");
+                return 0;
+            }
+
+            // dense label -> premultiplied-by-opacity RGBA tables, so the kernel never calls into the lookup table,
+            // rebuilt only when the lookup table or the layer opacity changed since the last slice
+            for (auto& layer : m_layers)
+            {
+                if (layer.build_time != 0 && layer.build_time == layer.lut->GetMTime()) continue;
+                auto const* range = layer.lut->GetRange();
+                layer.base = static_cast<int>(std::floor(range[0]));
+                auto const top = std::max(layer.base, static_cast<int>(std::ceil(range[1])));
+                auto const count = std::min(top - layer.base + 1, 65536);
+                auto const opacity = std::clamp(layer.opacity, 0.0, 1.0);
+                layer.rgba.resize(count);
+                for (int i = 0; i < count; i++)
+                {
+                    auto const* c = layer.lut->MapValue(layer.base + i);
+                    layer.rgba[i] = {c[0], c[1], c[2], static_cast<unsigned char>(std::lround(c[3] * opacity))};
+                }
+                layer.build_time = layer.lut->GetMTime();
+            }
+            return Superclass::RequestData(request, inputVector, outputVector);
+        }
+
+        void ThreadedRequestData(vtkInformation*, vtkInformationVector**, vtkInformationVector*,
+                                 vtkImageData*** inData, vtkImageData** outData, int outExt[6], int) override
+        {
+            auto const width = outExt[1] - outExt[0] + 1;
+            if (width <= 0 || outExt[3] < outExt[2] || outExt[5] < outExt[4]) return;
+
+            auto const lower = Level - Window / 2.0;
+            auto const scale = Window > 0 ? 255.0 / Window : 0.0;
+            std::vector<int> index(width);
+            for (int z = outExt[4]; z <= outExt[5]; z++)
+                for (int y = outExt[2]; y <= outExt[3]; y++)
+                {
+                    auto* out = static_cast<unsigned char*>(outData[0]->GetScalarPointer(outExt[0], y, z));
+
+                    auto* img = inData[0][0];
+                    auto* img_row = img->GetScalarPointer(outExt[0], y, z);
+                    switch (img->GetScalarType())
+                    {
+                        vtkTemplateMacro(WindowLevelRow(static_cast<VTK_TT const*>(img_row), out, width, lower, scale));
+                    }
+
+                    for (size_t l = 0; l < m_layers.size(); l++)
+                    {
+                        auto& layer = m_layers[l];
+                        auto* labels = inData[1][l];
+                        // the part of the row the label volume covers
+                        auto const* label_ext = labels->GetExtent();
+                        if (y < label_ext[2] || y > label_ext[3] || z < label_ext[4] || z > label_ext[5]) continue;
+                        auto const x0 = std::max(outExt[0], label_ext[0]);
+                        auto const count = std::min(outExt[1], label_ext[1]) - x0 + 1;
+                        if (count <= 0) continue;
+                        auto* label_row = labels->GetScalarPointer(x0, y, z);
+                        auto const components = labels->GetNumberOfScalarComponents();
+                        switch (labels->GetScalarType())
+                        {
+                            vtkTemplateMacro(LabelIndexRow(static_cast<VTK_TT const*>(label_row), components,
+                                                           index.data(), count, layer));
+                        }
+                        CompositeRow(out + (x0 - outExt[0]) * 4, index.data(), count, layer);
+                    }
+                }
+        }
+
+    private:
+        struct Layer
+        {
+            vtkSmartPointer<vtkScalarsToColors> lut = nullptr;
+            double opacity = 1.0;
+            int base = 0;
+            std::vector<std::array<unsigned char, 4>> rgba;
+            vtkMTimeType build_time = 0; // lookup table MTime the rgba table was built from, 0: not built
+        };
+
+        void AddLayer(vtkScalarsToColors* lut, double opacity)
+        {
+            Layer layer;
+            layer.lut = lut;
+            layer.opacity = opacity;
+            m_layers.push_back(layer);
+            Modified();
+        }
+
+        template <typename T>
+        static void WindowLevelRow(T const* in, unsigned char* out, int width, double lower, double scale)
+        {
+            for (int x = 0; x < width; x++, out += 4)
+            {
+                auto const g = std::clamp((static_cast<double>(in[x]) - lower) * scale, 0.0, 255.0);
+                out[0] = out[1] = out[2] = static_cast<unsigned char>(g + 0.5);
+                out[3] = 255;
+            }
+        }
+
+        template <typename T>
+        static void LabelIndexRow(T const* in, int components, int* index, int width, Layer const& layer)
+        {
+            auto const last = static_cast<int>(layer.rgba.size()) - 1;
+            for (int x = 0; x < width; x++, in += components)
+                index[x] = std::clamp(static_cast<int>(std::lround(static_cast<double>(*in))) - layer.base, 0, last);
+        }
+
+        static void CompositeRow(unsigned char* out, int const* index, int width, Layer const& layer)
+        {
+            for (int x = 0; x < width; x++, out += 4)
+            {
+                auto const& c = layer.rgba[index[x]];
+                if (c[3] == 0) continue;
+                auto const a = c[3] / 255.0;
+                for (int k = 0; k < 3; k++)
+                    out[k] = static_cast<unsigned char>(out[k] + (c[k] - out[k]) * a + 0.5);
+            }
+        }
+
+    private:
+        double Window = 255.0;
+        double Level = 127.5;
+        std::vector<Layer> m_layers;
+
+        MLabelOverlayFilter(MLabelOverlayFilter const&) = delete;
+        void operator=(MLabelOverlayFilter const&) = delete;
+    };
+    vtkStandardNewMacro(MLabelOverlayFilter);
+} // namespace
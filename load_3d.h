@@ -11,13 +11,18 @@
 #include <vtkPolyDataReader.h>
 #include <vtkPolyData.h>
 #include <vtkSphereSource.h>
+#include <vtkCellArray.h>
+#include <vtkIdTypeArray.h>
 
 #include <vtksys/SystemTools.hxx>
 
 #include <algorithm>
+#include <numeric>
 #include <string>
 #include <iostream>
 
+#include "point_cache.h"
+
 namespace
 {
     vtkSmartPointer<vtkPolyData> ReadPolyData(const char* fileName)
@@ -72,10 +77,28 @@ namespace
         }
         else if (extension == ".xyz")
         {
-            vtkNew<vtkSimplePointsReader> reader;
-            reader->SetFileName(fileName);
-            reader->Update();
-            polyData = reader->GetOutput();
+            // binary point cloud cache (fileName.pcloud) when up to date, written on the first parse
+            polyData = LoadPointCloud(fileName);
+            if (polyData)
+            {
+                // one vertex per point, like vtkSimplePointsReader
+                auto const count = polyData->GetNumberOfPoints();
+                vtkNew<vtkIdTypeArray> offsets, connectivity;
+                offsets->SetNumberOfValues(count + 1);
+                connectivity->SetNumberOfValues(count);
+                std::iota(offsets->GetPointer(0), offsets->GetPointer(0) + count + 1, vtkIdType(0));
+                std::iota(connectivity->GetPointer(0), connectivity->GetPointer(0) + count, vtkIdType(0));
+                vtkNew<vtkCellArray> verts;
+                verts->SetData(offsets, connectivity);
+                polyData->SetVerts(verts);
+            }
+            else
+            {
+                vtkNew<vtkSimplePointsReader> reader;
+                reader->SetFileName(fileName);
+                reader->Update();
+                polyData = reader->GetOutput();
+            }
         }
         else
         {
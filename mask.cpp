@@ -18,12 +18,25 @@
 #include <vtkDICOMMetaData.h>
 #include <vtkMarchingCubes.h>
 #include <vtkCenterOfMass.h>
+#include <vtkImageActor.h>
+#include <vtkImageMapper3D.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkInformation.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
 
+#include <algorithm>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 
 #define IS_RESLICE
 
+// mask, masked value and color conversion are computed for the displayed slice only: nothing is updated up front
+// and the image mapper streams, so the pipeline is only asked for one slice at a time.
+// the full masked volume is only built by ExportMaskedVolume
+#define PER_SLICE_MASK
+
 //#define REQUIRE_TRANSFORM_AXIS
 
 class myInteractorStyler final: public vtkInteractorStyleImage
@@ -79,11 +92,79 @@ private:
 };
 vtkStandardNewMacro(myInteractorStyler);
 
+// stream the masked volume to a MetaImage file (.mha) slab by slab, only one slab of the masked volume is held
+// in memory at a time, each slab is computed by the (multithreaded) mask filter
+bool ExportMaskedVolume(vtkImageMask* mask, std::filesystem::path const& path, int slab_slices = 16)
+{
+    mask->UpdateInformation();
+    int ext[6];
+    mask->GetOutputInformation(0)->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), ext);
+    double spacing[3], origin[3];
+    mask->GetOutputInformation(0)->Get(vtkDataObject::SPACING(), spacing);
+    mask->GetOutputInformation(0)->Get(vtkDataObject::ORIGIN(), origin);
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "can not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    for (auto z = ext[4]; z <= ext[5]; z += slab_slices)
+    {
+        int slab[6]{ext[0], ext[1], ext[2], ext[3], z, std::min(z + slab_slices - 1, ext[5])};
+        mask->UpdateExtent(slab);
+        auto* scalars = mask->GetOutput()->GetPointData()->GetScalars();
+        if (z == ext[4])
+        {
+            // the element type is only known once the first slab is computed
+            char const* type = nullptr;
+            switch (scalars->GetDataType())
+            {
+            case VTK_UNSIGNED_CHAR:
+                type = "MET_UCHAR";
+                break;
+            case VTK_SHORT:
+                type = "MET_SHORT";
+                break;
+            case VTK_UNSIGNED_SHORT:
+                type = "MET_USHORT";
+                break;
+            case VTK_INT:
+                type = "MET_INT";
+                break;
+            case VTK_FLOAT:
+                type = "MET_FLOAT";
+                break;
+            case VTK_DOUBLE:
+                type = "MET_DOUBLE";
+                break;
+            default:
+                std::cerr << "unsupported scalar type for export: " << scalars->GetDataTypeAsString() << std::endl;
+                return false;
+            }
+            out << "ObjectType = Image\nNDims = 3\nBinaryData = True\nBinaryDataByteOrderMSB = False\n"
+                << "Offset = " << origin[0] + ext[0] * spacing[0] << ' ' << origin[1] + ext[2] * spacing[1] << ' '
+                << origin[2] + ext[4] * spacing[2] << '\n'
+                << "ElementSpacing = " << spacing[0] << ' ' << spacing[1] << ' ' << spacing[2] << '\n'
+                << "DimSize = " << ext[1] - ext[0] + 1 << ' ' << ext[3] - ext[2] + 1 << ' ' << ext[5] - ext[4] + 1
+                << '\n'
+                << "ElementNumberOfChannels = " << scalars->GetNumberOfComponents() << '\n'
+                << "ElementType = " << type << "\nElementDataFile = LOCAL\n";
+        }
+        out.write(static_cast<char const*>(scalars->GetVoidPointer(0)),
+                  scalars->GetNumberOfValues() * scalars->GetDataTypeSize());
+        std::cout << "\rexported slices " << slab[5] - ext[4] + 1 << '/' << ext[5] - ext[4] + 1 << std::flush;
+    }
+    std::cout << std::endl;
+    return static_cast<bool>(out);
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc != 3)
+    if (argc != 3 && argc != 4)
     {
-        std::cerr << "1) dicom dir path; 2) nii file path" << std::endl;
+        std::cerr << "1) dicom dir path; 2) nii file path; 3) optional masked volume export path (.mha)" << std::endl;
         return EXIT_FAILURE;
     }
 
@@ -204,28 +285,47 @@ int main(int argc, char* argv[])
     vtkNew<vtkImageCast> mask_cast;
     mask_cast->SetInputData(mask_img); // nii_img_data
     mask_cast->SetOutputScalarTypeToUnsignedChar();
+#ifndef PER_SLICE_MASK
     mask_cast->Update();
     auto mask_img_data = mask_cast->GetOutput();
     std::cout << mask_img_data->GetScalarTypeAsString() << std::endl; // unsigned char
+#endif
 
     vtkNew<vtkImageMask> mask;
     mask->SetImageInputData(dicom_img_data);
+#ifdef PER_SLICE_MASK
+    mask->SetInputConnection(1, mask_cast->GetOutputPort());
+#else
     mask->SetMaskInputData(mask_img_data);
+#endif
     mask->SetNotMask(true);
     mask->SetMaskedOutputValue(3072);
+#ifndef PER_SLICE_MASK
     mask->Update();
     std::cout << mask->GetOutput()->GetScalarTypeAsString() << std::endl; // short
+#endif
+
+    if (argc == 4 && !ExportMaskedVolume(mask, argv[3])) return EXIT_FAILURE;
 
 #ifdef IS_RESLICE
     vtkNew<vtkImageResliceToColors> dicom_reslice;
     dicom_reslice->BypassOn(); // without lookup table
     dicom_reslice->SetOutputFormatToRGB();
+#ifdef PER_SLICE_MASK
+    dicom_reslice->SetInputConnection(mask->GetOutputPort());
+#else
     dicom_reslice->SetInputData(mask->GetOutput());
     dicom_reslice->Update();
+#endif
 #endif // IS_RESLICE
 
     vtkNew<vtkImageViewer2> viewer;
     viewer->SetInputConnection(dicom_reslice->GetOutputPort());
+#ifdef PER_SLICE_MASK
+    // pull only the display extent (one slice) through mask and color conversion; before the orientation and
+    // slice setters, they render already
+    viewer->GetImageActor()->GetMapper()->StreamingOn();
+#endif
     viewer->SetSliceOrientationToXY();
     viewer->SetSlice(center[2]); // set to mask shape center
 
@@ -0,0 +1,586 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkWeakPointer.h>
+#include <vtkObjectFactory.h>
+#include <vtkCommand.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkCellArray.h>
+#include <vtkCellArrayIterator.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkActor.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkInteractorObserver.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    // Decimated copies of a triangle mesh: level k has about 4^-k of the vertices of the input (level 0 is the input
+    // itself). BuildAsync returns at once, the levels are built one after the other on a background thread (each
+    // level in parallel from the previous one) and become available through GetLevel as they are done; meshes
+    // already small enough are not decimated further.
+    class MeshPyramid
+    {
+    public:
+        MeshPyramid() = default;
+        MeshPyramid(MeshPyramid const&) = delete;
+        MeshPyramid& operator=(MeshPyramid const&) = delete;
+        ~MeshPyramid()
+        {
+            m_cancel = true;
+            Wait();
+        }
+
+        void BuildAsync(vtkPolyData* mesh, int levels = 4)
+        {
+            Wait();
+            m_cancel = false;
+            m_levels.assign(levels + 1, nullptr);
+            m_ready.reset(new std::atomic<bool>[levels + 1]);
+            for (int i = 0; i <= levels; i++)
+                m_ready[i] = false;
+            m_levels[0] = mesh;
+            m_ready[0] = true;
+            m_worker = std::thread([this, levels]() {
+                for (int i = 1; i <= levels && !m_cancel; i++)
+                {
+                    if (m_levels[i - 1]->GetNumberOfPolys() < min_triangles) break;
+                    m_levels[i] = Decimate(m_levels[i - 1]);
+                    if (!m_levels[i]) break;
+                    m_ready[i].store(true, std::memory_order_release);
+                }
+            });
+        }
+
+        // block until every level is built
+        void Wait()
+        {
+            if (m_worker.joinable()) m_worker.join();
+        }
+
+        int GetNumberOfLevels() const { return static_cast<int>(m_levels.size()); }
+
+        // nullptr while the level is still being built (or when the one before was small enough)
+        vtkPolyData* GetLevel(int level) const
+        {
+            if (level < 0 || level >= GetNumberOfLevels() || !m_ready[level].load(std::memory_order_acquire))
+                return nullptr;
+            return m_levels[level];
+        }
+
+        // Vertex clustering with quadric error placement (Lindstrom, Out-of-core simplification of large polygonal
+        // models, 2000), in parallel: the vertices are sorted by grid cell, every cell becomes one vertex at the
+        // point minimizing the summed squared distances to the planes of its triangles (the mean of its vertices
+        // where that is not unique), point data is averaged, triangles collapsing to a line or a point, duplicates
+        // and folds (a triangle and its reverse) are dropped. The cell size is chosen for about 1 / reduction of the
+        // vertices.
+        // Only reads the mesh (no GetBounds, no cell traversal state), so it can run while the mesh is rendered.
+        static vtkSmartPointer<vtkPolyData> Decimate(vtkPolyData* mesh, double reduction = 4)
+        {
+            auto* points = mesh->GetPoints();
+            if (!points || points->GetNumberOfPoints() == 0) return nullptr;
+            auto const count = points->GetNumberOfPoints();
+            auto const triangles = Triangles(mesh);
+            if (triangles.empty()) return nullptr;
+
+            // bounds and surface area
+            constexpr auto lowest = std::numeric_limits<double>::lowest();
+            constexpr auto highest = std::numeric_limits<double>::max();
+            std::array<double, 6> bounds{highest, lowest, highest, lowest, highest, lowest};
+            vtkSMPThreadLocal<std::array<double, 6>> local_bounds(bounds);
+            vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+                auto& b = local_bounds.Local();
+                for (auto id = begin; id < end; id++)
+                {
+                    double x[3];
+                    points->GetPoint(id, x);
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        b[axis * 2] = std::min(b[axis * 2], x[axis]);
+                        b[axis * 2 + 1] = std::max(b[axis * 2 + 1], x[axis]);
+                    }
+                }
+            });
+            for (auto const& b : local_bounds)
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    bounds[axis * 2] = std::min(bounds[axis * 2], b[axis * 2]);
+                    bounds[axis * 2 + 1] = std::max(bounds[axis * 2 + 1], b[axis * 2 + 1]);
+                }
+            vtkSMPThreadLocal<double> local_area(0.0);
+            vtkSMPTools::For(0, static_cast<vtkIdType>(triangles.size()), [&](vtkIdType begin, vtkIdType end) {
+                auto& area = local_area.Local();
+                for (auto t = begin; t < end; t++)
+                {
+                    double n[3], d;
+                    area += Plane(points, triangles[t], n, d);
+                }
+            });
+            double area = 0;
+            for (auto a : local_area)
+                area += a;
+
+            // a surface of area A sampled by V vertices has about A / h^2 vertices in cells of size h
+            auto const extent = std::max({bounds[1] - bounds[0], bounds[3] - bounds[2], bounds[5] - bounds[4]});
+            auto const cell_size = std::max(std::sqrt(reduction * area / count), extent / max_cells);
+            if (!(cell_size > 0)) return nullptr;
+
+            // points sorted by cell, one cluster per run
+            auto const cell = [&](double const x[3], int axis) {
+                return std::min(static_cast<std::uint64_t>((x[axis] - bounds[axis * 2]) / cell_size),
+                                static_cast<std::uint64_t>(max_cells));
+            };
+            std::vector<std::pair<std::uint64_t, vtkIdType>> sorted(count);
+            vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+                for (auto id = begin; id < end; id++)
+                {
+                    double x[3];
+                    points->GetPoint(id, x);
+                    sorted[id] = {(cell(x, 2) << 42) | (cell(x, 1) << 21) | cell(x, 0), id};
+                }
+            });
+            vtkSMPTools::Sort(sorted.begin(), sorted.end());
+            std::vector<vtkIdType> cluster(count), first{0}; // cluster of every point, first sorted point of every one
+            for (vtkIdType i = 0; i < count; i++)
+            {
+                if (i > 0 && sorted[i].first != sorted[i - 1].first) first.push_back(i);
+                cluster[sorted[i].second] = static_cast<vtkIdType>(first.size()) - 1;
+            }
+            auto const clusters = static_cast<vtkIdType>(first.size());
+            first.push_back(count);
+
+            // triangle corners sorted by cluster, the quadric of a cluster sums the planes of its corners
+            std::vector<std::pair<vtkIdType, vtkIdType>> corners(triangles.size() * 3);
+            vtkSMPTools::For(0, static_cast<vtkIdType>(triangles.size()), [&](vtkIdType begin, vtkIdType end) {
+                for (auto t = begin; t < end; t++)
+                    for (int k = 0; k < 3; k++)
+                        corners[t * 3 + k] = {cluster[triangles[t][k]], t};
+            });
+            vtkSMPTools::Sort(corners.begin(), corners.end());
+
+            vtkNew<vtkFloatArray> out_coords;
+            out_coords->SetNumberOfComponents(3);
+            out_coords->SetNumberOfTuples(clusters);
+            auto* xyz = out_coords->GetPointer(0);
+            vtkSMPTools::For(0, clusters, [&](vtkIdType begin, vtkIdType end) {
+                auto corner = std::lower_bound(corners.begin(), corners.end(), std::make_pair(begin, vtkIdType(0)));
+                for (auto c = begin; c < end; c++)
+                {
+                    double mean[3]{0, 0, 0};
+                    for (auto i = first[c]; i < first[c + 1]; i++)
+                    {
+                        double x[3];
+                        points->GetPoint(sorted[i].second, x);
+                        for (int axis = 0; axis < 3; axis++)
+                            mean[axis] += x[axis];
+                    }
+                    for (int axis = 0; axis < 3; axis++)
+                        mean[axis] /= static_cast<double>(first[c + 1] - first[c]);
+
+                    // sum of area * (n.x + d)^2 = x^T A x + 2 b^T x + const
+                    double a[3][3]{}, b[3]{};
+                    for (; corner != corners.end() && corner->first == c; ++corner)
+                    {
+                        double n[3], d;
+                        auto const w = Plane(points, triangles[corner->second], n, d);
+                        for (int i = 0; i < 3; i++)
+                        {
+                            for (int j = 0; j < 3; j++)
+                                a[i][j] += w * n[i] * n[j];
+                            b[i] += w * d * n[i];
+                        }
+                    }
+                    double x[3];
+                    MinimizeQuadric(a, b, mean, x);
+
+                    // stay in the cell
+                    auto const key = sorted[first[c]].first;
+                    for (int axis = 0; axis < 3; axis++)
+                    {
+                        auto const index = static_cast<double>((key >> (21 * axis)) & max_cells);
+                        auto const lo = bounds[axis * 2] + index * cell_size;
+                        xyz[c * 3 + axis] = static_cast<float>(std::clamp(x[axis], lo, lo + cell_size));
+                    }
+                }
+            });
+
+            auto out = vtkSmartPointer<vtkPolyData>::New();
+            vtkNew<vtkPoints> out_points;
+            out_points->SetData(out_coords);
+            out->SetPoints(out_points);
+            AveragePointData(mesh->GetPointData(), sorted, first, out->GetPointData());
+            out->SetPolys(ClusterTriangles(triangles, cluster));
+            return out;
+        }
+
+    private:
+        static constexpr vtkIdType min_triangles = 20000; // not worth a coarser level below
+        static constexpr std::uint64_t max_cells = (1 << 21) - 1;
+
+        // fan triangulation of the polygons, through an iterator (thread safe, unlike InitTraversal / GetNextCell)
+        static std::vector<std::array<vtkIdType, 3>> Triangles(vtkPolyData* mesh)
+        {
+            std::vector<std::array<vtkIdType, 3>> triangles;
+            auto* polys = mesh->GetPolys();
+            if (!polys) return triangles;
+            triangles.reserve(polys->GetNumberOfCells());
+            auto it = vtk::TakeSmartPointer(polys->NewIterator());
+            for (it->GoToFirstCell(); !it->IsDoneWithTraversal(); it->GoToNextCell())
+            {
+                vtkIdType size;
+                vtkIdType const* ids;
+                it->GetCurrentCell(size, ids);
+                for (vtkIdType i = 2; i < size; i++)
+                    triangles.push_back({ids[0], ids[i - 1], ids[i]});
+            }
+            return triangles;
+        }
+
+        // unit normal and offset of the plane of a triangle (n.x + d = 0), returns its area
+        static double Plane(vtkPoints* points, std::array<vtkIdType, 3> const& triangle, double n[3], double& d)
+        {
+            double p[3][3];
+            for (int k = 0; k < 3; k++)
+                points->GetPoint(triangle[k], p[k]);
+            double const u[3]{p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+            double const v[3]{p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+            n[0] = u[1] * v[2] - u[2] * v[1];
+            n[1] = u[2] * v[0] - u[0] * v[2];
+            n[2] = u[0] * v[1] - u[1] * v[0];
+            auto const length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            d = 0;
+            if (length == 0) return 0;
+            for (int i = 0; i < 3; i++)
+                n[i] /= length;
+            d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+            return length / 2;
+        }
+
+        // x minimizing x^T A x + 2 b^T x closest to the mean: x = mean + A^+ (-b - A mean), the pseudo inverse drops
+        // the directions the planes do not constrain (flat or creased regions), eigen vectors by Jacobi rotations
+        static void MinimizeQuadric(double a[3][3], double const b[3], double const mean[3], double x[3])
+        {
+            double r[3];
+            for (int i = 0; i < 3; i++)
+                r[i] = -b[i] - (a[i][0] * mean[0] + a[i][1] * mean[1] + a[i][2] * mean[2]);
+            double v[3][3]{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+            for (int sweep = 0; sweep < 16; sweep++)
+            {
+                auto const off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+                if (off <= 1e-24 * (a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2])) break;
+                for (int p = 0; p < 2; p++)
+                    for (int q = p + 1; q < 3; q++)
+                    {
+                        if (a[p][q] == 0) continue;
+                        auto const theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+                        auto const t = (theta >= 0 ? 1 : -1) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                        auto const c = 1 / std::sqrt(t * t + 1), s = t * c;
+                        for (int k = 0; k < 3; k++)
+                        {
+                            auto const akp = a[k][p], akq = a[k][q];
+                            a[k][p] = c * akp - s * akq;
+                            a[k][q] = s * akp + c * akq;
+                        }
+                        for (int k = 0; k < 3; k++)
+                        {
+                            auto const apk = a[p][k], aqk = a[q][k];
+                            a[p][k] = c * apk - s * aqk;
+                            a[q][k] = s * apk + c * aqk;
+                        }
+                        for (int k = 0; k < 3; k++)
+                        {
+                            auto const vkp = v[k][p], vkq = v[k][q];
+                            v[k][p] = c * vkp - s * vkq;
+                            v[k][q] = s * vkp + c * vkq;
+                        }
+                    }
+            }
+            auto const largest = std::max({std::abs(a[0][0]), std::abs(a[1][1]), std::abs(a[2][2])});
+            for (int i = 0; i < 3; i++)
+                x[i] = mean[i];
+            for (int e = 0; e < 3; e++)
+            {
+                if (!(std::abs(a[e][e]) > 1e-3 * largest)) continue;
+                auto const step = (v[0][e] * r[0] + v[1][e] * r[1] + v[2][e] * r[2]) / a[e][e];
+                for (int i = 0; i < 3; i++)
+                    x[i] += step * v[i][e];
+            }
+        }
+
+        // mean of every point data array over each cluster, normals normalized again
+        static void AveragePointData(vtkPointData* in, std::vector<std::pair<std::uint64_t, vtkIdType>> const& sorted,
+                                     std::vector<vtkIdType> const& first, vtkPointData* out)
+        {
+            auto const clusters = static_cast<vtkIdType>(first.size()) - 1;
+            for (int a = 0; a < in->GetNumberOfArrays(); a++)
+            {
+                auto* array = in->GetArray(a);
+                if (!array) continue; // not numeric
+                vtkSmartPointer<vtkDataArray> mean;
+                mean.TakeReference(array->NewInstance());
+                mean->SetName(array->GetName());
+                mean->SetNumberOfComponents(array->GetNumberOfComponents());
+                mean->SetNumberOfTuples(clusters);
+                auto const components = array->GetNumberOfComponents();
+                auto const normals = array == in->GetNormals();
+                vtkSMPTools::For(0, clusters, [&](vtkIdType begin, vtkIdType end) {
+                    std::vector<double> sum(components), tuple(components);
+                    for (auto c = begin; c < end; c++)
+                    {
+                        std::fill(sum.begin(), sum.end(), 0.0);
+                        for (auto i = first[c]; i < first[c + 1]; i++)
+                        {
+                            array->GetTuple(sorted[i].second, tuple.data());
+                            for (int k = 0; k < components; k++)
+                                sum[k] += tuple[k];
+                        }
+                        auto scale = 1.0 / static_cast<double>(first[c + 1] - first[c]);
+                        if (normals)
+                        {
+                            double length = 0;
+                            for (auto s : sum)
+                                length += s * s;
+                            scale = length > 0 ? 1 / std::sqrt(length) : 0;
+                        }
+                        for (auto& s : sum)
+                            s *= scale;
+                        mean->SetTuple(c, sum.data());
+                    }
+                });
+                auto const attribute = in->IsArrayAnAttribute(a);
+                if (attribute >= 0)
+                    out->SetAttribute(mean, attribute);
+                else
+                    out->AddArray(mean);
+            }
+        }
+
+        // triangles over the clusters, without collapsed ones, duplicates (same corners in the same order) and folds
+        static vtkSmartPointer<vtkCellArray> ClusterTriangles(std::vector<std::array<vtkIdType, 3>> const& triangles,
+                                                              std::vector<vtkIdType> const& cluster)
+        {
+            vtkSMPThreadLocal<std::vector<std::array<vtkIdType, 3>>> local;
+            vtkSMPTools::For(0, static_cast<vtkIdType>(triangles.size()), [&](vtkIdType begin, vtkIdType end) {
+                auto& kept = local.Local();
+                for (auto t = begin; t < end; t++)
+                {
+                    std::array<vtkIdType, 3> c{cluster[triangles[t][0]], cluster[triangles[t][1]],
+                                               cluster[triangles[t][2]]};
+                    if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0]) continue;
+                    // smallest first, same orientation
+                    std::rotate(c.begin(), std::min_element(c.begin(), c.end()), c.end());
+                    kept.push_back(c);
+                }
+            });
+            std::vector<std::array<vtkIdType, 3>> kept;
+            for (auto& k : local)
+                kept.insert(kept.end(), k.begin(), k.end());
+            vtkSMPTools::Sort(kept.begin(), kept.end());
+            kept.erase(std::unique(kept.begin(), kept.end()), kept.end());
+            // a triangle together with its reverse is a fold of the clustered surface, drop both
+            std::vector<char> fold(kept.size(), 0);
+            vtkSMPTools::For(0, static_cast<vtkIdType>(kept.size()), [&](vtkIdType begin, vtkIdType end) {
+                for (auto t = begin; t < end; t++)
+                {
+                    std::array<vtkIdType, 3> const reverse{kept[t][0], kept[t][2], kept[t][1]};
+                    fold[t] = std::binary_search(kept.begin(), kept.end(), reverse);
+                }
+            });
+            std::size_t remaining = 0;
+            for (std::size_t t = 0; t < kept.size(); t++)
+                if (!fold[t]) kept[remaining++] = kept[t];
+            kept.resize(remaining);
+
+            auto const size = static_cast<vtkIdType>(kept.size());
+            vtkNew<vtkIdTypeArray> offsets, connectivity;
+            offsets->SetNumberOfValues(size + 1);
+            connectivity->SetNumberOfValues(size * 3);
+            auto* offset = offsets->GetPointer(0);
+            auto* ids = connectivity->GetPointer(0);
+            vtkSMPTools::For(0, size + 1, [&](vtkIdType begin, vtkIdType end) {
+                for (auto t = begin; t < end; t++)
+                {
+                    offset[t] = t * 3;
+                    if (t < size) std::copy(kept[t].begin(), kept[t].end(), ids + t * 3);
+                }
+            });
+            auto polys = vtkSmartPointer<vtkCellArray>::New();
+            polys->SetData(offsets, connectivity);
+            return polys;
+        }
+
+    private:
+        std::vector<vtkSmartPointer<vtkPolyData>> m_levels;
+        std::unique_ptr<std::atomic<bool>[]> m_ready;
+        std::atomic<bool> m_cancel{false};
+        std::thread m_worker;
+    };
+
+    // same coloring on a mapper of a coarser level (the vtkSet methods leave the mapper unmodified when nothing
+    // changed, so the coarse mapper keeps its buffers)
+    void CopyMeshMapperSettings(vtkPolyDataMapper* src, vtkPolyDataMapper* dst)
+    {
+        dst->SetScalarVisibility(src->GetScalarVisibility());
+        dst->SetScalarMode(src->GetScalarMode());
+        dst->SetColorMode(src->GetColorMode());
+        dst->SetLookupTable(src->GetLookupTable());
+        dst->SetUseLookupTableScalarRange(src->GetUseLookupTableScalarRange());
+        dst->SetScalarRange(src->GetScalarRange());
+        dst->SetInterpolateScalarsBeforeMapping(src->GetInterpolateScalarsBeforeMapping());
+        dst->SetArrayAccessMode(src->GetArrayAccessMode());
+        dst->SetArrayId(src->GetArrayId());
+        dst->SetArrayName(src->GetArrayName());
+        dst->SetArrayComponent(src->GetArrayComponent());
+        dst->SetClippingPlanes(src->GetClippingPlanes());
+    }
+
+    // Frame budget level of detail for a mesh actor, the MVolumeLOD of surfaces.
+    // While the interactor style is interacting, the renderer's last render time (the one the FPS overlays show)
+    // picks the pyramid level of the next frame: a frame over budget switches to the next coarser level that is
+    // ready, a frame whose time scaled by the triangles of the finer level still fits the budget switches back.
+    // The time is smoothed over a few frames so a single slow frame does not flip the level. Every level has its
+    // own mapper, switching only swaps the actor's mapper and never re-uploads the data. When the interaction
+    // ends the full resolution comes back for the render the style does then.
+    class MMeshLOD: public vtkCommand
+    {
+    public:
+        static MMeshLOD* New();
+        vtkTypeMacro(MMeshLOD, vtkCommand);
+
+        // the actor's mapper input is level 0, budget in seconds per frame; small meshes are left alone
+        void Setup(vtkActor* actor, vtkRenderer* renderer, vtkRenderWindowInteractor* interactor,
+                   double budget = 1.0 / 15, int levels = 4)
+        {
+            m_actor = actor;
+            m_budget = budget;
+            m_mappers.assign(levels + 1, nullptr);
+            m_mappers[0] = vtkPolyDataMapper::SafeDownCast(actor->GetMapper());
+            if (!m_mappers[0]) return;
+            // the input of a mapper fed by a filter is only there after an update
+            m_mappers[0]->Update();
+            auto* mesh = m_mappers[0]->GetInput();
+            if (!mesh || mesh->GetNumberOfPolys() < min_triangles)
+            {
+                m_mappers[0] = nullptr;
+                return;
+            }
+            m_pyramid.BuildAsync(mesh, levels);
+
+            renderer->AddObserver(vtkCommand::EndEvent, this);
+            auto* style = interactor->GetInteractorStyle();
+            style->AddObserver(vtkCommand::StartInteractionEvent, this);
+            style->AddObserver(vtkCommand::EndInteractionEvent, this);
+        }
+
+        int GetLevel() const { return m_level; }
+
+        void Execute(vtkObject* caller, unsigned long eventId, void*) override
+        {
+            if (!m_actor || m_mappers.empty() || !m_mappers[0]) return;
+            switch (eventId)
+            {
+            case vtkCommand::StartInteractionEvent:
+                // start where the last interaction settled
+                m_interacting = true;
+                m_smoothed_time = 0;
+                SetLevel(m_interactive_level);
+                break;
+            case vtkCommand::EndInteractionEvent:
+                m_interacting = false;
+                m_interactive_level = m_level;
+                // the style renders right after this event
+                if (m_level != 0) SetLevel(0);
+                break;
+            case vtkCommand::EndEvent:
+                if (m_interacting) Update(static_cast<vtkRenderer*>(caller)->GetLastRenderTimeInSeconds());
+                break;
+            default:
+                break;
+            }
+        }
+
+    private:
+        static constexpr vtkIdType min_triangles = 200000; // fast enough at full resolution below
+
+        void Update(double seconds)
+        {
+            m_smoothed_time = m_smoothed_time > 0 ? 0.5 * m_smoothed_time + 0.5 * seconds : seconds;
+            if (m_smoothed_time > m_budget)
+            {
+                for (auto level = m_level + 1; level < m_pyramid.GetNumberOfLevels(); level++)
+                    if (m_pyramid.GetLevel(level))
+                    {
+                        SetLevel(level);
+                        m_smoothed_time = 0;
+                        break;
+                    }
+            }
+            else if (m_level > 0)
+            {
+                // the cost of a frame goes with the triangles drawn
+                auto const finer = static_cast<double>(m_pyramid.GetLevel(m_level - 1)->GetNumberOfPolys());
+                auto const current =
+                    std::max(static_cast<double>(m_pyramid.GetLevel(m_level)->GetNumberOfPolys()), 1.0);
+                if (m_smoothed_time * finer / current < 0.8 * m_budget)
+                {
+                    SetLevel(m_level - 1);
+                    m_smoothed_time = 0;
+                }
+            }
+        }
+
+        void SetLevel(int level)
+        {
+            auto* mesh = m_pyramid.GetLevel(level);
+            if (!mesh) return;
+            if (!m_mappers[level])
+            {
+                m_mappers[level].TakeReference(m_mappers[0]->NewInstance());
+                m_mappers[level]->SetInputData(mesh);
+            }
+            // the full resolution mapper may have changed since (coloring, clipping)
+            if (level > 0) CopyMeshMapperSettings(m_mappers[0], m_mappers[level]);
+            m_actor->SetMapper(m_mappers[level]);
+            m_level = level;
+        }
+
+    private:
+        vtkWeakPointer<vtkActor> m_actor;
+        MeshPyramid m_pyramid;
+        std::vector<vtkSmartPointer<vtkPolyDataMapper>> m_mappers;
+        double m_budget = 1.0 / 15;
+        double m_smoothed_time = 0;
+        bool m_interacting = false;
+        int m_level = 0;
+        int m_interactive_level = 0;
+    };
+    vtkStandardNewMacro(MMeshLOD);
+
+    // decimate the actor's mesh in the background and draw coarser levels while interacting
+    vtkSmartPointer<MMeshLOD> SetupMeshLOD(vtkActor* actor, vtkRenderer* renderer,
+                                           vtkRenderWindowInteractor* interactor, double budget = 1.0 / 15)
+    {
+        auto lod = vtkSmartPointer<MMeshLOD>::New();
+        lod->Setup(actor, renderer, interactor, budget);
+        return lod;
+    }
+} // namespace
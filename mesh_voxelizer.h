@@ -0,0 +1,280 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkCellArray.h>
+#include <vtkPoints.h>
+#include <vtkImageData.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "sparse_volume.h"
+
+namespace
+{
+    // Scanline voxelizer for closed triangle meshes.
+    // The voxel grid is the same as the stencil based conversion used before (origin at bounds min + spacing / 2,
+    // ceil(size / spacing) voxels per axis), a voxel is inside when its center is inside the mesh (even-odd rule).
+    // Triangles are bucketed per slice once, each slice then buckets its triangles per row, casts one ray per row
+    // along x and fills the spans between the sorted crossings, so each output voxel is written exactly once.
+    // Crossings on shared edges/vertices follow a top-left fill rule, so they are counted once.
+    class MeshVoxelizer
+    {
+    public:
+        static constexpr unsigned char inval = 255;
+        static constexpr unsigned char outval = 0;
+
+        // per-thread buffers reused across slices
+        struct Scratch
+        {
+            std::vector<int> row_offsets;
+            std::vector<int> row_triangles;
+            std::vector<double> crossings;
+        };
+
+        bool SetInputData(vtkPolyData* polyData, double const spacing[3])
+        {
+            m_triangles.clear();
+            if (!polyData || polyData->GetNumberOfPoints() == 0) return false;
+
+            double bounds[6];
+            polyData->GetBounds(bounds);
+            for (int i = 0; i < 3; i++)
+            {
+                m_spacing[i] = spacing[i];
+                m_dims[i] = std::max(static_cast<int>(std::ceil((bounds[i * 2 + 1] - bounds[i * 2]) / spacing[i])), 1);
+                m_origin[i] = bounds[i * 2] + spacing[i] / 2;
+            }
+
+            // fan triangulation of the polygons (STL data is triangles already)
+            auto* points = polyData->GetPoints();
+            auto* polys = polyData->GetPolys();
+            vtkIdType npts;
+            vtkIdType const* pts;
+            m_triangles.reserve(polys->GetNumberOfCells());
+            for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+                for (vtkIdType i = 2; i < npts; i++)
+                {
+                    Triangle t;
+                    points->GetPoint(pts[0], t.v[0].data());
+                    points->GetPoint(pts[i - 1], t.v[1].data());
+                    points->GetPoint(pts[i], t.v[2].data());
+                    m_triangles.push_back(t);
+                }
+
+            // bucket the triangles per slice (CSR layout)
+            m_slice_offsets.assign(m_dims[2] + 1, 0);
+            for (auto const& t : m_triangles)
+            {
+                int first, last;
+                if (IndexRange(t, 2, first, last))
+                    for (auto z = first; z <= last; z++)
+                        m_slice_offsets[z + 1]++;
+            }
+            for (int z = 0; z < m_dims[2]; z++)
+                m_slice_offsets[z + 1] += m_slice_offsets[z];
+            m_slice_triangles.resize(m_slice_offsets.back());
+            std::vector<int> fill(m_slice_offsets.begin(), m_slice_offsets.end() - 1);
+            for (int i = 0; i < static_cast<int>(m_triangles.size()); i++)
+            {
+                int first, last;
+                if (IndexRange(m_triangles[i], 2, first, last))
+                    for (auto z = first; z <= last; z++)
+                        m_slice_triangles[fill[z]++] = i;
+            }
+            return !m_triangles.empty();
+        }
+
+        int const* GetDimensions() const { return m_dims; }
+
+        double const* GetOrigin() const { return m_origin; }
+
+        double const* GetSpacing() const { return m_spacing; }
+
+        // voxelize rows [y_begin, y_end) of slice z into out ((y_end - y_begin) * dims[0] voxels, x fastest),
+        // the whole slice by default
+        void VoxelizeSlice(int z, unsigned char* out, Scratch& scratch, int y_begin = 0, int y_end = -1) const
+        {
+            auto const nx = m_dims[0];
+            if (y_end < 0) y_end = m_dims[1];
+            auto const ny = y_end - y_begin;
+            std::memset(out, outval, static_cast<size_t>(nx) * ny);
+            if (z < 0 || z >= m_dims[2] || m_slice_offsets[z] == m_slice_offsets[z + 1]) return;
+
+            // bucket the triangles of this slice per row (rows relative to y_begin)
+            auto& offsets = scratch.row_offsets;
+            auto& ids = scratch.row_triangles;
+            offsets.assign(ny + 1, 0);
+            for (auto k = m_slice_offsets[z]; k < m_slice_offsets[z + 1]; k++)
+            {
+                int first, last;
+                if (IndexRange(m_triangles[m_slice_triangles[k]], 1, first, last, y_begin, y_end - 1))
+                    for (auto y = first; y <= last; y++)
+                        offsets[y - y_begin + 1]++;
+            }
+            for (int y = 0; y < ny; y++)
+                offsets[y + 1] += offsets[y];
+            ids.resize(offsets.back());
+            for (auto k = m_slice_offsets[z]; k < m_slice_offsets[z + 1]; k++)
+            {
+                auto const i = m_slice_triangles[k];
+                int first, last;
+                if (IndexRange(m_triangles[i], 1, first, last, y_begin, y_end - 1))
+                    for (auto y = first; y <= last; y++)
+                        ids[offsets[y - y_begin]++] = i;
+            }
+            // offsets[y] now points at the end of row y
+            for (auto y = ny; y > 0; y--)
+                offsets[y] = offsets[y - 1];
+            offsets[0] = 0;
+
+            auto const zc = m_origin[2] + z * m_spacing[2];
+            auto& xs = scratch.crossings;
+            for (int y = 0; y < ny; y++)
+            {
+                if (offsets[y] == offsets[y + 1]) continue;
+                auto const yc = m_origin[1] + (y_begin + y) * m_spacing[1];
+                xs.clear();
+                for (auto k = offsets[y]; k < offsets[y + 1]; k++)
+                {
+                    double x;
+                    if (Crossing(m_triangles[ids[k]], yc, zc, x)) xs.push_back(x);
+                }
+                std::sort(xs.begin(), xs.end());
+                auto* row = out + static_cast<size_t>(y) * nx;
+                for (size_t k = 0; k + 1 < xs.size(); k += 2)
+                {
+                    // voxel centers in [xs[k], xs[k + 1])
+                    auto const x0 =
+                        std::clamp(static_cast<int>(std::ceil((xs[k] - m_origin[0]) / m_spacing[0])), 0, nx);
+                    auto const x1 =
+                        std::clamp(static_cast<int>(std::ceil((xs[k + 1] - m_origin[0]) / m_spacing[0])), 0, nx);
+                    if (x1 > x0) std::memset(row + x0, inval, x1 - x0);
+                }
+            }
+        }
+
+        // dense 0/255 volume, slices are voxelized in parallel straight into the output scalars
+        vtkSmartPointer<vtkImageData> Voxelize() const
+        {
+            auto img = vtkSmartPointer<vtkImageData>::New();
+            img->SetSpacing(m_spacing);
+            img->SetOrigin(m_origin);
+            img->SetExtent(0, m_dims[0] - 1, 0, m_dims[1] - 1, 0, m_dims[2] - 1);
+            img->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+            auto* out = static_cast<unsigned char*>(img->GetScalarPointer());
+            auto const slice_size = static_cast<size_t>(m_dims[0]) * m_dims[1];
+            vtkSMPTools::For(0, m_dims[2], 1, [&](vtkIdType begin, vtkIdType end) {
+                Scratch scratch;
+                for (auto z = begin; z < end; z++)
+                    VoxelizeSlice(static_cast<int>(z), out + z * slice_size, scratch);
+            });
+            return img;
+        }
+
+        // sparse 0/255 volume: one task per row of bricks (brick_size slices x brick_size rows), so the scratch
+        // memory is one brick row per thread and the full dense grid never exists
+        void VoxelizeSparse(SparseVolume& sparse, int brick_size = 16) const
+        {
+            sparse.Initialize(m_dims, m_origin, m_spacing, brick_size, outval);
+            auto const bs = sparse.GetBrickSize();
+            auto const* brick_dims = sparse.GetBrickDimensions();
+            auto const nx = m_dims[0];
+            auto const padded_nx = brick_dims[0] * bs;
+            vtkSMPTools::For(0, static_cast<vtkIdType>(brick_dims[1]) * brick_dims[2], 1, [&](vtkIdType begin,
+                                                                                              vtkIdType end) {
+                Scratch scratch;
+                std::vector<unsigned char> rows(static_cast<size_t>(bs) * bs * padded_nx, outval);
+                std::vector<unsigned char> slice(static_cast<size_t>(bs) * nx);
+                std::vector<unsigned char> brick(static_cast<size_t>(bs) * bs * bs);
+                for (auto task = begin; task < end; task++)
+                {
+                    auto const by = static_cast<int>(task % brick_dims[1]), bz = static_cast<int>(task / brick_dims[1]);
+                    auto const y0 = by * bs, y1 = std::min(y0 + bs, m_dims[1]);
+                    auto const z0 = bz * bs;
+                    // skip brick rows no triangle reaches in z: they are uniform, the parity along x is 0
+                    auto const z1 = std::min(z0 + bs, m_dims[2]);
+                    if (m_slice_offsets[z0] == m_slice_offsets[z1]) continue;
+
+                    std::fill(rows.begin(), rows.end(), outval);
+                    for (auto z = z0; z < z1; z++)
+                    {
+                        VoxelizeSlice(z, slice.data(), scratch, y0, y1);
+                        for (auto y = y0; y < y1; y++)
+                            std::memcpy(rows.data() + ((static_cast<size_t>(z - z0) * bs + (y - y0)) * padded_nx),
+                                        slice.data() + static_cast<size_t>(y - y0) * nx, nx);
+                    }
+                    for (int bx = 0; bx < brick_dims[0]; bx++)
+                    {
+                        for (int k = 0; k < bs * bs; k++)
+                            std::memcpy(brick.data() + k * bs,
+                                        rows.data() + static_cast<size_t>(k) * padded_nx + bx * bs, bs);
+                        sparse.SetBrick(bx, by, bz, brick.data());
+                    }
+                }
+            });
+        }
+
+    private:
+        struct Triangle
+        {
+            std::array<double, 3> v[3];
+        };
+
+        // indices of the voxel centers covered by the triangle along axis within [lower, upper], false if none
+        bool IndexRange(Triangle const& t, int axis, int& first, int& last, int lower = 0, int upper = -1) const
+        {
+            if (upper < 0) upper = m_dims[axis] - 1;
+            auto const lo = std::min({t.v[0][axis], t.v[1][axis], t.v[2][axis]});
+            auto const hi = std::max({t.v[0][axis], t.v[1][axis], t.v[2][axis]});
+            first = std::max(static_cast<int>(std::ceil((lo - m_origin[axis]) / m_spacing[axis])), lower);
+            last = std::min(static_cast<int>(std::floor((hi - m_origin[axis]) / m_spacing[axis])), upper);
+            return first <= last;
+        }
+
+        // x of the crossing between the triangle and the ray (yc, zc) along x
+        static bool Crossing(Triangle const& t, double yc, double zc, double& x)
+        {
+            double w[3];
+            for (int i = 0; i < 3; i++)
+            {
+                // edge function of the edge opposite to vertex i, in the yz projection
+                auto const& a = t.v[(i + 1) % 3];
+                auto const& b = t.v[(i + 2) % 3];
+                w[i] = (b[1] - a[1]) * (zc - a[2]) - (b[2] - a[2]) * (yc - a[1]);
+            }
+            auto const area = w[0] + w[1] + w[2];
+            if (area == 0) return false; // parallel to the ray
+            auto const sign = area > 0 ? 1.0 : -1.0;
+            for (int i = 0; i < 3; i++)
+            {
+                auto const s = w[i] * sign;
+                if (s < 0) return false;
+                if (s == 0)
+                {
+                    // on the edge: keep it only for one of the two (oppositely oriented) triangles sharing it
+                    auto const& a = t.v[(i + 1) % 3];
+                    auto const& b = t.v[(i + 2) % 3];
+                    auto const dy = (b[1] - a[1]) * sign, dz = (b[2] - a[2]) * sign;
+                    if (!(dz > 0 || (dz == 0 && dy > 0))) return false;
+                }
+            }
+            x = (w[0] * t.v[0][0] + w[1] * t.v[1][0] + w[2] * t.v[2][0]) / area;
+            return true;
+        }
+
+    private:
+        int m_dims[3]{0, 0, 0};
+        double m_origin[3]{0, 0, 0};
+        double m_spacing[3]{1, 1, 1};
+        std::vector<Triangle> m_triangles;
+        std::vector<int> m_slice_offsets;
+        std::vector<int> m_slice_triangles;
+    };
+} // namespace
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkImageData.h>
+#include <vtkImageStack.h>
+#include <vtkImageSlice.h>
+#include <vtkImageSliceMapper.h>
+#include <vtkImageProperty.h>
+#include <vtkScalarsToColors.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkCamera.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // Several image layers on one slice: one vtkImageSlice per layer inside a vtkImageStack, one shared slice
+    // index and a single render per interaction. Each layer has its own lookup table (or window/level) and opacity.
+    // The slice mappers stream, so a slice change only pulls and uploads the visible slice of the visible layers,
+    // the cost does not grow with the size of the volumes.
+    // The orientation follows vtkImageViewer2: 0 -> YZ, 1 -> XZ, 2 -> XY
+    class MultiLayerSliceView
+    {
+    public:
+        MultiLayerSliceView()
+        {
+            m_renderer->AddViewProp(m_stack);
+            m_renderer->GetActiveCamera()->ParallelProjectionOn();
+            m_render_window->AddRenderer(m_renderer);
+        }
+
+        // layers are drawn in the order they are added, the first one is the base layer
+        // without a lookup table the layer is shown as grayscale with its own window/level
+        int AddLayer(vtkImageData* img, vtkScalarsToColors* lut = nullptr, double opacity = 1.0)
+        {
+            vtkNew<vtkImageSliceMapper> mapper;
+            mapper->SetInputData(img);
+            mapper->StreamingOn();
+            mapper->SliceAtFocalPointOff();
+            mapper->SliceFacesCameraOff();
+            mapper->SetOrientation(m_orientation);
+            mapper->SetSliceNumber(m_slice);
+
+            vtkNew<vtkImageSlice> slice;
+            slice->SetMapper(mapper);
+            auto* property = slice->GetProperty();
+            property->SetLayerNumber(static_cast<int>(m_layers.size()));
+            property->SetOpacity(opacity);
+            if (lut)
+            {
+                // label style layer: colors straight from the table, no smoothing across label borders
+                property->SetLookupTable(lut);
+                property->UseLookupTableScalarRangeOn();
+                property->SetInterpolationTypeToNearest();
+            }
+            slice->SetPickable(m_layers.empty());
+
+            m_stack->AddImage(slice);
+            if (m_layers.empty())
+            {
+                m_stack->SetActiveLayer(0);
+                UpdateSliceRange();
+                m_slice = (m_slice_range[0] + m_slice_range[1]) / 2;
+                mapper->SetSliceNumber(m_slice);
+            }
+            m_layers.push_back(slice);
+            return static_cast<int>(m_layers.size()) - 1;
+        }
+
+        int GetNumberOfLayers() const { return static_cast<int>(m_layers.size()); }
+
+        vtkImageProperty* GetLayerProperty(int layer) { return m_layers.at(layer)->GetProperty(); }
+
+        void SetLayerOpacity(int layer, double opacity) { GetLayerProperty(layer)->SetOpacity(opacity); }
+
+        // hidden layers are not rendered, so they do not cost anything on slice changes
+        void SetLayerVisibility(int layer, bool visible) { m_layers.at(layer)->SetVisibility(visible); }
+
+        void SetLayerWindowLevel(int layer, double window, double level)
+        {
+            GetLayerProperty(layer)->SetColorWindow(window);
+            GetLayerProperty(layer)->SetColorLevel(level);
+        }
+
+        void SetSliceOrientation(int orientation)
+        {
+            m_orientation = std::clamp(orientation, 0, 2);
+            for (auto& layer : m_layers)
+                static_cast<vtkImageSliceMapper*>(layer->GetMapper())->SetOrientation(m_orientation);
+            UpdateSliceRange();
+            m_slice = (m_slice_range[0] + m_slice_range[1]) / 2;
+            SetSlice(m_slice);
+            ResetCamera();
+        }
+
+        int GetSliceOrientation() const { return m_orientation; }
+
+        int GetSliceMin() const { return m_slice_range[0]; }
+
+        int GetSliceMax() const { return m_slice_range[1]; }
+
+        int GetSlice() const { return m_slice; }
+
+        // one slice index for all layers
+        void SetSlice(int slice)
+        {
+            m_slice = std::clamp(slice, m_slice_range[0], m_slice_range[1]);
+            for (auto& layer : m_layers)
+                static_cast<vtkImageSliceMapper*>(layer->GetMapper())->SetSliceNumber(m_slice);
+        }
+
+        void ResetCamera()
+        {
+            // same camera placement as vtkImageViewer2
+            auto* camera = m_renderer->GetActiveCamera();
+            double const* focal = camera->GetFocalPoint();
+            double position[3]{focal[0], focal[1], focal[2]};
+            // vtkImageViewer2 looks at XZ slices from -y, the others from +x and +z
+            position[m_orientation] += m_orientation == 1 ? -1 : 1;
+            camera->SetPosition(position);
+            camera->SetViewUp(0, m_orientation == 2 ? 1 : 0, m_orientation == 2 ? 0 : 1);
+            m_renderer->ResetCamera();
+        }
+
+        void Render()
+        {
+            if (m_first_render)
+            {
+                ResetCamera();
+                m_first_render = false;
+            }
+            m_render_window->Render();
+        }
+
+        void SetupInteractor(vtkRenderWindowInteractor* interactor) { interactor->SetRenderWindow(m_render_window); }
+
+        vtkRenderer* GetRenderer() { return m_renderer; }
+
+        vtkRenderWindow* GetRenderWindow() { return m_render_window; }
+
+    private:
+        void UpdateSliceRange()
+        {
+            auto* active = m_stack->GetActiveImage();
+            if (!active) return;
+            auto* mapper = static_cast<vtkImageSliceMapper*>(active->GetMapper());
+            mapper->UpdateInformation();
+            m_slice_range[0] = mapper->GetSliceNumberMinValue();
+            m_slice_range[1] = mapper->GetSliceNumberMaxValue();
+        }
+
+    private:
+        vtkNew<vtkImageStack> m_stack;
+        vtkNew<vtkRenderer> m_renderer;
+        vtkNew<vtkRenderWindow> m_render_window;
+        std::vector<vtkSmartPointer<vtkImageSlice>> m_layers;
+        int m_orientation = 2;
+        int m_slice = 0;
+        int m_slice_range[2]{0, 0};
+        bool m_first_render = true;
+    };
+} // namespace
@@ -0,0 +1,93 @@
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkPCANormalEstimation.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "load_3d.h"
+#include "point_normals.h"
+
+// fraction of points whose normals agree up to sign, and the fraction with the same sign (the sign of a graph
+// traversal is only consistent, not absolute)
+void CompareNormals(vtkDataArray* a, vtkDataArray* b, double& agree, double& same_sign)
+{
+    vtkIdType parallel = 0, same = 0;
+    for (vtkIdType i = 0; i < a->GetNumberOfTuples(); i++)
+    {
+        double n[3], m[3];
+        a->GetTuple(i, n);
+        b->GetTuple(i, m);
+        auto const dot = n[0] * m[0] + n[1] * m[1] + n[2] * m[2];
+        if (std::abs(dot) > 0.99) parallel++;
+        if (dot > 0) same++;
+    }
+    agree = static_cast<double>(parallel) / a->GetNumberOfTuples();
+    same_sign = static_cast<double>(same) / a->GetNumberOfTuples();
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " Filename e.g scan.xyz [sample_size=10] [runs=3]" << std::endl;
+        std::cout << "times vtkPCANormalEstimation (graph traversal) against the parallel PointNormalEstimation "
+                     "for 1, 2, 4, ... threads"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto const sample_size = argc > 2 ? std::stoi(argv[2]) : 10;
+    auto const runs = argc > 3 ? std::max(std::stoi(argv[3]), 1) : 3;
+
+    auto polydata = ReadPolyData(argv[1]);
+    std::cout << polydata->GetNumberOfPoints() << " points, " << sample_size << " neighbours, "
+              << vtkSMPTools::GetBackend() << " backend" << std::endl;
+
+    auto const start = std::chrono::steady_clock::now();
+    vtkNew<vtkPCANormalEstimation> reference;
+    reference->SetInputData(polydata);
+    reference->SetSampleSize(sample_size);
+    reference->SetNormalOrientationToGraphTraversal();
+    reference->Update();
+    auto const reference_ms =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "vtkPCANormalEstimation: " << reference_ms << " ms" << std::endl;
+
+    vtkSMPTools::Initialize();
+    auto const max_threads = vtkSMPTools::GetEstimatedNumberOfThreads();
+    double single_ms = 0;
+    for (int threads = 1;; threads = std::min(threads * 2, max_threads))
+    {
+        vtkSMPTools::Initialize(threads);
+        PointNormalEstimation normals;
+        normals.SetSampleSize(sample_size);
+        normals.SetOrientationToGraphTraversal();
+        vtkSmartPointer<vtkPolyData> output;
+        // best of runs
+        auto ms = std::numeric_limits<double>::max();
+        for (int run = 0; run < runs; run++)
+        {
+            auto const begin = std::chrono::steady_clock::now();
+            output = normals.Execute(polydata);
+            auto const end = std::chrono::steady_clock::now();
+            ms = std::min(ms, std::chrono::duration<double, std::milli>(end - begin).count());
+        }
+        if (threads == 1) single_ms = ms;
+
+        double agree, same_sign;
+        CompareNormals(output->GetPointData()->GetNormals(), reference->GetOutput()->GetPointData()->GetNormals(),
+                       agree, same_sign);
+        std::cout << threads << " threads: " << ms << " ms, scaling " << single_ms / ms << "x, vs vtk "
+                  << reference_ms / ms << "x, " << agree * 100 << "% same normals ("
+                  << std::max(same_sign, 1 - same_sign) * 100 << "% consistently oriented)" << std::endl;
+        if (threads == max_threads) break;
+    }
+    return EXIT_SUCCESS;
+}
@@ -21,6 +21,11 @@
 #include <sstream>
 #include <iostream>
 
+#include "brick_volume.h"
+
+// extract slices from a bricked copy of the volume, keeps YZ/XZ scrolling as fast as XY but holds the volume twice
+//#define USE_BRICKED_VOLUME
+
 class myInteractorStyler final: public vtkInteractorStyleImage
 {
 public:
@@ -31,10 +36,17 @@ public:
     void setImageViewer(vtkImageViewer2* imageViewer, int slice_no = 0)
     {
         m_viewer = imageViewer;
+#ifdef USE_BRICKED_VOLUME
+        int range[2];
+        m_bricks->GetSliceRange(m_viewer->GetSliceOrientation(), range);
+        m_slice_min = range[0];
+        m_slice_max = range[1];
+#else
         m_slice_min = imageViewer->GetSliceMin();
         m_slice_max = imageViewer->GetSliceMax();
+#endif
         m_slice = slice_no <= 0 ? (m_slice_min + m_slice_max) / 2 : slice_no;
-        m_viewer->SetSlice(m_slice);
+        setSlice(m_slice);
 
         if (!m_text)
         {
@@ -45,6 +57,10 @@ public:
         ShowSliceText();
     }
 
+#ifdef USE_BRICKED_VOLUME
+    void setBrickedVolume(BrickedVolume* bricks) { m_bricks = bricks; }
+#endif
+
 protected:
     void OnMouseWheelForward() override { moveSliceForward(); }
 
@@ -52,22 +68,51 @@ protected:
 
     void OnChar() override
     {
+        int orientation = -1;
         if (Interactor->GetKeyCode() == 'x')
-            m_viewer->SetSliceOrientationToYZ();
+            orientation = vtkImageViewer2::SLICE_ORIENTATION_YZ;
         else if (Interactor->GetKeyCode() == 'y')
-            m_viewer->SetSliceOrientationToXZ();
+            orientation = vtkImageViewer2::SLICE_ORIENTATION_XZ;
         else if (Interactor->GetKeyCode() == 'z')
-            m_viewer->SetSliceOrientationToXY();
+            orientation = vtkImageViewer2::SLICE_ORIENTATION_XY;
+        if (orientation < 0) return;
+
+#ifdef USE_BRICKED_VOLUME
+        // the slab has to be in place before the viewer asks for the new slice range
+        int range[2];
+        m_bricks->GetSliceRange(orientation, range);
+        m_slice_min = range[0];
+        m_slice_max = range[1];
+        m_slice = (m_slice_min + m_slice_max) / 2;
+        m_viewer->SetInputData(m_bricks->GetSlice(orientation, m_slice));
+        m_viewer->SetSliceOrientation(orientation);
+#else
+        m_viewer->SetSliceOrientation(orientation);
+        m_slice_min = m_viewer->GetSliceMin();
+        m_slice_max = m_viewer->GetSliceMax();
+        m_slice = m_viewer->GetSlice();
+#endif
+        m_viewer->SetSlice(m_slice);
+        ShowSliceText();
+        m_viewer->Render();
     }
 
 private:
+    void setSlice(int slice)
+    {
+#ifdef USE_BRICKED_VOLUME
+        m_bricks->GetSlice(m_viewer->GetSliceOrientation(), slice);
+#endif
+        m_viewer->SetSlice(slice);
+    }
+
     void moveSliceForward()
     {
         if (m_slice < m_slice_max)
         {
             m_slice += 1;
 
-            m_viewer->SetSlice(m_slice);
+            setSlice(m_slice);
             ShowSliceText();
         }
     }
@@ -78,7 +123,7 @@ private:
         {
             m_slice -= 1;
 
-            m_viewer->SetSlice(m_slice);
+            setSlice(m_slice);
             ShowSliceText();
         }
     }
@@ -96,6 +141,9 @@ private:
     int m_slice_min;
     int m_slice_max;
     vtkSmartPointer<vtkCornerAnnotation> m_text = nullptr;
+#ifdef USE_BRICKED_VOLUME
+    BrickedVolume* m_bricks = nullptr;
+#endif
 };
 vtkStandardNewMacro(myInteractorStyler);
 
@@ -141,11 +189,23 @@ int main(int argc, char* argv[])
     img_data->GetInformation()->Print(std::cout);
 
     vtkNew<vtkImageViewer2> viewer;
+#ifdef USE_BRICKED_VOLUME
+    BrickedVolume bricks;
+    bricks.SetInputData(img_data);
+    std::cout << "bricked volume: " << bricks.GetMemorySize() / (1024 * 1024) << " MB" << std::endl;
+    int z_range[2];
+    bricks.GetSliceRange(vtkImageViewer2::SLICE_ORIENTATION_XY, z_range);
+    viewer->SetInputData(bricks.GetSlice(vtkImageViewer2::SLICE_ORIENTATION_XY, (z_range[0] + z_range[1]) / 2));
+#else
     viewer->SetInputData(img_data);
+#endif
     viewer->SetSliceOrientationToXY();
 
     vtkNew<vtkRenderWindowInteractor> interactor;
     vtkNew<myInteractorStyler> style;
+#ifdef USE_BRICKED_VOLUME
+    style->setBrickedVolume(&bricks);
+#endif
     style->setImageViewer(viewer);
     viewer->SetupInteractor(interactor); // this line should be put before the next line... otherwise the style not work
     interactor->SetInteractorStyle(style);
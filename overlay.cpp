@@ -40,8 +40,14 @@
 #include <iostream>
 #include <sstream>
 
+#include "multi_layer_view.h"
+
 //#define USE_SLIDER
 
+// one vtkImageStack with a layer per image instead of one vtkImageViewer2 per image sharing the render window:
+// one slice index, per-layer lookup table/opacity and a single render per interaction
+#define MULTI_LAYER_VIEW
+
 class MImageViewer2: public vtkImageViewer2
 {
 public:
@@ -79,15 +85,27 @@ public:
     {
         vtkSliderWidget* sliderWidget = reinterpret_cast<vtkSliderWidget*>(caller);
 
+#ifdef MULTI_LAYER_VIEW
+        auto const slice =
+            static_cast<int>(static_cast<vtkSliderRepresentation*>(sliderWidget->GetRepresentation())->GetValue());
+        if (slice == this->view->GetSlice()) return;
+        this->view->SetSlice(slice);
+        this->view->Render();
+#else
         this->viewer->SetSlice(static_cast<vtkSliderRepresentation*>(sliderWidget->GetRepresentation())->GetValue());
         if (this->viewer1 != nullptr)
             this->viewer1->SetSlice(
                 static_cast<vtkSliderRepresentation*>(sliderWidget->GetRepresentation())->GetValue());
         this->viewer->Render();
+#endif
     }
     MSliderCallback() {}
+#ifdef MULTI_LAYER_VIEW
+    MultiLayerSliceView* view = nullptr;
+#else
     vtkSmartPointer<MImageViewer2> viewer = nullptr;
     vtkSmartPointer<MImageViewer2> viewer1 = nullptr;
+#endif
 };
 #else
 class myInteractorStyler final: public vtkInteractorStyleImage
@@ -97,6 +115,15 @@ public:
 
     vtkTypeMacro(myInteractorStyler, vtkInteractorStyleImage);
 
+#ifdef MULTI_LAYER_VIEW
+    void setSliceView(MultiLayerSliceView* view)
+    {
+        m_view = view;
+        m_slice_min = view->GetSliceMin();
+        m_slice_max = view->GetSliceMax();
+        m_slice = view->GetSlice();
+    }
+#else
     void setImageViewers(vtkImageViewer2* viewer1, vtkImageViewer2* viewer2)
     {
         m_viewer1 = viewer1;
@@ -105,6 +132,7 @@ public:
         m_slice_max = viewer1->GetSliceMax();
         m_slice = (m_slice_min + m_slice_max) / 2;
     }
+#endif
 
 protected:
     void OnMouseWheelForward() override { moveSliceForward(); }
@@ -118,9 +146,14 @@ private:
         {
             m_slice += 1;
 
+#ifdef MULTI_LAYER_VIEW
+            m_view->SetSlice(m_slice);
+            m_view->Render();
+#else
             m_viewer1->SetSlice(m_slice);
             m_viewer2->SetSlice(m_slice);
             m_viewer1->Render();
+#endif
         }
         std::cout << m_slice << '\n';
     }
@@ -131,15 +164,24 @@ private:
         {
             m_slice -= 1;
 
+#ifdef MULTI_LAYER_VIEW
+            m_view->SetSlice(m_slice);
+            m_view->Render();
+#else
             m_viewer1->SetSlice(m_slice);
             m_viewer2->SetSlice(m_slice);
             m_viewer1->Render();
+#endif
         }
         std::cout << m_slice << '\n';
     }
 
 private:
+#ifdef MULTI_LAYER_VIEW
+    MultiLayerSliceView* m_view;
+#else
     vtkImageViewer2 *m_viewer1, *m_viewer2;
+#endif
     int m_slice;
     int m_slice_min;
     int m_slice_max;
@@ -187,6 +229,26 @@ vtkSmartPointer<vtkImageData> LoadNii(const char* file_path)
 
 void overlay(vtkSmartPointer<vtkImageData> dicom, vtkSmartPointer<vtkImageData> nii)
 {
+#ifdef MULTI_LAYER_VIEW
+    vtkSmartPointer<vtkLookupTable> pColorTable = vtkSmartPointer<vtkLookupTable>::New();
+    pColorTable->SetNumberOfColors(2);
+    pColorTable->SetTableRange(nii->GetScalarRange());
+    pColorTable->SetTableValue(0, 0.0, 0.0, 1.0, 0.0);
+    pColorTable->SetTableValue(1, 1, 0, 0, 1.0);
+    pColorTable->Build();
+
+    MultiLayerSliceView view;
+    view.AddLayer(dicom);
+    auto const nii_layer = view.AddLayer(nii, pColorTable);
+    view.GetLayerProperty(nii_layer)->SetDiffuse(0.0);
+    view.SetSlice(255);
+    view.GetRenderWindow()->SetWindowName("overlay");
+    view.GetRenderWindow()->SetSize(500, 500);
+
+    vtkSmartPointer<vtkRenderWindowInteractor> rwi = vtkSmartPointer<vtkRenderWindowInteractor>::New();
+    view.SetupInteractor(rwi);
+    auto* renderer = view.GetRenderer();
+#else
     vtkSmartPointer<MImageViewer2> viewer = vtkSmartPointer<MImageViewer2>::New();
     viewer->SetInputData(dicom);
     viewer->SetSlice(255);
@@ -214,11 +276,18 @@ void overlay(vtkSmartPointer<vtkImageData> dicom, vtkSmartPointer<vtkImageData>
 
     vtkSmartPointer<vtkRenderWindowInteractor> rwi = vtkSmartPointer<vtkRenderWindowInteractor>::New();
     viewer->SetupInteractor(rwi);
+    auto* renderer = viewer->GetRenderer();
+#endif
 
 #ifdef USE_SLIDER
     vtkSmartPointer<vtkSliderRepresentation2D> sliderRep = vtkSmartPointer<vtkSliderRepresentation2D>::New();
+#ifdef MULTI_LAYER_VIEW
+    sliderRep->SetMinimumValue(view.GetSliceMin());
+    sliderRep->SetMaximumValue(view.GetSliceMax());
+#else
     sliderRep->SetMinimumValue(viewer->GetSliceMin());
     sliderRep->SetMaximumValue(viewer->GetSliceMax());
+#endif
     sliderRep->SetValue(5.0);
     sliderRep->GetSliderProperty()->SetColor(1, 0, 0);   //red
     sliderRep->GetTitleProperty()->SetColor(1, 0, 0);    //red
@@ -237,13 +306,21 @@ void overlay(vtkSmartPointer<vtkImageData> dicom, vtkSmartPointer<vtkImageData>
     sliderWidget->EnabledOn();
 
     vtkSmartPointer<MSliderCallback> callback = vtkSmartPointer<MSliderCallback>::New();
+#ifdef MULTI_LAYER_VIEW
+    callback->view = &view;
+#else
     callback->viewer = viewer;
     callback->viewer1 = viewerLayer;
+#endif
 
     sliderWidget->AddObserver(vtkCommand::InteractionEvent, callback);
 #else
     vtkNew<myInteractorStyler> style;
+#ifdef MULTI_LAYER_VIEW
+    style->setSliceView(&view);
+#else
     style->setImageViewers(viewer, viewerLayer);
+#endif
     rwi->SetInteractorStyle(style);
 #endif
 
@@ -265,9 +342,12 @@ void overlay(vtkSmartPointer<vtkImageData> dicom, vtkSmartPointer<vtkImageData>
             corner_overlay->SetText(vtkCornerAnnotation::UpperRight, out.str().c_str());
         });
     fps_callback->SetClientData(corner_overlay.Get());
-    viewer->GetRenderer()->AddViewProp(corner_overlay);
-    viewer->GetRenderer()->AddObserver(vtkCommand::EndEvent, fps_callback);
+    renderer->AddViewProp(corner_overlay);
+    renderer->AddObserver(vtkCommand::EndEvent, fps_callback);
 
+#ifdef MULTI_LAYER_VIEW
+    view.Render();
+#endif
     rwi->Start();
 }
 
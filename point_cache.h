@@ -0,0 +1,239 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkFloatArray.h>
+#include <vtkPoints.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkDataArray.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "xyz_reader.h"
+#include "point_normals.h"
+
+namespace
+{
+    // Binary point cloud next to a text scan, so the text is parsed only once:
+    //   header: magic (with the format version), point count, bounds, number of attributes, size and modification
+    //           time of the source file, settings of the estimator that computed the normals
+    //   attribute table: name, components, byte offset of its block
+    //   one packed float32 block per attribute ("points", optionally "normals")
+    // Every attribute is one contiguous block, the components of a point stay interleaved inside it because that is
+    // the layout vtkPoints and the point filters (vtkPCANormalEstimation, the locators) read through
+    // GetVoidPointer; a per component layout would be copied back on every such call.
+    // Load maps the file copy on write and hands the blocks to vtkFloatArrays without copying them, the mapping
+    // lives until the last of those arrays is freed.
+    class PointCloudCache
+    {
+    public:
+        // write points (and normals with 3 components, computed with normal_settings, when given) for the text
+        // file source_path; written to a temporary file first, so a reader never sees half of it.
+        // false when the cache cannot be replaced, e.g. on Windows while an earlier Load still maps it
+        static bool Save(std::string const& cache_path, std::string const& source_path, vtkPoints* points,
+                         vtkDataArray* normals = nullptr, PointNormalSettings const& normal_settings = {})
+        {
+            Header header{};
+            std::memcpy(header.magic, magic, sizeof(magic));
+            if (!points || !SourceStamp(source_path, header.source_size, header.source_time)) return false;
+            header.count = static_cast<std::uint64_t>(points->GetNumberOfPoints());
+            points->GetBounds(header.bounds);
+            // normals whose estimator is unknown cannot be checked against a later one, they are not kept
+            auto const with_normals = normals && normal_settings.estimator != 0 &&
+                                      normals->GetNumberOfComponents() == 3 &&
+                                      normals->GetNumberOfTuples() == points->GetNumberOfPoints();
+            header.attributes = with_normals ? 2 : 1;
+            if (with_normals) header.normal_settings = normal_settings;
+
+            std::vector<Attribute> attributes(header.attributes);
+            auto offset = sizeof(Header) + attributes.size() * sizeof(Attribute);
+            for (size_t i = 0; i < attributes.size(); i++)
+            {
+                std::strcpy(attributes[i].name, i == 0 ? "points" : "normals");
+                attributes[i].components = 3;
+                attributes[i].offset = offset;
+                offset += header.count * 3 * sizeof(float);
+            }
+
+            auto const temp_path = cache_path + ".tmp";
+            {
+                std::ofstream out(temp_path, std::ios::binary);
+                if (!out) return false;
+                out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+                out.write(reinterpret_cast<char const*>(attributes.data()), attributes.size() * sizeof(Attribute));
+                // converted in batches, the source arrays may be double
+                std::vector<float> batch;
+                for (size_t a = 0; a < attributes.size(); a++)
+                {
+                    auto* data = a == 0 ? points->GetData() : normals;
+                    for (vtkIdType first = 0; first < points->GetNumberOfPoints(); first += batch_size)
+                    {
+                        auto const last = std::min<vtkIdType>(first + batch_size, points->GetNumberOfPoints());
+                        batch.resize((last - first) * 3);
+                        for (auto i = first; i < last; i++)
+                            for (int c = 0; c < 3; c++)
+                                batch[(i - first) * 3 + c] = static_cast<float>(data->GetComponent(i, c));
+                        out.write(reinterpret_cast<char const*>(batch.data()), batch.size() * sizeof(float));
+                    }
+                }
+                if (!out) return false;
+            }
+            std::error_code ec;
+            std::filesystem::rename(temp_path, cache_path, ec);
+            if (ec) std::filesystem::remove(temp_path, ec);
+            return !ec;
+        }
+
+        // points of source_path, nullptr when there is no cache or it is stale or damaged.
+        // The cached normals are only added when normal_settings is given, it receives the settings they were
+        // computed with (estimator 0 without normals): the caller compares them with its estimator's and
+        // recomputes the normals on a mismatch.
+        static vtkSmartPointer<vtkPolyData> Load(std::string const& cache_path, std::string const& source_path,
+                                                 PointNormalSettings* normal_settings = nullptr)
+        {
+            if (normal_settings) *normal_settings = {};
+            std::uint64_t source_size;
+            std::int64_t source_time;
+            if (!SourceStamp(source_path, source_size, source_time)) return nullptr;
+
+            auto file = std::make_shared<MappedFile>();
+            if (!file->Open(cache_path.c_str(), true) || file->GetSize() < sizeof(Header)) return nullptr;
+            Header header;
+            std::memcpy(&header, file->GetData(), sizeof(header));
+            if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.source_size != source_size ||
+                header.source_time != source_time || header.attributes == 0 ||
+                file->GetSize() < sizeof(Header) + header.attributes * sizeof(Attribute))
+                return nullptr;
+            std::vector<Attribute> attributes(header.attributes);
+            std::memcpy(attributes.data(), file->GetData() + sizeof(Header), attributes.size() * sizeof(Attribute));
+            // the block has to fit in the file, checked by division so a corrupt count cannot overflow
+            for (auto const& attribute : attributes)
+                if (attribute.components == 0 || attribute.offset % sizeof(float) != 0 ||
+                    attribute.offset > file->GetSize() ||
+                    header.count > (file->GetSize() - attribute.offset) / (attribute.components * sizeof(float)))
+                    return nullptr;
+
+            auto polydata = vtkSmartPointer<vtkPolyData>::New();
+            auto const count = static_cast<vtkIdType>(header.count);
+            for (auto const& attribute : attributes)
+            {
+                auto const name = std::string(attribute.name, strnlen(attribute.name, sizeof(attribute.name)));
+                if (name == "points" && attribute.components == 3)
+                {
+                    vtkNew<vtkPoints> points;
+                    if (count > 0) points->SetData(WrapBlock(file, attribute.offset, count, 3));
+                    polydata->SetPoints(points);
+                }
+                else if (name == "normals" && attribute.components == 3 && count > 0 && normal_settings &&
+                         header.normal_settings.estimator != 0)
+                {
+                    auto normals = WrapBlock(file, attribute.offset, count, 3);
+                    normals->SetName("Normals");
+                    polydata->GetPointData()->SetNormals(normals);
+                }
+            }
+            if (!polydata->GetPoints()) return nullptr;
+            if (normal_settings && polydata->GetPointData()->GetNormals()) *normal_settings = header.normal_settings;
+            return polydata;
+        }
+
+    private:
+        static constexpr char magic[8]{'V', 'P', 'C', 'L', 'D', '0', '0', '2'}; // last digits: format version
+        static constexpr vtkIdType batch_size = 1 << 16;
+
+        struct Header
+        {
+            char magic[8];
+            std::uint64_t count;
+            double bounds[6];
+            std::uint32_t attributes;
+            std::uint32_t reserved;
+            std::uint64_t source_size;
+            std::int64_t source_time;
+            PointNormalSettings normal_settings; // estimator 0 without normals
+        };
+
+        struct Attribute
+        {
+            char name[16];
+            std::uint32_t components;
+            std::uint32_t reserved;
+            std::uint64_t offset; // bytes from the start of the file
+        };
+
+        // size and modification time of the text file, the cache is stale when either differs
+        static bool SourceStamp(std::string const& path, std::uint64_t& size, std::int64_t& time)
+        {
+            std::error_code ec;
+            size = std::filesystem::file_size(path, ec);
+            if (ec) return false;
+            time = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+            return !ec;
+        }
+
+        // mappings still referenced by loaded arrays, keyed by the first value of each array
+        static std::mutex& MappingsMutex()
+        {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        static std::map<void*, std::shared_ptr<MappedFile>>& Mappings()
+        {
+            static std::map<void*, std::shared_ptr<MappedFile>> mappings;
+            return mappings;
+        }
+
+        static void ReleaseMapping(void* values)
+        {
+            std::lock_guard<std::mutex> lock(MappingsMutex());
+            Mappings().erase(values);
+        }
+
+        static vtkSmartPointer<vtkFloatArray> WrapBlock(std::shared_ptr<MappedFile> const& file, std::uint64_t offset,
+                                                        vtkIdType count, int components)
+        {
+            auto* values = reinterpret_cast<float*>(file->GetWritableData() + offset);
+            {
+                std::lock_guard<std::mutex> lock(MappingsMutex());
+                Mappings()[values] = file;
+            }
+            auto array = vtkSmartPointer<vtkFloatArray>::New();
+            array->SetNumberOfComponents(components);
+            array->SetArray(values, count * components, 0, vtkFloatArray::VTK_DATA_ARRAY_USER_DEFINED);
+            array->SetArrayFreeFunction(ReleaseMapping);
+            return array;
+        }
+    };
+
+    std::string GetPointCloudCachePath(std::string const& path) { return path + ".pcloud"; }
+
+    // points of a .xyz text file, from its cache when it is up to date, otherwise parsed (ReadXYZPoints) and
+    // cached for the next run; nullptr when the file cannot be read.
+    // With normal_settings the cached normals come along, see PointCloudCache::Load
+    vtkSmartPointer<vtkPolyData> LoadPointCloud(const char* file_name, PointNormalSettings* normal_settings = nullptr)
+    {
+        auto const cache_path = GetPointCloudCachePath(file_name);
+        if (auto cached = PointCloudCache::Load(cache_path, file_name, normal_settings)) return cached;
+
+        auto points = ReadXYZPoints(file_name);
+        if (!points) return nullptr;
+        if (!PointCloudCache::Save(cache_path, file_name, points))
+            std::cerr << "Cannot write point cloud cache " << cache_path << std::endl;
+        auto polydata = vtkSmartPointer<vtkPolyData>::New();
+        polydata->SetPoints(points);
+        return polydata;
+    }
+} // namespace
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkPointData.h>
+#include <vtkFloatArray.h>
+#include <vtkIdList.h>
+#include <vtkMath.h>
+#include <vtkStaticPointLocator.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPThreadLocalObject.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // Everything the normals of an estimator depend on besides the points, stored next to cached normals
+    // (point_cache.h) so they are recomputed when any of it changes. Plain data without padding, compared bytewise.
+    struct PointNormalSettings
+    {
+        std::uint32_t estimator = 0; // 0: no normals
+        std::uint32_t version = 0;   // of the estimator, bumped whenever its output changes
+        std::int32_t sample_size = 0;
+        std::int32_t orientation = 0;
+        std::int32_t flip = 0;
+        std::uint32_t reserved = 0;
+        double view_point[3]{0, 0, 0};
+
+        bool operator==(PointNormalSettings const& other) const
+        {
+            return std::memcmp(this, &other, sizeof(PointNormalSettings)) == 0;
+        }
+
+        bool operator!=(PointNormalSettings const& other) const { return !(*this == other); }
+    };
+
+    // Point normals by PCA of the k nearest neighbours, a parallel stand-in for vtkPCANormalEstimation
+    // (same output: the input points with float normals named "PCANormals").
+    // One vtkStaticPointLocator is built (in parallel) and shared by every stage, and can be handed on to
+    // SparseSignedDistance::Execute; the k-NN queries and the PCA of every point run on the vtkSMPTools threads.
+    // Orientation:
+    //  - point: every normal faces a sensor / view point, independent per point
+    //  - graph traversal: consistent orientation propagated over the k-NN graph, like
+    //    vtkPCANormalEstimation::SetNormalOrientationToGraphTraversal, but level synchronous: every wave of the
+    //    traversal is processed in parallel, a neighbour is claimed atomically by the first point reaching it.
+    //    The traversal starts from the point with the largest x, y or z whose normal is closest to that axis and
+    //    turns it towards +axis, so the normals of a closed surface point out of it and those of an open height scan
+    //    point up; further connected components start outward from the centroid.
+    class PointNormalEstimation
+    {
+    public:
+        void SetSampleSize(int size) { m_sample_size = std::max(size, 3); }
+
+        void SetFlipNormals(bool flip) { m_flip = flip; }
+
+        void SetOrientationToPoint(double x, double y, double z)
+        {
+            m_orientation = Orientation::Point;
+            m_view_point[0] = x;
+            m_view_point[1] = y;
+            m_view_point[2] = z;
+        }
+
+        void SetOrientationToGraphTraversal() { m_orientation = Orientation::GraphTraversal; }
+
+        // the settings of the next Execute
+        PointNormalSettings GetSettings() const
+        {
+            PointNormalSettings settings;
+            settings.estimator = estimator_id;
+            settings.version = estimator_version;
+            settings.sample_size = m_sample_size;
+            settings.orientation = static_cast<std::int32_t>(m_orientation);
+            settings.flip = m_flip ? 1 : 0;
+            if (m_orientation == Orientation::Point) std::copy_n(m_view_point, 3, settings.view_point);
+            return settings;
+        }
+
+        // the locator of the last Execute, its data set is the output
+        vtkStaticPointLocator* GetLocator() const { return m_locator; }
+
+        vtkSmartPointer<vtkPolyData> Execute(vtkPolyData* input)
+        {
+            auto output = vtkSmartPointer<vtkPolyData>::New();
+            output->SetPoints(input->GetPoints());
+            auto const count = input->GetNumberOfPoints();
+            auto normals = vtkSmartPointer<vtkFloatArray>::New();
+            normals->SetName("PCANormals");
+            normals->SetNumberOfComponents(3);
+            normals->SetNumberOfTuples(count);
+            output->GetPointData()->SetNormals(normals);
+            if (count < 3) return output;
+
+            // built on the finished output, so a consumer sharing it does not rebuild it
+            m_locator = vtkSmartPointer<vtkStaticPointLocator>::New();
+            m_locator->SetDataSet(output);
+            m_locator->BuildLocator();
+
+            auto* n = normals->GetPointer(0);
+            EstimateNormals(output->GetPoints(), n);
+            if (m_orientation == Orientation::Point)
+                OrientToPoint(output->GetPoints(), n);
+            else
+                Traverse(output->GetPoints(), n);
+            if (m_flip)
+                vtkSMPTools::For(0, count * 3, [&](vtkIdType begin, vtkIdType end) {
+                    for (auto i = begin; i < end; i++)
+                        n[i] = -n[i];
+                });
+            return output;
+        }
+
+    private:
+        static constexpr std::uint32_t estimator_id = 1; // PCA of the k nearest neighbours
+        static constexpr std::uint32_t estimator_version = 1;
+
+        enum class Orientation
+        {
+            Point,
+            GraphTraversal
+        };
+
+        // normal = eigenvector of the smallest eigenvalue of the neighbourhood covariance
+        void EstimateNormals(vtkPoints* points, float* normals) const
+        {
+            vtkSMPThreadLocalObject<vtkIdList> neighbours;
+            vtkSMPTools::For(0, points->GetNumberOfPoints(), [&](vtkIdType begin, vtkIdType end) {
+                auto* ids = neighbours.Local();
+                double a0[3], a1[3], a2[3], v0[3], v1[3], v2[3], w[3];
+                double* a[3]{a0, a1, a2};
+                double* v[3]{v0, v1, v2};
+                for (auto i = begin; i < end; i++)
+                {
+                    double x[3];
+                    points->GetPoint(i, x);
+                    m_locator->FindClosestNPoints(m_sample_size, x, ids);
+                    auto const k = ids->GetNumberOfIds();
+                    double mean[3]{0, 0, 0};
+                    for (vtkIdType j = 0; j < k; j++)
+                    {
+                        double p[3];
+                        points->GetPoint(ids->GetId(j), p);
+                        for (int c = 0; c < 3; c++)
+                            mean[c] += p[c] / k;
+                    }
+                    for (int r = 0; r < 3; r++)
+                        std::fill_n(a[r], 3, 0.0);
+                    for (vtkIdType j = 0; j < k; j++)
+                    {
+                        double p[3];
+                        points->GetPoint(ids->GetId(j), p);
+                        for (int c = 0; c < 3; c++)
+                            p[c] -= mean[c];
+                        for (int r = 0; r < 3; r++)
+                            for (int c = 0; c < 3; c++)
+                                a[r][c] += p[r] * p[c] / k;
+                    }
+                    // eigenvectors in the columns, sorted by decreasing eigenvalue
+                    vtkMath::Jacobi(a, w, v);
+                    for (int c = 0; c < 3; c++)
+                        normals[i * 3 + c] = static_cast<float>(v[c][2]);
+                }
+            });
+        }
+
+        void OrientToPoint(vtkPoints* points, float* normals) const
+        {
+            vtkSMPTools::For(0, points->GetNumberOfPoints(), [&](vtkIdType begin, vtkIdType end) {
+                for (auto i = begin; i < end; i++)
+                {
+                    double x[3];
+                    points->GetPoint(i, x);
+                    auto* n = normals + i * 3;
+                    auto const facing = n[0] * (m_view_point[0] - x[0]) + n[1] * (m_view_point[1] - x[1]) +
+                                        n[2] * (m_view_point[2] - x[2]);
+                    if (facing < 0)
+                        for (int c = 0; c < 3; c++)
+                            n[c] = -n[c];
+                }
+            });
+        }
+
+        void Traverse(vtkPoints* points, float* normals) const
+        {
+            auto const count = points->GetNumberOfPoints();
+            std::unique_ptr<std::atomic<bool>[]> visited(new std::atomic<bool>[count]);
+            vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+                for (auto i = begin; i < end; i++)
+                    visited[i].store(false, std::memory_order_relaxed);
+            });
+            auto const flip = [&](vtkIdType id) {
+                for (int c = 0; c < 3; c++)
+                    normals[id * 3 + c] = -normals[id * 3 + c];
+            };
+
+            // first seed: of the points with the largest x, y and z, the one whose normal is closest to its axis;
+            // a surface's normal there points out of the bounding box, i.e. towards +axis
+            vtkIdType extreme[3]{0, 0, 0};
+            double centroid[3]{0, 0, 0};
+            {
+                double hi[3], x[3];
+                points->GetPoint(0, hi);
+                for (vtkIdType i = 0; i < count; i++)
+                {
+                    points->GetPoint(i, x);
+                    for (int c = 0; c < 3; c++)
+                    {
+                        centroid[c] += x[c] / count;
+                        if (x[c] > hi[c])
+                        {
+                            hi[c] = x[c];
+                            extreme[c] = i;
+                        }
+                    }
+                }
+            }
+            int axis = 0;
+            for (int c = 1; c < 3; c++)
+                if (std::abs(normals[extreme[c] * 3 + c]) > std::abs(normals[extreme[axis] * 3 + axis]))
+                    axis = c;
+            auto seed = extreme[axis];
+            if (normals[seed * 3 + axis] < 0) flip(seed);
+
+            vtkSMPThreadLocalObject<vtkIdList> neighbours;
+            vtkSMPThreadLocal<std::vector<vtkIdType>> reached;
+            std::vector<vtkIdType> wave, next;
+            vtkIdType cursor = 0;
+            while (true)
+            {
+                visited[seed] = true;
+                wave.assign(1, seed);
+                while (!wave.empty())
+                {
+                    vtkSMPTools::For(0, static_cast<vtkIdType>(wave.size()), [&](vtkIdType begin, vtkIdType end) {
+                        auto* ids = neighbours.Local();
+                        auto& found = reached.Local();
+                        for (auto w = begin; w < end; w++)
+                        {
+                            auto const from = wave[w];
+                            double x[3];
+                            points->GetPoint(from, x);
+                            m_locator->FindClosestNPoints(m_sample_size, x, ids);
+                            auto const* n = normals + from * 3;
+                            for (vtkIdType j = 0; j < ids->GetNumberOfIds(); j++)
+                            {
+                                auto const id = ids->GetId(j);
+                                bool expected = false;
+                                if (!visited[id].compare_exchange_strong(expected, true)) continue;
+                                auto const* m = normals + id * 3;
+                                if (n[0] * m[0] + n[1] * m[1] + n[2] * m[2] < 0) flip(id);
+                                found.push_back(id);
+                            }
+                        }
+                    });
+                    next.clear();
+                    for (auto& found : reached)
+                    {
+                        next.insert(next.end(), found.begin(), found.end());
+                        found.clear();
+                    }
+                    wave.swap(next);
+                }
+
+                // next connected component, outward from the centroid
+                while (cursor < count && visited[cursor])
+                    cursor++;
+                if (cursor == count) break;
+                seed = cursor;
+                double x[3];
+                points->GetPoint(seed, x);
+                auto const* n = normals + seed * 3;
+                if (n[0] * (x[0] - centroid[0]) + n[1] * (x[1] - centroid[1]) + n[2] * (x[2] - centroid[2]) < 0)
+                    flip(seed);
+            }
+        }
+
+    private:
+        int m_sample_size = 10;
+        bool m_flip = false;
+        Orientation m_orientation = Orientation::GraphTraversal;
+        double m_view_point[3]{0, 0, 0};
+        vtkSmartPointer<vtkStaticPointLocator> m_locator;
+    };
+} // namespace
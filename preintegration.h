@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkColorTransferFunction.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    // Pre-integrated transfer function: the color and opacity of a whole ray segment of length step, indexed by
+    // the scalar at its front and at its back (bins over the scalar range), with the scalar assumed to vary
+    // linearly in between. A narrow opacity peak crossed between two samples still contributes, so large sample
+    // distances do not band like the per sample lookup does.
+    // Every entry is integrated numerically (one sub-step per bin crossed), the rows are computed in parallel.
+    // Build only redoes the entries whose scalar interval overlaps the bins that changed since the last build,
+    // and nothing when the transfer functions did not change.
+    class PreIntegratedTable
+    {
+    public:
+        explicit PreIntegratedTable(int bins = 256) : m_bins(std::max(bins, 2)) {}
+
+        int GetNumberOfBins() const { return m_bins; }
+
+        // returns the number of entries recomputed
+        size_t Build(vtkColorTransferFunction* color, vtkPiecewiseFunction* opacity, double const range[2],
+                     double step)
+        {
+            auto const n = m_bins;
+            std::vector<double> rgb(n * 3, 1.0), alpha(n, 1.0);
+            if (color) color->GetTable(range[0], range[1], n, rgb.data());
+            if (opacity) opacity->GetTable(range[0], range[1], n, alpha.data());
+            for (auto& a : alpha)
+                a = std::clamp(a, 0.0, 1.0);
+
+            // bins [lo, hi] changed, everything when the step or the range changed
+            int lo = 0, hi = n - 1;
+            if (!m_table.empty() && step == m_step && range[0] == m_range[0] && range[1] == m_range[1])
+            {
+                lo = n;
+                hi = -1;
+                for (int i = 0; i < n; i++)
+                    if (alpha[i] != m_alpha[i] || rgb[i * 3] != m_rgb[i * 3] || rgb[i * 3 + 1] != m_rgb[i * 3 + 1] ||
+                        rgb[i * 3 + 2] != m_rgb[i * 3 + 2])
+                    {
+                        lo = std::min(lo, i);
+                        hi = std::max(hi, i);
+                    }
+                if (hi < 0) return 0;
+            }
+            m_rgb = std::move(rgb);
+            m_alpha = std::move(alpha);
+            m_step = step;
+            m_range[0] = range[0];
+            m_range[1] = range[1];
+            m_table.resize(static_cast<size_t>(n) * n * 4);
+
+            // opacity of one sub-step per bin for every segment length in bins (row 0 unused), keeps pow out of the
+            // integration
+            m_sub_alpha.resize(static_cast<size_t>(n) * n);
+            vtkSMPTools::For(1, n, [&](vtkIdType begin, vtkIdType end) {
+                for (auto steps = begin; steps < end; steps++)
+                    for (int i = 0; i < n; i++)
+                        m_sub_alpha[steps * n + i] = 1 - std::pow(1 - m_alpha[i], m_step / steps);
+            });
+
+            std::vector<size_t> counts(n, 0);
+            vtkSMPTools::For(0, n, [&](vtkIdType begin, vtkIdType end) {
+                for (auto f = static_cast<int>(begin); f < end; f++)
+                    for (int b = 0; b < n; b++)
+                    {
+                        // the segment covers the bins between f and b
+                        if (std::max(f, b) < lo || std::min(f, b) > hi) continue;
+                        Integrate(f, b, &m_table[(static_cast<size_t>(f) * n + b) * 4]);
+                        counts[f]++;
+                    }
+            });
+            size_t count = 0;
+            for (auto c : counts)
+                count += c;
+            return count;
+        }
+
+        int Bin(double value) const
+        {
+            return std::clamp(static_cast<int>((value - m_range[0]) / (m_range[1] - m_range[0]) * (m_bins - 1) + 0.5),
+                              0, m_bins - 1);
+        }
+
+        // opacity weighted rgb and opacity of the segment from front to back
+        float const* Lookup(int front, int back) const
+        {
+            return &m_table[(static_cast<size_t>(front) * m_bins + back) * 4];
+        }
+
+    private:
+        void Integrate(int front, int back, float* rgba) const
+        {
+            // the transfer function opacity is per unit distance (scalar opacity unit distance of 1)
+            auto const steps = std::max(std::abs(back - front), 1);
+            auto const* sub_alpha = &m_sub_alpha[static_cast<size_t>(steps) * m_bins];
+            double color[3]{0, 0, 0};
+            auto alpha = 0.0;
+            for (int s = 0; s < steps; s++)
+            {
+                // scalar in the middle of the sub-step, linear from front to back
+                auto const t = (s + 0.5) / steps;
+                auto const bin = std::clamp(static_cast<int>(front + t * (back - front) + 0.5), 0, m_bins - 1);
+                auto const a = sub_alpha[bin];
+                auto const w = (1 - alpha) * a;
+                for (int i = 0; i < 3; i++)
+                    color[i] += w * m_rgb[bin * 3 + i];
+                alpha += w;
+            }
+            for (int i = 0; i < 3; i++)
+                rgba[i] = static_cast<float>(color[i]);
+            rgba[3] = static_cast<float>(alpha);
+        }
+
+    private:
+        int m_bins;
+        double m_step = 0;
+        double m_range[2]{0, 1};
+        std::vector<double> m_rgb;
+        std::vector<double> m_alpha;
+        std::vector<double> m_sub_alpha; // segment length in bins x bins
+        std::vector<float> m_table;      // bins x bins rgba, front major
+    };
+} // namespace
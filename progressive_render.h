@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkWeakPointer.h>
+#include <vtkObjectFactory.h>
+#include <vtkCommand.h>
+#include <vtkVolume.h>
+#include <vtkFixedPointVolumeRayCastMapper.h>
+#include <vtkGPUVolumeRayCastMapper.h>
+#include <vtkSmartVolumeMapper.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkInteractorObserver.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Progressive refinement for the fixed sample distances set up by GetVolume.
+    // While the interactor style is interacting the mapper renders at the coarsest level (image and sample
+    // distances scaled by 2^levels). Once the interaction ends and the interactor stayed idle for idle_ms, one
+    // refinement pass per timer halves both distances until the requested full quality frame is rendered.
+    // Only a new interaction (StartInteractionEvent: button press, wheel, key) cancels the passes still pending, so
+    // hovering the mouse over the view does not stop the refinement; a pass already rendering is finished, so the
+    // user waits at most for one pass.
+    class MProgressiveRefinement: public vtkCommand
+    {
+    public:
+        static MProgressiveRefinement* New();
+        vtkTypeMacro(MProgressiveRefinement, vtkCommand);
+
+        void Setup(vtkVolume* volume, vtkRenderWindowInteractor* interactor, float sample_distance,
+                   float img_sample_distance, int levels = 3, unsigned long idle_ms = 150)
+        {
+            m_volume = volume;
+            m_interactor = interactor;
+            m_sample_distance = sample_distance;
+            m_img_sample_distance = img_sample_distance;
+            m_levels = std::max(levels, 1);
+            m_idle_ms = idle_ms;
+
+            auto* style = interactor->GetInteractorStyle();
+            style->AddObserver(vtkCommand::StartInteractionEvent, this);
+            style->AddObserver(vtkCommand::EndInteractionEvent, this);
+            interactor->AddObserver(vtkCommand::TimerEvent, this);
+            ApplyLevel(0);
+        }
+
+        void Execute(vtkObject*, unsigned long eventId, void* callData) override
+        {
+            switch (eventId)
+            {
+            case vtkCommand::StartInteractionEvent:
+                Cancel();
+                ApplyLevel(m_levels);
+                break;
+            case vtkCommand::EndInteractionEvent:
+                Schedule();
+                break;
+            case vtkCommand::TimerEvent:
+                if (callData && *static_cast<int*>(callData) == m_timer)
+                {
+                    m_timer = -1;
+                    Refine();
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+    private:
+        void Schedule()
+        {
+            if (m_level == 0 || m_timer >= 0) return;
+            m_timer = m_interactor->CreateOneShotTimer(m_idle_ms);
+        }
+
+        void Cancel()
+        {
+            if (m_timer >= 0) m_interactor->DestroyTimer(m_timer);
+            m_timer = -1;
+        }
+
+        void Refine()
+        {
+            if (m_level == 0 || !m_volume) return;
+            ApplyLevel(m_level - 1);
+            m_interactor->Render();
+            Schedule();
+        }
+
+        void ApplyLevel(int level)
+        {
+            m_level = std::clamp(level, 0, m_levels);
+            if (!m_volume) return;
+            auto const factor = static_cast<float>(1 << m_level);
+            auto const sample_distance = m_sample_distance * factor;
+            auto const img_sample_distance = std::min(m_img_sample_distance * factor, 16.0f);
+            auto* mapper = m_volume->GetMapper();
+            if (auto* fixed = vtkFixedPointVolumeRayCastMapper::SafeDownCast(mapper))
+            {
+                fixed->SetSampleDistance(sample_distance);
+                fixed->SetImageSampleDistance(img_sample_distance);
+            }
+            else if (auto* gpu = vtkGPUVolumeRayCastMapper::SafeDownCast(mapper))
+            {
+                gpu->SetSampleDistance(sample_distance);
+                gpu->SetImageSampleDistance(img_sample_distance);
+            }
+            else if (auto* smart = vtkSmartVolumeMapper::SafeDownCast(mapper))
+                smart->SetSampleDistance(sample_distance);
+        }
+
+    private:
+        vtkWeakPointer<vtkVolume> m_volume;
+        vtkWeakPointer<vtkRenderWindowInteractor> m_interactor;
+        float m_sample_distance = 1.0f;
+        float m_img_sample_distance = 1.0f;
+        int m_levels = 3;
+        int m_level = 0;
+        unsigned long m_idle_ms = 150;
+        int m_timer = -1;
+    };
+    vtkStandardNewMacro(MProgressiveRefinement);
+
+    // coarse while interacting, refined on idle, for a volume built by GetVolume or ray_cast_mip's progressive engine
+    vtkSmartPointer<MProgressiveRefinement> SetupProgressiveRefinement(vtkVolume* volume,
+                                                                       vtkRenderWindowInteractor* interactor,
+                                                                       float sample_distance,
+                                                                       float img_sample_distance, int levels = 3)
+    {
+        auto refinement = vtkSmartPointer<MProgressiveRefinement>::New();
+        refinement->Setup(volume, interactor, sample_distance, img_sample_distance, levels);
+        return refinement;
+    }
+} // namespace
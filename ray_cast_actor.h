@@ -13,9 +13,7 @@
 #include <vtkVolumeProperty.h>
 #include <vtkContourValues.h>
 
-#include <vtkPolyDataToImageStencil.h>
 #include <vtkImageData.h>
-#include <vtkImageStencil.h>
 #include <vtkPointData.h>
 
 #include <vtkActor2D.h>
@@ -33,8 +31,14 @@
 
 #include <vtksys/SystemTools.hxx>
 
+#include <algorithm>
 #include <sstream>
 
+#include "progressive_render.h"
+#include "volume_lod.h"
+#include "adaptive_sampling.h"
+#include "mesh_voxelizer.h"
+
 namespace
 {
     // Require STL mesh data, need adjust spacing and sample distance for good volume rendering
@@ -42,51 +46,40 @@ namespace
     vtkSmartPointer<vtkImageData> ConvertMeshPolyDataToImageData(vtkSmartPointer<vtkPolyData> polyData,
                                                                  double const spacing[3]) // desired volume spacing
     {
-        vtkNew<vtkImageData> whiteImage;
-        double bounds[6];
-        polyData->GetBounds(bounds);
-        whiteImage->SetSpacing(spacing);
+        // foreground voxels are 255, background 0, written once per voxel by the parallel scanline voxelizer
+        // instead of fill + vtkPolyDataToImageStencil + vtkImageStencil + DeepCopy
+        MeshVoxelizer voxelizer;
+        if (!voxelizer.SetInputData(polyData, spacing)) return nullptr;
+        return voxelizer.Voxelize();
+    }
 
-        // compute dimensions
-        int dim[3];
+    // sparse version for fine spacing over large meshes: only the bricks crossing the surface keep their voxels
+    bool ConvertMeshPolyDataToSparseVolume(vtkSmartPointer<vtkPolyData> polyData, double const spacing[3],
+                                           SparseVolume& sparse, int brick_size = 16)
+    {
+        MeshVoxelizer voxelizer;
+        if (!voxelizer.SetInputData(polyData, spacing)) return false;
+        voxelizer.VoxelizeSparse(sparse, brick_size);
+        return true;
+    }
+
+    // dense copy of a sparse volume for the mappers: the region of interest (voxel extent, whole volume when null),
+    // subsampled as needed to stay within max_voxels
+    vtkSmartPointer<vtkImageData> ConvertSparseVolumeToImageData(SparseVolume const& sparse, int const roi[6] = nullptr,
+                                                                 double max_voxels = 512.0 * 512 * 512)
+    {
+        auto const* dims = sparse.GetDimensions();
+        double voxels = 1;
         for (int i = 0; i < 3; i++)
-            dim[i] = static_cast<int>(ceil((bounds[i * 2 + 1] - bounds[i * 2]) / spacing[i]));
-        whiteImage->SetDimensions(dim);
-        whiteImage->SetExtent(0, dim[0] - 1, 0, dim[1] - 1, 0, dim[2] - 1);
-
-        double origin[3];
-        origin[0] = bounds[0] + spacing[0] / 2;
-        origin[1] = bounds[2] + spacing[1] / 2;
-        origin[2] = bounds[4] + spacing[2] / 2;
-        whiteImage->SetOrigin(origin);
-        whiteImage->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
-
-        // fill the image with foreground voxels:
-        unsigned char inval = 255;
-        unsigned char outval = 0;
-        vtkIdType count = whiteImage->GetNumberOfPoints();
-        for (vtkIdType i = 0; i < count; ++i)
-            whiteImage->GetPointData()->GetScalars()->SetTuple1(i, inval);
-
-        // polygonal data --> image stencil:
-        vtkNew<vtkPolyDataToImageStencil> pol2stenc;
-        pol2stenc->SetInputData(polyData);
-        pol2stenc->SetOutputOrigin(origin);
-        pol2stenc->SetOutputSpacing(spacing);
-        pol2stenc->SetOutputWholeExtent(whiteImage->GetExtent());
-        pol2stenc->Update();
-
-        // cut the corresponding white image and set the background:
-        vtkNew<vtkImageStencil> imgstenc;
-        imgstenc->SetInputData(whiteImage);
-        imgstenc->SetStencilConnection(pol2stenc->GetOutputPort());
-        imgstenc->ReverseStencilOff();
-        imgstenc->SetBackgroundValue(outval);
-        imgstenc->Update();
-
-        whiteImage->DeepCopy(imgstenc->GetOutput());
-
-        return whiteImage;
+        {
+            auto const lo = roi ? std::clamp(roi[i * 2], 0, dims[i] - 1) : 0;
+            auto const hi = roi ? std::clamp(roi[i * 2 + 1], lo, dims[i] - 1) : dims[i] - 1;
+            voxels *= hi - lo + 1;
+        }
+        int stride = 1;
+        while (voxels / (static_cast<double>(stride) * stride * stride) > max_voxels)
+            stride++;
+        return sparse.ToDense(roi, stride);
     }
 
     enum class VolumeType
@@ -96,6 +89,10 @@ namespace
         SmartVolume
     };
 
+    // sample_distance and img_sample_distance are the full quality settings, call SetupProgressiveRefinement
+    // (progressive_render.h) with the same values to render coarse while interacting and refine on idle, or
+    // SetupVolumeLOD (volume_lod.h) to render a downsampled copy of the volume while interacting, or
+    // SetupSampleDistanceController (adaptive_sampling.h) to hold a frame time while interacting
     vtkSmartPointer<vtkVolume> GetVolume(vtkSmartPointer<vtkImageData> imgData, VolumeType type, float sample_distance,
                                          float img_sample_distance, double iso1, double iso2, double color1[3],
                                          double color2[3])
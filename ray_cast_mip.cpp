@@ -12,21 +12,227 @@
 #include <vtkRenderer.h>
 #include <vtkVolume.h>
 #include <vtkVolumeProperty.h>
+#include <vtkFixedPointVolumeRayCastMapper.h>
+#include <vtkPNGWriter.h>
+#include <vtkWindowToImageFilter.h>
+#include <vtkMath.h>
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "load_dicom.h"
 #include "load_3d.h"
 #include "ray_cast_actor.h"
+#include "cpu_mip.h"
+#include "empty_space.h"
+#include "compressed_volume.h"
+#include "gradient_cache.h"
+#include "adaptive_sampling.h"
+#include "progressive_render.h"
+
+// headless engines render this many views around the volume into PNGs
+constexpr int headless_views = 12;
+constexpr int headless_width = 800;
+constexpr int headless_height = 600;
+// the pre-integrated cpu compositing keeps its quality at this multiple of the mip sample distance
+constexpr double preintegrated_step_scale = 3;
+
+void WritePNG(vtkImageData* img, std::string const& file_name)
+{
+    vtkNew<vtkPNGWriter> writer;
+    writer->SetFileName(file_name.c_str());
+    writer->SetInputData(img);
+    writer->Write();
+}
+
+// mean absolute difference of two RGB frames of the same size, in 8 bit levels
+double FrameDifference(vtkImageData* a, vtkImageData* b)
+{
+    auto const* pa = static_cast<unsigned char const*>(a->GetScalarPointer());
+    auto const* pb = static_cast<unsigned char const*>(b->GetScalarPointer());
+    auto const count = a->GetNumberOfPoints() * 3;
+    double sum = 0;
+    for (vtkIdType i = 0; i < count; i++)
+        sum += std::abs(pa[i] - pb[i]);
+    return count > 0 ? sum / count : 0.0;
+}
+
+// render the orbit with the cpu mip engine and/or vtkFixedPointVolumeRayCastMapper (offscreen), report ms per frame
+// with gradients the cpu engine composites with shading instead of the mip, with a compressed copy it samples that
+// clip_planes > 0 cuts a convex cutaway out of both: planes tangent to a sphere around the center, set on the volume
+// mapper (SetClipPlane) and handed from it to the cpu engine; with both engines the frames are compared
+void RenderHeadless(vtkImageData* imgdata, vtkColorTransferFunction* color, vtkPiecewiseFunction* opacity,
+                    double const background[3], bool use_cpu, bool use_fixed,
+                    std::shared_ptr<GradientVolume const> gradients = nullptr,
+                    std::shared_ptr<CompressedVolume const> compressed = nullptr, int clip_planes = 0)
+{
+    vtkNew<vtkRenderer> renderer;
+    renderer->SetBackground(background[0], background[1], background[2]);
+    renderer->ResetCamera(imgdata->GetBounds());
+    auto* camera = renderer->GetActiveCamera();
+    camera->Elevation(20);
+    camera->OrthogonalizeViewUp();
+
+    // same sampling for both engines
+    auto const* spacing = imgdata->GetSpacing();
+    auto const sample_distance = std::min({spacing[0], spacing[1], spacing[2]});
+
+    vtkNew<vtkFixedPointVolumeRayCastMapper> mapper;
+    vtkNew<vtkVolume> volume;
+    volume->SetMapper(mapper);
+    // evenly spread normals (golden angle spiral), pointing inward so the inside of the sphere stays visible
+    double center[3];
+    imgdata->GetCenter(center);
+    auto const radius = imgdata->GetLength() * 0.3;
+    for (int i = 0; i < clip_planes; i++)
+    {
+        auto const z = 1 - 2 * (i + 0.5) / clip_planes, r = std::sqrt(1 - z * z);
+        auto const phi = i * vtkMath::Pi() * (3 - std::sqrt(5.0));
+        double normal[3]{-r * std::cos(phi), -r * std::sin(phi), -z};
+        double origin[3];
+        for (int k = 0; k < 3; k++)
+            origin[k] = center[k] - radius * normal[k];
+        SetClipPlane(volume, origin, normal);
+    }
+
+    std::vector<vtkSmartPointer<vtkImageData>> cpu_frames;
+    double cpu_ms = 0;
+    if (use_cpu)
+    {
+        CpuMipRenderer mip;
+        if (compressed)
+            mip.SetInputData(compressed);
+        else
+            mip.SetInputData(imgdata);
+        mip.SetSampleDistance(sample_distance);
+        mip.SetColor(color);
+        mip.SetScalarOpacity(opacity);
+        mip.SetBackground(background[0], background[1], background[2]);
+        mip.SetClippingPlanes(mapper->GetClippingPlanes());
+        if (gradients)
+        {
+            mip.SetBlendModeToComposite();
+            mip.SetShading(true);
+            mip.SetGradients(gradients);
+            mip.SetPreIntegration(true);
+            mip.SetSampleDistance(sample_distance * preintegrated_step_scale);
+        }
+        std::string const name = std::string(gradients ? "composite" : "mip") + (compressed ? "_compressed" : "");
+        for (int i = 0; i < headless_views; i++)
+        {
+            auto const start = std::chrono::steady_clock::now();
+            auto frame = mip.Render(camera, headless_width, headless_height);
+            cpu_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            WritePNG(frame, name + "_cpu_" + std::to_string(i) + ".png");
+            if (use_fixed) cpu_frames.push_back(frame);
+            camera->Azimuth(360.0 / headless_views);
+        }
+        cpu_ms /= headless_views;
+        std::cout << "cpu " << name << ": " << cpu_ms << " ms/frame" << std::endl;
+        if (compressed) std::cout << "brick cache hit rate: " << mip.GetCacheHitRate() * 100 << "%" << std::endl;
+    }
+
+    double fixed_ms = 0;
+    double difference = 0;
+    if (use_fixed)
+    {
+        mapper->SetInputData(imgdata);
+        mapper->SetBlendModeToMaximumIntensity();
+        mapper->AutoAdjustSampleDistancesOff();
+        mapper->SetSampleDistance(sample_distance);
+        mapper->SetImageSampleDistance(1);
+
+        vtkNew<vtkVolumeProperty> volumeProperty;
+        volumeProperty->SetInterpolationTypeToLinear();
+        volumeProperty->SetColor(color);
+        volumeProperty->SetScalarOpacity(opacity);
+
+        volume->SetProperty(volumeProperty);
+        renderer->AddVolume(volume);
+        // crop the rays to the bricks the opacity leaves visible
+        vtkNew<MEmptySpaceSkipping> skipping;
+        skipping->Setup(mapper, imgdata, opacity);
+
+        vtkNew<vtkRenderWindow> renderWindow;
+        renderWindow->SetOffScreenRendering(1);
+        renderWindow->SetSize(headless_width, headless_height);
+        renderWindow->AddRenderer(renderer);
+        renderWindow->Render(); // first render builds the mapper's internal tables, keep it out of the timing
+
+        vtkNew<vtkWindowToImageFilter> windowToImageFilter;
+        windowToImageFilter->SetInput(renderWindow);
+        for (int i = 0; i < headless_views; i++)
+        {
+            auto const start = std::chrono::steady_clock::now();
+            renderWindow->Render();
+            fixed_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            windowToImageFilter->Modified();
+            windowToImageFilter->Update();
+            WritePNG(windowToImageFilter->GetOutput(), "mip_fixed_" + std::to_string(i) + ".png");
+            if (i < static_cast<int>(cpu_frames.size()))
+                difference += FrameDifference(cpu_frames[i], windowToImageFilter->GetOutput());
+            camera->Azimuth(360.0 / headless_views);
+        }
+        fixed_ms /= headless_views;
+        std::cout << "vtkFixedPointVolumeRayCastMapper mip: " << fixed_ms << " ms/frame" << std::endl;
+    }
+
+    if (use_cpu && use_fixed)
+    {
+        std::cout << "speedup: " << fixed_ms / cpu_ms << "x" << std::endl;
+        std::cout << "mean difference to vtkFixedPointVolumeRayCastMapper: " << difference / headless_views
+                  << " levels per channel (" << clip_planes << " clipping planes)" << std::endl;
+    }
+}
+
+void PrintUsage(char const* name)
+{
+    std::cout << "Usage: " << name << " filepath [is_poly=false] [engine=gpu] [clip_planes=0]" << std::endl;
+    std::cout << "e.g. dicom" << std::endl;
+    std::cout << "engine: gpu (interactive), cpu (headless cpu mip to png), fixed (headless "
+                 "vtkFixedPointVolumeRayCastMapper to png), bench (cpu and fixed, timed), "
+                 "composite (headless shaded cpu compositing to png, gradients cached in filepath.vgrad), "
+                 "compressed (headless cpu mip from a block compressed copy of the volume), progressive "
+                 "(interactive vtkFixedPointVolumeRayCastMapper for GPU-less nodes, coarse while rotating and "
+                 "refined on idle)"
+              << std::endl;
+    std::cout << "clip_planes: headless engines cut a cutaway of that many planes out of the volume" << std::endl;
+}
 
 int main(int argc, char* argv[])
 {
     if (argc < 2)
     {
-        std::cout << "Usage: " << argv[0] << " filepath [is_poly=false]" << std::endl;
-        std::cout << "e.g. dicom" << std::endl;
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::string const engine = argc > 3 ? argv[3] : "gpu";
+    if (engine != "gpu" && engine != "cpu" && engine != "fixed" && engine != "bench" && engine != "composite" &&
+        engine != "compressed" && engine != "progressive")
+    {
+        std::cerr << "Unknown engine " << engine << std::endl;
+        PrintUsage(argv[0]);
         return EXIT_FAILURE;
     }
+    int clip_planes = 0;
+    if (argc > 4)
+    {
+        auto const* end = argv[4] + std::strlen(argv[4]);
+        auto const [last, error] = std::from_chars(argv[4], end, clip_planes);
+        if (error != std::errc() || last != end || clip_planes < 0)
+        {
+            std::cerr << "Invalid clip_planes " << argv[4] << ", expected a non-negative integer" << std::endl;
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
 
     bool is_poly = false;
     vtkSmartPointer<vtkImageData> imgdata = nullptr;
@@ -34,7 +240,15 @@ int main(int argc, char* argv[])
     {
         auto polydata = ReadPolyData(argv[1]);
         double spacing[]{1, 1, 1};
-        imgdata = ConvertMeshPolyDataToImageData(polydata, spacing);
+        // voxelize only the bricks crossing the surface, the dense copy given to the mappers is subsampled past
+        // 512^3 voxels instead of allocating the whole grid at the mesh spacing
+        SparseVolume sparse;
+        if (ConvertMeshPolyDataToSparseVolume(polydata, spacing, sparse))
+        {
+            std::cout << "voxelized: " << sparse.GetMemorySize() / (1024.0 * 1024.0) << " MB sparse, "
+                      << sparse.GetDenseMemorySize() / (1024.0 * 1024.0) << " MB dense" << std::endl;
+            imgdata = ConvertSparseVolumeToImageData(sparse);
+        }
         is_poly = true;
     }
     else
@@ -44,14 +258,6 @@ int main(int argc, char* argv[])
 
     vtkNew<vtkNamedColors> colors;
 
-    vtkNew<vtkOpenGLGPUVolumeRayCastMapper> mapper;
-    mapper->SetInputData(imgdata);
-    mapper->Update();
-    // mapper->AutoAdjustSampleDistancesOff();
-    // mapper->SetSampleDistance(0.5);
-    mapper->AutoAdjustSampleDistancesOn();
-    mapper->SetBlendModeToMaximumIntensity();
-
     vtkNew<vtkColorTransferFunction> colorTransferFunction;
     colorTransferFunction->RemoveAllPoints();
     if (is_poly)
@@ -79,6 +285,81 @@ int main(int argc, char* argv[])
         scalarOpacity->AddPoint(3071, .71, 0.5, 0.0);
     }
 
+    if (engine == "composite")
+    {
+        auto const start = std::chrono::steady_clock::now();
+        auto gradients = GetGradientVolume(imgdata, GetGradientCachePath(argv[1]));
+        if (!gradients)
+        {
+            std::cerr << "gradients need a single component volume" << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "gradients: " << gradients->GetMemorySize() / (1024.0 * 1024.0) << " MB (16 bit normal + 8 bit "
+                  << "magnitude per voxel), ready in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms" << std::endl;
+        RenderHeadless(imgdata, colorTransferFunction, scalarOpacity, colors->GetColor3d("cornflower").GetData(), true,
+                       false, gradients, nullptr, clip_planes);
+        return EXIT_SUCCESS;
+    }
+
+    if (engine == "compressed")
+    {
+        auto const start = std::chrono::steady_clock::now();
+        auto compressed = std::make_shared<CompressedVolume>();
+        // lossless for the integer CT/MR scalars, 8 bit per brick otherwise
+        if (!compressed->SetInputData(imgdata) &&
+            !compressed->SetInputData(imgdata, CompressedVolume::Mode::Quantized8))
+        {
+            std::cerr << "compression needs a single component volume" << std::endl;
+            return EXIT_FAILURE;
+        }
+        auto const dense = compressed->GetDenseMemorySize(imgdata->GetScalarSize());
+        std::cout << "compressed: " << dense / (1024.0 * 1024.0) << " MB -> "
+                  << compressed->GetMemorySize() / (1024.0 * 1024.0) << " MB ("
+                  << static_cast<double>(dense) / compressed->GetMemorySize() << "x) in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+                  << " ms" << std::endl;
+        // only the compressed copy stays resident, the camera setup just needs the geometry of the volume
+        auto geometry = vtkSmartPointer<vtkImageData>::New();
+        geometry->CopyStructure(imgdata);
+        imgdata = geometry;
+        RenderHeadless(imgdata, colorTransferFunction, scalarOpacity, colors->GetColor3d("cornflower").GetData(), true,
+                       false, nullptr, compressed, clip_planes);
+        return EXIT_SUCCESS;
+    }
+
+    if (engine != "gpu" && engine != "progressive")
+    {
+        RenderHeadless(imgdata, colorTransferFunction, scalarOpacity, colors->GetColor3d("cornflower").GetData(),
+                       engine == "cpu" || engine == "bench", engine == "fixed" || engine == "bench", nullptr, nullptr,
+                       clip_planes);
+        return EXIT_SUCCESS;
+    }
+
+    // full quality sampling, the sample distance controller (gpu) or the progressive refinement below coarsens it
+    // while rotating
+    auto const* spacing = imgdata->GetSpacing();
+    auto const sample_distance = static_cast<float>(std::min({spacing[0], spacing[1], spacing[2]}) / 2);
+    vtkSmartPointer<vtkVolumeMapper> mapper;
+    if (engine == "progressive")
+    {
+        auto fixed = vtkSmartPointer<vtkFixedPointVolumeRayCastMapper>::New();
+        fixed->AutoAdjustSampleDistancesOff();
+        fixed->SetSampleDistance(sample_distance);
+        fixed->SetImageSampleDistance(1);
+        mapper = fixed;
+    }
+    else
+    {
+        auto gpu = vtkSmartPointer<vtkOpenGLGPUVolumeRayCastMapper>::New();
+        gpu->SetSampleDistance(sample_distance);
+        mapper = gpu;
+    }
+    mapper->SetInputData(imgdata);
+    mapper->Update();
+    mapper->SetBlendModeToMaximumIntensity();
+
     vtkNew<vtkVolumeProperty> volumeProperty;
     volumeProperty->SetInterpolationTypeToLinear();
     volumeProperty->SetColor(colorTransferFunction);
@@ -107,6 +388,22 @@ int main(int argc, char* argv[])
     renderer->ResetCamera();
     renderer->ResetCameraClippingRange();
 
+    // gpu: hold 20 fps while interacting, whatever the volume size
+    // progressive: 8x coarser while rotating, then refined in 3 idle passes up to the full quality frame
+    vtkSmartPointer<MSampleDistanceController> controller;
+    vtkSmartPointer<MProgressiveRefinement> refinement;
+    vtkNew<MEmptySpaceSkipping> skipping;
+    if (engine == "progressive")
+    {
+        refinement = SetupProgressiveRefinement(volume, interactor, sample_distance, 1.0f);
+        // crop the rays to the bricks the opacity leaves visible, follows opacity changes
+        skipping->Setup(mapper, imgdata, scalarOpacity);
+    }
+    else
+    {
+        controller = SetupSampleDistanceController(volume, renderer, interactor, 1.0 / 20);
+    }
+
     renderWindow->Render();
 
     interactor->Start();
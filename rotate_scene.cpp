@@ -29,6 +29,8 @@
 #include <fstream>
 #include <string>
 
+#include "mesh_lod.h"
+
 //#define PRINT_CAMERA_INFO
 
 vtkSmartPointer<vtkPolyData> ReadPolyData(const char* fileName)
@@ -297,6 +299,9 @@ int main(int argc, char* argv[])
     vtkNew<mInteractorStyle> style;
     style->set_actor(m_obj_actor);
     interactor->SetInteractorStyle(style);
+    // decimated levels are built in the background, drawn while rotating large models; both views draw the same
+    // actor, so a frame takes about twice the time of the one renderer measured
+    auto lod = SetupMeshLOD(m_obj_actor, m_renderer, interactor, 1.0 / 30);
 
     vtkNew<vtkRenderWindow> m_render_window;
     m_render_window->SetSize(1000, 500);
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkMatrix3x3.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    enum class SlabMode
+    {
+        Off,
+        MIP,   // maximum intensity projection
+        MinIP, // minimum intensity projection
+        Mean   // average intensity projection
+    };
+
+    inline char const* SlabModeName(SlabMode mode)
+    {
+        switch (mode)
+        {
+        case SlabMode::MIP:
+            return "MIP";
+        case SlabMode::MinIP:
+            return "MinIP";
+        case SlabMode::Mean:
+            return "Mean";
+        default:
+            return "Off";
+        }
+    }
+
+    // Thick slab projection that follows the displayed slice.
+    // The output is a single slab image placed at the displayed slice, so it can replace the volume as the input
+    // of vtkImageViewer2 (orientation follows vtkImageViewer2: 0 -> YZ, 1 -> XZ, 2 -> XY).
+    // Work is split by rows with vtkSMPTools, inner loops run over contiguous rows so they vectorize.
+    // Moving the slab by one slice is incremental: the mean keeps a running sum, MIP/MinIP keep a
+    // two stack sliding window (suffix max/min planes + running max/min of the pushed planes),
+    // so each step costs O(1) planes amortized instead of O(thickness).
+    class SlabProjector
+    {
+    public:
+        SlabProjector() { Reset(); }
+
+        void SetInputData(vtkImageData* img)
+        {
+            m_input = img;
+            Reset();
+        }
+
+        void SetMode(SlabMode mode)
+        {
+            if (m_mode == mode) return;
+            m_mode = mode;
+            Reset();
+        }
+
+        SlabMode GetMode() const { return m_mode; }
+
+        // slab thickness in world units (mm)
+        void SetThickness(double thickness)
+        {
+            thickness = std::max(thickness, 0.0);
+            if (m_thickness == thickness) return;
+            m_thickness = thickness;
+            Reset();
+        }
+
+        double GetThickness() const { return m_thickness; }
+
+        // number of slices covered by the slab
+        int GetSlabSlices(int orientation) const
+        {
+            if (!m_input) return 1;
+            auto const axis = std::clamp(orientation, 0, 2);
+            auto const spacing = std::abs(m_input->GetSpacing()[axis]);
+            auto const n = spacing > 0 ? static_cast<int>(std::lround(m_thickness / spacing)) : 1;
+            return std::max(n, 1);
+        }
+
+        // slab centered on slice, nullptr when off or if the input can not be projected (none or multi-component)
+        vtkImageData* Project(int orientation, int slice)
+        {
+            if (m_mode == SlabMode::Off || !m_input || m_input->GetNumberOfScalarComponents() != 1 ||
+                !m_input->GetPointData()->GetScalars())
+                return nullptr;
+
+            auto const axis = std::clamp(orientation, 0, 2);
+            auto& st = m_states[axis];
+            auto const* ext = m_input->GetExtent();
+            slice = std::clamp(slice, ext[axis * 2], ext[axis * 2 + 1]);
+
+            // keep the window inside the volume by shifting it instead of cutting it
+            auto const count = ext[axis * 2 + 1] - ext[axis * 2] + 1;
+            auto const k = std::min(GetSlabSlices(axis), count);
+            auto const first = std::clamp(slice - k / 2, ext[axis * 2], ext[axis * 2 + 1] - k + 1);
+
+            switch (m_input->GetScalarType())
+            {
+                vtkTemplateMacro(Update<VTK_TT>(axis, st, first, first + k - 1));
+            default:
+                return nullptr;
+            }
+
+            int out_ext[6];
+            std::copy(ext, ext + 6, out_ext);
+            out_ext[axis * 2] = out_ext[axis * 2 + 1] = slice;
+            st.output->SetExtent(out_ext);
+            st.output->Modified();
+            return st.output;
+        }
+
+    private:
+        struct State
+        {
+            int first = 0;
+            int last = -1;
+            int dir = 0;        // direction of the last incremental move
+            int front_pos = 0;  // oldest window slice still held by the front stack
+            bool back_empty = true;
+            std::vector<unsigned char> front; // suffix max/min planes, oldest first
+            std::vector<unsigned char> back;  // max/min of the planes pushed since the last rebuild
+            std::vector<unsigned char> scratch;
+            std::vector<double> sum;
+            vtkSmartPointer<vtkImageData> output = nullptr;
+        };
+
+        void Reset()
+        {
+            for (auto& st : m_states)
+            {
+                st = State{};
+                st.output = vtkSmartPointer<vtkImageData>::New();
+            }
+        }
+
+        void PlaneSize(int axis, int& width, int& height) const
+        {
+            auto const* dims = m_input->GetDimensions();
+            width = axis == 0 ? dims[1] : dims[0];
+            height = axis == 2 ? dims[1] : dims[2];
+        }
+
+        // copy slice s of the volume into a contiguous plane, one task per row
+        template <typename T>
+        void ReadPlane(int axis, int s, T* out) const
+        {
+            auto const* src = static_cast<T const*>(m_input->GetScalarPointer());
+            auto const* dims = m_input->GetDimensions();
+            auto const nx = static_cast<vtkIdType>(dims[0]), ny = static_cast<vtkIdType>(dims[1]);
+            auto const local = static_cast<vtkIdType>(s - m_input->GetExtent()[axis * 2]);
+            int width, height;
+            PlaneSize(axis, width, height);
+            vtkSMPTools::For(0, height, [&](vtkIdType begin, vtkIdType end) {
+                for (auto r = begin; r < end; r++)
+                {
+                    auto* row = out + r * width;
+                    if (axis == 2)
+                        std::memcpy(row, src + (local * ny + r) * nx, width * sizeof(T));
+                    else if (axis == 1)
+                        std::memcpy(row, src + (r * ny + local) * nx, width * sizeof(T));
+                    else
+                    {
+                        auto const* col = src + r * ny * nx + local;
+                        for (int c = 0; c < width; c++)
+                            row[c] = col[c * nx];
+                    }
+                }
+            });
+        }
+
+        template <typename T>
+        static void Combine(bool is_max, T* dst, T const* a, T const* b, vtkIdType n)
+        {
+            vtkSMPTools::For(0, n, 4096, [&](vtkIdType begin, vtkIdType end) {
+                if (is_max)
+                    for (auto i = begin; i < end; i++)
+                        dst[i] = a[i] < b[i] ? b[i] : a[i];
+                else
+                    for (auto i = begin; i < end; i++)
+                        dst[i] = b[i] < a[i] ? b[i] : a[i];
+            });
+        }
+
+        template <typename T>
+        static void Accumulate(double* sum, T const* plane, double sign, vtkIdType n)
+        {
+            vtkSMPTools::For(0, n, 4096, [&](vtkIdType begin, vtkIdType end) {
+                for (auto i = begin; i < end; i++)
+                    sum[i] += sign * static_cast<double>(plane[i]);
+            });
+        }
+
+        // fill the front stack with the suffix max/min of the whole window, ordered along dir
+        template <typename T>
+        void Rebuild(int axis, State& st, int dir, vtkIdType n) const
+        {
+            auto const k = st.last - st.first + 1;
+            auto const is_max = m_mode == SlabMode::MIP;
+            st.front.resize(static_cast<size_t>(k) * n * sizeof(T));
+            auto* front = reinterpret_cast<T*>(st.front.data());
+            auto* scratch = reinterpret_cast<T*>(st.scratch.data());
+            auto const oldest = dir > 0 ? st.first : st.last;
+            ReadPlane(axis, oldest + (k - 1) * dir, front + (k - 1) * n);
+            for (int j = k - 2; j >= 0; j--)
+            {
+                ReadPlane(axis, oldest + j * dir, scratch);
+                Combine(is_max, front + j * n, scratch, front + (j + 1) * n, n);
+            }
+            st.dir = dir;
+            st.front_pos = 0;
+            st.back_empty = true;
+        }
+
+        template <typename T>
+        void Update(int axis, State& st, int first, int last)
+        {
+            int width, height;
+            PlaneSize(axis, width, height);
+            auto const n = static_cast<vtkIdType>(width) * height;
+            if (first == st.first && last == st.last) return;
+
+            if (!st.output->GetPointData()->GetScalars() || st.output->GetNumberOfPoints() != n)
+            {
+                st.output->SetOrigin(m_input->GetOrigin());
+                st.output->SetSpacing(m_input->GetSpacing());
+                st.output->SetDirectionMatrix(m_input->GetDirectionMatrix());
+                int ext[6];
+                m_input->GetExtent(ext);
+                ext[axis * 2 + 1] = ext[axis * 2];
+                st.output->SetExtent(ext);
+                st.output->AllocateScalars(m_input->GetScalarType(), 1);
+            }
+            st.scratch.resize(n * sizeof(T));
+            auto* out = static_cast<T*>(st.output->GetScalarPointer());
+            auto* scratch = reinterpret_cast<T*>(st.scratch.data());
+
+            auto const step = first - st.first;
+            auto const shifted = st.last >= st.first && last - first == st.last - st.first && std::abs(step) == 1;
+            auto const k = last - first + 1;
+
+            if (m_mode == SlabMode::Mean)
+            {
+                if (shifted)
+                {
+                    // running sum: add the entering slice, drop the leaving one
+                    ReadPlane(axis, step > 0 ? last : first, scratch);
+                    Accumulate(st.sum.data(), scratch, 1.0, n);
+                    ReadPlane(axis, step > 0 ? st.first : st.last, scratch);
+                    Accumulate(st.sum.data(), scratch, -1.0, n);
+                }
+                else
+                {
+                    st.sum.assign(n, 0.0);
+                    for (auto s = first; s <= last; s++)
+                    {
+                        ReadPlane(axis, s, scratch);
+                        Accumulate(st.sum.data(), scratch, 1.0, n);
+                    }
+                }
+                st.first = first;
+                st.last = last;
+
+                auto const* sum = st.sum.data();
+                auto const inv = 1.0 / k;
+                vtkSMPTools::For(0, n, 4096, [&](vtkIdType begin, vtkIdType end) {
+                    for (auto i = begin; i < end; i++)
+                    {
+                        if constexpr (std::is_integral_v<T>)
+                            out[i] = static_cast<T>(std::floor(sum[i] * inv + 0.5));
+                        else
+                            out[i] = static_cast<T>(sum[i] * inv);
+                    }
+                });
+                return;
+            }
+
+            auto const is_max = m_mode == SlabMode::MIP;
+            st.back.resize(n * sizeof(T));
+            auto* back = reinterpret_cast<T*>(st.back.data());
+            st.first = first;
+            st.last = last;
+            if (!shifted || step != st.dir)
+                Rebuild<T>(axis, st, shifted ? step : 1, n);
+            else
+            {
+                // push the entering slice onto the back stack
+                ReadPlane(axis, step > 0 ? last : first, scratch);
+                if (st.back_empty)
+                    std::memcpy(back, scratch, n * sizeof(T));
+                else
+                    Combine(is_max, back, back, scratch, n);
+                st.back_empty = false;
+
+                // pop the leaving slice from the front stack, refill it once it runs empty
+                if (++st.front_pos == k) Rebuild<T>(axis, st, step, n);
+            }
+
+            auto const* front = reinterpret_cast<T*>(st.front.data()) + static_cast<vtkIdType>(st.front_pos) * n;
+            if (st.back_empty)
+                std::memcpy(out, front, n * sizeof(T));
+            else
+                Combine(is_max, out, front, back, n);
+        }
+
+    private:
+        vtkSmartPointer<vtkImageData> m_input = nullptr;
+        SlabMode m_mode = SlabMode::Off;
+        double m_thickness = 10.0;
+        State m_states[3];
+    };
+} // namespace
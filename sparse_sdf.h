@@ -0,0 +1,506 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkStaticPointLocator.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPThreadLocalObject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    // Narrow band signed distance of an oriented point cloud (points with normals), stored sparse, and its surface.
+    // The grid is isotropic with `dimension` voxels along the longest side of the bounds, but only the 8^3 bricks
+    // within the radius of some point exist: they are found from the points, kept sorted and hashed by their brick
+    // coordinates, so memory grows with the surface area instead of the bounding volume.
+    // A voxel holds the distance to the tangent plane of its closest point within the radius (like
+    // vtkSignedDistance), NaN when there is none; the distance is positive on the side the normals point to.
+    // ExtractSurface runs surface nets on the bricks: one vertex per cell with a sign change (the mean of its edge
+    // crossings), one quad (two triangles) per edge with a sign change, all in parallel per brick. Cells of
+    // neighbouring bricks are reached through the hash, so the mesh is welded across bricks by construction.
+    class SparseSignedDistance
+    {
+    public:
+        static constexpr int brick_size = 8;
+
+        // voxels along the longest side of the point bounds, e.g. 1024 for the resolution of a dense 1024^3 grid
+        void SetDimension(int dimension) { m_dimension = std::max(dimension, 2); }
+
+        // half width of the band in world units; 0 picks 4 voxels, widened to three times the typical point spacing
+        void SetRadius(double radius) { m_radius = radius; }
+
+        // place the grid instead of deriving it from the input bounds (and the dimension), so the grids of several
+        // inputs share their voxels; the input must lie above origin + radius
+        void SetGrid(double const origin[3], double spacing)
+        {
+            std::copy_n(origin, 3, m_grid_origin);
+            m_grid_spacing = spacing;
+        }
+
+        // origin of the grid: the input bounds less the radius and a voxel, unless placed by SetGrid
+        void GetOrigin(double origin[3]) const { std::copy_n(m_origin, 3, origin); }
+
+        // brick or cell coordinates packed into one key, 21 bits each
+        static std::uint64_t Key(std::uint64_t x, std::uint64_t y, std::uint64_t z) { return x | y << 21 | z << 42; }
+
+        static void Unpack(std::uint64_t key, int coords[3])
+        {
+            for (int i = 0; i < 3; i++)
+                coords[i] = static_cast<int>(key >> (21 * i) & 0x1fffff);
+        }
+
+        double GetRadius() const { return m_band; }
+
+        double GetSpacing() const { return m_spacing; }
+
+        size_t GetNumberOfBricks() const { return m_keys.size(); }
+
+        // bytes of the bricks and their hash
+        size_t GetMemorySize() const
+        {
+            return m_values.size() * sizeof(float) +
+                   m_keys.size() * (sizeof(std::uint64_t) + sizeof(std::pair<std::uint64_t const, int>) +
+                                    2 * sizeof(void*));
+        }
+
+        // bytes of a dense float grid of the same resolution
+        size_t GetDenseMemorySize() const
+        {
+            return static_cast<size_t>(m_dims[0]) * m_dims[1] * m_dims[2] * sizeof(float);
+        }
+
+        // input: points with normals; locator: a locator built on the input (e.g. PointNormalEstimation's),
+        // built here when null. false when the input has no normals or no extent
+        bool Execute(vtkPolyData* input, vtkStaticPointLocator* locator = nullptr)
+        {
+            m_keys.clear();
+            m_slots.clear();
+            m_values.clear();
+            auto* normals = input->GetPointData()->GetNormals();
+            auto const count = input->GetNumberOfPoints();
+            if (!normals || count == 0) return false;
+
+            double bounds[6];
+            input->GetBounds(bounds);
+            auto const longest = std::max({bounds[1] - bounds[0], bounds[3] - bounds[2], bounds[5] - bounds[4]});
+            if (m_grid_spacing > 0)
+                m_spacing = m_grid_spacing;
+            else if (longest > 0)
+                m_spacing = longest / (m_dimension - 1);
+            else
+                return false;
+
+            vtkSmartPointer<vtkStaticPointLocator> own;
+            if (!locator)
+            {
+                own = vtkSmartPointer<vtkStaticPointLocator>::New();
+                own->SetDataSet(input);
+                own->BuildLocator();
+                locator = own;
+            }
+            m_band = m_radius > 0 ? m_radius : AutomaticRadius(input->GetPoints(), locator);
+
+            // a voxel of margin beyond the band, so the grid never clips it
+            for (int i = 0; i < 3; i++)
+            {
+                m_origin[i] = m_grid_spacing > 0 ? m_grid_origin[i] : bounds[i * 2] - m_band - m_spacing;
+                m_dims[i] = static_cast<int>(std::ceil((bounds[i * 2 + 1] - m_origin[i] + m_band) / m_spacing)) + 2;
+            }
+
+            ActivateBricks(input->GetPoints());
+            EvaluateBricks(input->GetPoints(), normals, locator);
+            return true;
+        }
+
+        // triangles of the zero level set with float points and normals (the distance gradient, outward).
+        // core (cells, half open per axis): only the quads of edges starting in core, with the vertices of the cells
+        // in core and of the layer just below it, which belong to the region next to it;
+        // cell_keys: the cell of every output vertex in grid coordinates, packed 21 bits per axis
+        vtkSmartPointer<vtkPolyData> ExtractSurface(int const core[6] = nullptr,
+                                                    std::vector<std::uint64_t>* cell_keys = nullptr) const
+        {
+            constexpr int bs = brick_size;
+            auto const inside_core = [core](int const cell[3], int below) {
+                if (!core) return true;
+                for (int i = 0; i < 3; i++)
+                    if (cell[i] < core[i * 2] - below || cell[i] >= core[i * 2 + 1]) return false;
+                return true;
+            };
+            auto const bricks = static_cast<vtkIdType>(m_keys.size());
+            std::vector<std::vector<int>> cell_vertex(bricks); // per cell of a brick, -1 or its vertex in the brick
+            std::vector<std::vector<float>> brick_points(bricks), brick_normals(bricks);
+            std::vector<std::vector<std::uint64_t>> brick_keys(cell_keys ? bricks : 0);
+
+            // vertices
+            vtkSMPTools::For(0, bricks, [&](vtkIdType begin, vtkIdType end) {
+                std::vector<float> apron(Apron::size);
+                for (auto b = begin; b < end; b++)
+                {
+                    int brick[3];
+                    Unpack(m_keys[b], brick);
+                    GatherApron(b, brick, apron.data());
+                    for (int z = 0; z < bs; z++)
+                        for (int y = 0; y < bs; y++)
+                            for (int x = 0; x < bs; x++)
+                            {
+                                float c[8];
+                                bool valid = true, inside = false, outside = false;
+                                for (int k = 0; k < 8; k++)
+                                {
+                                    c[k] = apron[Apron::Index(x + (k & 1), y + (k >> 1 & 1), z + (k >> 2))];
+                                    valid = valid && !std::isnan(c[k]);
+                                    (c[k] < 0 ? inside : outside) = true;
+                                }
+                                int const global[3]{brick[0] * bs + x, brick[1] * bs + y, brick[2] * bs + z};
+                                if (!valid || !inside || !outside || !inside_core(global, 1)) continue;
+
+                                // mean of the crossings on the 12 cell edges, in cell coordinates
+                                double p[3]{0, 0, 0};
+                                int crossings = 0;
+                                for (int k = 0; k < 8; k++)
+                                    for (int axis = 0; axis < 3; axis++)
+                                    {
+                                        auto const bit = 1 << axis;
+                                        if (k & bit) continue;
+                                        auto const s0 = c[k], s1 = c[k | bit];
+                                        if ((s0 < 0) == (s1 < 0)) continue;
+                                        auto const t = s0 / (s0 - s1);
+                                        for (int i = 0; i < 3; i++)
+                                            p[i] += i == axis ? t : (k >> i & 1);
+                                        crossings++;
+                                    }
+                                // gradient by central differences over the cell
+                                double g[3]{0, 0, 0};
+                                for (int k = 0; k < 8; k++)
+                                    for (int i = 0; i < 3; i++)
+                                        g[i] += (k >> i & 1) ? c[k] : -c[k];
+                                auto const length = std::sqrt(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+
+                                auto& vertices = cell_vertex[b];
+                                if (vertices.empty()) vertices.assign(bs * bs * bs, -1);
+                                vertices[(z * bs + y) * bs + x] = static_cast<int>(brick_points[b].size() / 3);
+                                for (int i = 0; i < 3; i++)
+                                {
+                                    brick_points[b].push_back(
+                                        static_cast<float>(m_origin[i] + (global[i] + p[i] / crossings) * m_spacing));
+                                    brick_normals[b].push_back(length > 0 ? static_cast<float>(g[i] / length) : 0.f);
+                                }
+                                if (cell_keys) brick_keys[b].push_back(Key(global[0], global[1], global[2]));
+                            }
+                }
+            });
+
+            std::vector<vtkIdType> first_vertex(bricks + 1, 0);
+            for (vtkIdType b = 0; b < bricks; b++)
+                first_vertex[b + 1] = first_vertex[b] + static_cast<vtkIdType>(brick_points[b].size() / 3);
+
+            // triangles: every edge leaving a voxel of the brick towards +x, +y or +z with a sign change joins the
+            // vertices of the 4 cells around it; the cells at -1 lie in the bricks below
+            std::vector<std::vector<vtkIdType>> brick_triangles(bricks);
+            vtkSMPTools::For(0, bricks, [&](vtkIdType begin, vtkIdType end) {
+                std::vector<float> apron(Apron::size);
+                for (auto b = begin; b < end; b++)
+                {
+                    int brick[3];
+                    Unpack(m_keys[b], brick);
+                    // bit i set: the brick one below along axis i
+                    vtkIdType below[8];
+                    for (int n = 0; n < 8; n++)
+                        below[n] = Slot(brick[0] - (n & 1), brick[1] - (n >> 1 & 1), brick[2] - (n >> 2));
+                    auto const vertex = [&](int const cell[3]) -> vtkIdType {
+                        int n = 0, local = 0;
+                        for (int i = 2; i >= 0; i--)
+                        {
+                            n |= (cell[i] < 0) << i;
+                            local = local * bs + (cell[i] < 0 ? cell[i] + bs : cell[i]);
+                        }
+                        auto const slot = below[n];
+                        if (slot < 0 || cell_vertex[slot].empty() || cell_vertex[slot][local] < 0) return -1;
+                        return first_vertex[slot] + cell_vertex[slot][local];
+                    };
+
+                    GatherApron(b, brick, apron.data());
+                    auto& triangles = brick_triangles[b];
+                    for (int z = 0; z < bs; z++)
+                        for (int y = 0; y < bs; y++)
+                            for (int x = 0; x < bs; x++)
+                            {
+                                auto const s0 = apron[Apron::Index(x, y, z)];
+                                int const voxel[3]{brick[0] * bs + x, brick[1] * bs + y, brick[2] * bs + z};
+                                if (std::isnan(s0) || !inside_core(voxel, 0)) continue;
+                                for (int axis = 0; axis < 3; axis++)
+                                {
+                                    int v[3]{x, y, z};
+                                    v[axis]++;
+                                    auto const s1 = apron[Apron::Index(v[0], v[1], v[2])];
+                                    if (std::isnan(s1) || (s0 < 0) == (s1 < 0)) continue;
+                                    // quad around the edge, counter clockwise seen from +axis
+                                    auto const u = (axis + 1) % 3, w = (axis + 2) % 3;
+                                    vtkIdType quad[4];
+                                    bool complete = true;
+                                    for (int q = 0; q < 4 && complete; q++)
+                                    {
+                                        int cell[3]{x, y, z};
+                                        cell[u] -= q == 1 || q == 2;
+                                        cell[w] -= q >= 2;
+                                        quad[q] = vertex(cell);
+                                        complete = quad[q] >= 0;
+                                    }
+                                    if (!complete) continue;
+                                    // facing +axis when the edge leaves the inside
+                                    if (s0 >= 0) std::swap(quad[1], quad[3]);
+                                    triangles.insert(triangles.end(), {quad[0], quad[1], quad[2]});
+                                    triangles.insert(triangles.end(), {quad[0], quad[2], quad[3]});
+                                }
+                            }
+                }
+            });
+
+            std::vector<vtkIdType> first_index(bricks + 1, 0);
+            for (vtkIdType b = 0; b < bricks; b++)
+                first_index[b + 1] = first_index[b] + static_cast<vtkIdType>(brick_triangles[b].size());
+
+            vtkNew<vtkFloatArray> coords, normals;
+            coords->SetNumberOfComponents(3);
+            coords->SetNumberOfTuples(first_vertex[bricks]);
+            normals->SetName("Normals");
+            normals->SetNumberOfComponents(3);
+            normals->SetNumberOfTuples(first_vertex[bricks]);
+            if (cell_keys) cell_keys->resize(first_vertex[bricks]);
+            vtkNew<vtkIdTypeArray> offsets, connectivity;
+            offsets->SetNumberOfValues(first_index[bricks] / 3 + 1);
+            connectivity->SetNumberOfValues(first_index[bricks]);
+            vtkSMPTools::For(0, bricks, [&](vtkIdType begin, vtkIdType end) {
+                for (auto b = begin; b < end; b++)
+                {
+                    std::copy(brick_points[b].begin(), brick_points[b].end(), coords->GetPointer(first_vertex[b] * 3));
+                    std::copy(brick_normals[b].begin(), brick_normals[b].end(),
+                              normals->GetPointer(first_vertex[b] * 3));
+                    std::copy(brick_triangles[b].begin(), brick_triangles[b].end(),
+                              connectivity->GetPointer(first_index[b]));
+                    if (cell_keys)
+                        std::copy(brick_keys[b].begin(), brick_keys[b].end(), cell_keys->begin() + first_vertex[b]);
+                }
+            });
+            auto* offset = offsets->GetPointer(0);
+            for (vtkIdType i = 0; i <= first_index[bricks] / 3; i++)
+                offset[i] = i * 3;
+
+            vtkNew<vtkPoints> points;
+            points->SetData(coords);
+            vtkNew<vtkCellArray> polys;
+            polys->SetData(offsets, connectivity);
+            auto output = vtkSmartPointer<vtkPolyData>::New();
+            output->SetPoints(points);
+            output->SetPolys(polys);
+            output->GetPointData()->SetNormals(normals);
+            return output;
+        }
+
+    private:
+        // the voxels of a brick and one more layer towards +x, +y and +z
+        struct Apron
+        {
+            static constexpr int side = brick_size + 1;
+            static constexpr int size = side * side * side;
+            static int Index(int x, int y, int z) { return (z * side + y) * side + x; }
+        };
+
+        vtkIdType Slot(int x, int y, int z) const
+        {
+            if (x < 0 || y < 0 || z < 0) return -1;
+            auto const it = m_slots.find(Key(x, y, z));
+            return it == m_slots.end() ? -1 : it->second;
+        }
+
+        // 4 voxels, or three times the median distance between neighbouring points (of a sample) when the points are
+        // sparser than that, so the band closes between them
+        double AutomaticRadius(vtkPoints* points, vtkStaticPointLocator* locator) const
+        {
+            auto const count = points->GetNumberOfPoints();
+            auto const samples = std::min<vtkIdType>(count, 1024);
+            std::vector<double> spacing(samples, 0);
+            vtkSMPThreadLocalObject<vtkIdList> neighbours;
+            vtkSMPTools::For(0, samples, [&](vtkIdType begin, vtkIdType end) {
+                auto* ids = neighbours.Local();
+                for (auto s = begin; s < end; s++)
+                {
+                    double x[3], p[3];
+                    points->GetPoint(s * count / samples, x);
+                    locator->FindClosestNPoints(2, x, ids);
+                    if (ids->GetNumberOfIds() < 2) continue;
+                    points->GetPoint(ids->GetId(1), p);
+                    spacing[s] = std::sqrt((x[0] - p[0]) * (x[0] - p[0]) + (x[1] - p[1]) * (x[1] - p[1]) +
+                                           (x[2] - p[2]) * (x[2] - p[2]));
+                }
+            });
+            std::nth_element(spacing.begin(), spacing.begin() + samples / 2, spacing.end());
+            return std::max(4 * m_spacing, 3 * spacing[samples / 2]);
+        }
+
+        // the bricks overlapping the box of radius m_band around any point, sorted by key
+        void ActivateBricks(vtkPoints* points)
+        {
+            constexpr int bs = brick_size;
+            // keys per thread, compacted (sorted, unique) whenever they pile up
+            struct Keys
+            {
+                std::vector<std::uint64_t> keys;
+                size_t compact_at = 1 << 20;
+
+                void Compact()
+                {
+                    std::sort(keys.begin(), keys.end());
+                    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+                    compact_at = std::max(compact_at, keys.size() * 2);
+                }
+            };
+            vtkSMPThreadLocal<Keys> local;
+            vtkSMPTools::For(0, points->GetNumberOfPoints(), [&](vtkIdType begin, vtkIdType end) {
+                auto& keys = local.Local();
+                for (auto i = begin; i < end; i++)
+                {
+                    double x[3];
+                    points->GetPoint(i, x);
+                    int lo[3], hi[3];
+                    for (int c = 0; c < 3; c++)
+                    {
+                        lo[c] = std::max(static_cast<int>(std::ceil((x[c] - m_band - m_origin[c]) / m_spacing)), 0);
+                        hi[c] = std::min(static_cast<int>((x[c] + m_band - m_origin[c]) / m_spacing), m_dims[c] - 1);
+                        lo[c] /= bs;
+                        hi[c] /= bs;
+                    }
+                    for (int z = lo[2]; z <= hi[2]; z++)
+                        for (int y = lo[1]; y <= hi[1]; y++)
+                            for (int x = lo[0]; x <= hi[0]; x++)
+                            {
+                                auto const key = Key(x, y, z);
+                                // neighbouring points mostly share their bricks
+                                if (!keys.keys.empty() && keys.keys.back() == key) continue;
+                                keys.keys.push_back(key);
+                            }
+                    if (keys.keys.size() >= keys.compact_at) keys.Compact();
+                }
+            });
+            for (auto& keys : local)
+            {
+                keys.Compact();
+                m_keys.insert(m_keys.end(), keys.keys.begin(), keys.keys.end());
+                keys.keys = std::vector<std::uint64_t>();
+            }
+            std::sort(m_keys.begin(), m_keys.end());
+            m_keys.erase(std::unique(m_keys.begin(), m_keys.end()), m_keys.end());
+        }
+
+        // distances of the voxels of every brick; bricks left without any distance are dropped
+        void EvaluateBricks(vtkPoints* points, vtkDataArray* normals, vtkStaticPointLocator* locator)
+        {
+            constexpr int bs = brick_size;
+            constexpr int voxels = bs * bs * bs;
+            auto const bricks = static_cast<vtkIdType>(m_keys.size());
+            m_values.resize(m_keys.size() * voxels);
+            std::vector<char> empty(bricks, 0);
+            vtkSMPTools::For(0, bricks, [&](vtkIdType begin, vtkIdType end) {
+                for (auto b = begin; b < end; b++)
+                {
+                    int brick[3];
+                    Unpack(m_keys[b], brick);
+                    auto* values = m_values.data() + b * voxels;
+                    bool any = false;
+                    for (int z = 0; z < bs; z++)
+                        for (int y = 0; y < bs; y++)
+                            for (int x = 0; x < bs; x++)
+                            {
+                                double const v[3]{(brick[0] * bs + x) * m_spacing + m_origin[0],
+                                                  (brick[1] * bs + y) * m_spacing + m_origin[1],
+                                                  (brick[2] * bs + z) * m_spacing + m_origin[2]};
+                                double dist2;
+                                auto const id = locator->FindClosestPointWithinRadius(m_band, v, dist2);
+                                auto& value = values[(z * bs + y) * bs + x];
+                                if (id < 0)
+                                {
+                                    value = std::numeric_limits<float>::quiet_NaN();
+                                    continue;
+                                }
+                                double p[3], n[3];
+                                points->GetPoint(id, p);
+                                normals->GetTuple(id, n);
+                                value = static_cast<float>(n[0] * (v[0] - p[0]) + n[1] * (v[1] - p[1]) +
+                                                           n[2] * (v[2] - p[2]));
+                                any = true;
+                            }
+                    empty[b] = !any;
+                }
+            });
+
+            size_t kept = 0;
+            for (vtkIdType b = 0; b < bricks; b++)
+            {
+                if (empty[b]) continue;
+                if (kept != static_cast<size_t>(b))
+                {
+                    m_keys[kept] = m_keys[b];
+                    std::copy_n(m_values.begin() + b * voxels, voxels, m_values.begin() + kept * voxels);
+                }
+                kept++;
+            }
+            m_keys.resize(kept);
+            m_values.resize(kept * voxels);
+            m_values.shrink_to_fit();
+            m_slots.reserve(kept);
+            for (size_t b = 0; b < kept; b++)
+                m_slots.emplace(m_keys[b], static_cast<int>(b));
+        }
+
+        // copy brick b and the first layer of its +x, +y, +z neighbours, NaN where there is no brick
+        void GatherApron(vtkIdType b, int const brick[3], float* apron) const
+        {
+            constexpr int bs = brick_size;
+            // bit i set: the brick one above along axis i
+            float const* above[8];
+            for (int n = 0; n < 8; n++)
+            {
+                auto const slot = n == 0 ? b : Slot(brick[0] + (n & 1), brick[1] + (n >> 1 & 1), brick[2] + (n >> 2));
+                above[n] = slot < 0 ? nullptr : m_values.data() + slot * bs * bs * bs;
+            }
+            for (int z = 0; z <= bs; z++)
+                for (int y = 0; y <= bs; y++)
+                    for (int x = 0; x <= bs; x++)
+                    {
+                        auto const n = (x == bs) | (y == bs) << 1 | (z == bs) << 2;
+                        apron[Apron::Index(x, y, z)] =
+                            above[n] ? above[n][((z % bs) * bs + (y % bs)) * bs + (x % bs)]
+                                     : std::numeric_limits<float>::quiet_NaN();
+                    }
+        }
+
+    private:
+        int m_dimension = 256;
+        double m_radius = 0;
+        double m_grid_origin[3]{0, 0, 0};
+        double m_grid_spacing = 0; // 0: grid from the input bounds
+        double m_band = 0;
+        double m_spacing = 1;
+        double m_origin[3]{0, 0, 0};
+        int m_dims[3]{0, 0, 0};
+        std::vector<std::uint64_t> m_keys;              // brick coordinates of the stored bricks, sorted
+        std::unordered_map<std::uint64_t, int> m_slots; // key -> brick
+        std::vector<float> m_values;                    // brick_size^3 distances per brick, x fastest
+    };
+} // namespace
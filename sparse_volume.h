@@ -0,0 +1,175 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    // Sparse unsigned char volume made of BrickSize^3 bricks (x-fastest inside a brick).
+    // Bricks holding a single value (empty space, solid interior) only keep that value in the brick table,
+    // the other ones (the surface shell) keep their voxels, so the memory grows with the surface area instead
+    // of the bounding box volume. Border bricks are padded with the background value.
+    // Use ToDense to get a regular vtkImageData of a region of interest, optionally subsampled.
+    class SparseVolume
+    {
+    public:
+        static constexpr int uniform = -1;
+
+        SparseVolume() = default;
+
+        // the brick table starts with every brick uniform at background
+        void Initialize(int const dims[3], double const origin[3], double const spacing[3], int brick_size = 16,
+                        unsigned char background = 0)
+        {
+            m_brick_size = std::max(brick_size, 1);
+            for (int i = 0; i < 3; i++)
+            {
+                m_dims[i] = dims[i];
+                m_origin[i] = origin[i];
+                m_spacing[i] = spacing[i];
+                m_brick_dims[i] = (dims[i] + m_brick_size - 1) / m_brick_size;
+            }
+            auto const count = static_cast<size_t>(m_brick_dims[0]) * m_brick_dims[1] * m_brick_dims[2];
+            m_slots.assign(count, uniform);
+            m_values.assign(count, background);
+            m_bricks.clear();
+        }
+
+        int const* GetDimensions() const { return m_dims; }
+
+        double const* GetOrigin() const { return m_origin; }
+
+        double const* GetSpacing() const { return m_spacing; }
+
+        int GetBrickSize() const { return m_brick_size; }
+
+        int const* GetBrickDimensions() const { return m_brick_dims; }
+
+        size_t GetNumberOfStoredBricks() const { return m_bricks.size(); }
+
+        // bytes held by the brick table and the stored bricks
+        size_t GetMemorySize() const
+        {
+            auto const brick_bytes = static_cast<size_t>(m_brick_size) * m_brick_size * m_brick_size;
+            return m_slots.size() * (sizeof(int) + 1) + m_bricks.size() * (brick_bytes + sizeof(m_bricks[0]));
+        }
+
+        // size of the equivalent dense volume
+        size_t GetDenseMemorySize() const { return static_cast<size_t>(m_dims[0]) * m_dims[1] * m_dims[2]; }
+
+        // store one brick from voxels (brick_size^3, x-fastest), a brick with a single value only keeps the value
+        // thread safe for distinct bricks
+        void SetBrick(int bx, int by, int bz, unsigned char const* voxels)
+        {
+            auto const n = static_cast<size_t>(m_brick_size) * m_brick_size * m_brick_size;
+            auto const index = BrickIndex(bx, by, bz);
+            if (std::all_of(voxels, voxels + n, [v = voxels[0]](unsigned char x) { return x == v; }))
+            {
+                m_slots[index] = uniform;
+                m_values[index] = voxels[0];
+                return;
+            }
+            std::unique_ptr<unsigned char[]> brick(new unsigned char[n]);
+            std::memcpy(brick.get(), voxels, n);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_slots[index] = static_cast<int>(m_bricks.size());
+            m_bricks.push_back(std::move(brick));
+        }
+
+        unsigned char GetValue(int x, int y, int z) const
+        {
+            auto const bs = m_brick_size;
+            auto const index = BrickIndex(x / bs, y / bs, z / bs);
+            auto const slot = m_slots[index];
+            if (slot == uniform) return m_values[index];
+            return m_bricks[slot][((z % bs) * bs + (y % bs)) * bs + (x % bs)];
+        }
+
+        // dense copy of the voxel extent roi (whole volume when null), keeping every stride-th voxel
+        vtkSmartPointer<vtkImageData> ToDense(int const roi[6] = nullptr, int stride = 1) const
+        {
+            int ext[6]{0, m_dims[0] - 1, 0, m_dims[1] - 1, 0, m_dims[2] - 1};
+            if (roi)
+                for (int i = 0; i < 3; i++)
+                {
+                    ext[i * 2] = std::clamp(roi[i * 2], 0, m_dims[i] - 1);
+                    ext[i * 2 + 1] = std::clamp(roi[i * 2 + 1], ext[i * 2], m_dims[i] - 1);
+                }
+            stride = std::max(stride, 1);
+
+            int out_dims[3];
+            double origin[3], spacing[3];
+            for (int i = 0; i < 3; i++)
+            {
+                out_dims[i] = (ext[i * 2 + 1] - ext[i * 2]) / stride + 1;
+                origin[i] = m_origin[i] + ext[i * 2] * m_spacing[i];
+                spacing[i] = m_spacing[i] * stride;
+            }
+
+            auto img = vtkSmartPointer<vtkImageData>::New();
+            img->SetOrigin(origin);
+            img->SetSpacing(spacing);
+            img->SetExtent(0, out_dims[0] - 1, 0, out_dims[1] - 1, 0, out_dims[2] - 1);
+            img->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+            auto* out = static_cast<unsigned char*>(img->GetScalarPointer());
+
+            auto const bs = m_brick_size;
+            vtkSMPTools::For(0, out_dims[2], [&](vtkIdType begin, vtkIdType end) {
+                for (auto k = begin; k < end; k++)
+                {
+                    auto const z = ext[4] + static_cast<int>(k) * stride;
+                    for (int j = 0; j < out_dims[1]; j++)
+                    {
+                        auto const y = ext[2] + j * stride;
+                        auto* row = out + (k * out_dims[1] + j) * out_dims[0];
+                        // walk the row brick by brick
+                        for (int i = 0; i < out_dims[0];)
+                        {
+                            auto const x = ext[0] + i * stride;
+                            auto const bx = x / bs;
+                            auto const index = BrickIndex(bx, y / bs, z / bs);
+                            auto const slot = m_slots[index];
+                            auto const brick_end = std::min((bx + 1) * bs, ext[1] + 1);
+                            auto const count = std::min((brick_end - x + stride - 1) / stride, out_dims[0] - i);
+                            if (slot == uniform)
+                                std::memset(row + i, m_values[index], count);
+                            else
+                            {
+                                auto const* src = m_bricks[slot].get() + ((z % bs) * bs + (y % bs)) * bs;
+                                for (int c = 0; c < count; c++)
+                                    row[i + c] = src[(x + c * stride) % bs];
+                            }
+                            i += count;
+                        }
+                    }
+                }
+            });
+            return img;
+        }
+
+    private:
+        size_t BrickIndex(int bx, int by, int bz) const
+        {
+            return (static_cast<size_t>(bz) * m_brick_dims[1] + by) * m_brick_dims[0] + bx;
+        }
+
+    private:
+        int m_dims[3]{0, 0, 0};
+        double m_origin[3]{0, 0, 0};
+        double m_spacing[3]{1, 1, 1};
+        int m_brick_size = 16;
+        int m_brick_dims[3]{0, 0, 0};
+        std::vector<int> m_slots;            // stored brick per brick, uniform if the brick holds one value
+        std::vector<unsigned char> m_values; // value of the uniform bricks
+        std::vector<std::unique_ptr<unsigned char[]>> m_bricks;
+        std::mutex m_mutex;
+    };
+} // namespace
@@ -20,10 +20,6 @@
 #include <vtkImageData.h>
 #include <vtkImageAccumulate.h>
 
-#include <vtkPCANormalEstimation.h>
-#include <vtkSignedDistance.h>
-#include <vtkExtractSurface.h>
-
 #include <vtkPolyDataNormals.h>
 #include <vtkDoubleArray.h>
 #include <vtkFloatArray.h>
@@ -32,7 +28,14 @@
 #include <vtkTransformPolyDataFilter.h>
 #include <vtkReverseSense.h>
 
+#include <charconv>
+#include <cstring>
+#include <string>
+
 #include "load_3d.h"
+#include "mesh_lod.h"
+#include "point_normals.h"
+#include "sparse_sdf.h"
 
 bool HasPointNormals(vtkPolyData* polydata)
 {
@@ -105,51 +108,54 @@ bool HasPointNormals(vtkPolyData* polydata)
     return false;
 }
 
-vtkSmartPointer<vtkPolyData> extract_surface(vtkSmartPointer<vtkPolyData> polydata)
+// dimension: voxels along the longest side of the distance grid
+vtkSmartPointer<vtkPolyData> extract_surface(vtkSmartPointer<vtkPolyData> polydata, int dimension)
 {
-    double bounds[6];
-    polydata->GetBounds(bounds);
-    double range[3];
-    for (int i = 0; i < 3; ++i)
-        range[i] = bounds[2 * i + 1] - bounds[2 * i];
-
-    int sampleSize = polydata->GetNumberOfPoints() * 0.00005;
-    if (sampleSize < 10) sampleSize = 10;
-
-    vtkNew<vtkPCANormalEstimation> normals;
-    normals->SetInputData(polydata);
-    normals->SetSampleSize(sampleSize);
-    normals->SetNormalOrientationToGraphTraversal();
-    normals->FlipNormalsOn();
-
-    vtkNew<vtkSignedDistance> distance;
-    distance->SetInputConnection(normals->GetOutputPort());
-
-    int dimension = 256;
-    double radius;
-    radius = std::max(std::max(range[0], range[1]), range[2]) / static_cast<double>(dimension) * 4; // ~4 voxels
-    std::cout << "Radius: " << radius << std::endl;
-
-    distance->SetRadius(radius);
-    distance->SetDimensions(dimension, dimension, dimension);
-    distance->SetBounds(bounds[0] - range[0] * .1, bounds[1] + range[0] * .1, bounds[2] - range[1] * .1,
-                        bounds[3] + range[1] * .1, bounds[4] - range[2] * .1, bounds[5] + range[2] * .1);
-
-    vtkNew<vtkExtractSurface> surface;
-    surface->SetInputConnection(distance->GetOutputPort());
-    surface->SetRadius(radius * .99);
-    surface->Update();
-
-    return surface->GetOutput();
+    // narrow band distance in hashed bricks instead of a dense grid, memory follows the surface area
+    SparseSignedDistance distance;
+    distance.SetDimension(dimension);
+    if (polydata->GetPointData()->GetNormals())
+        distance.Execute(polydata); // e.g. normals stored in a .ply or .vtp point cloud
+    else
+    {
+        int sampleSize = polydata->GetNumberOfPoints() * 0.00005;
+        if (sampleSize < 10) sampleSize = 10;
+
+        // parallel PCA and graph traversal, outward normals
+        PointNormalEstimation normals;
+        normals.SetSampleSize(sampleSize);
+        normals.SetOrientationToGraphTraversal();
+        // same points, the locator built for the normals is reused
+        distance.Execute(normals.Execute(polydata), normals.GetLocator());
+    }
+    std::cout << "Radius: " << distance.GetRadius() << ", " << distance.GetNumberOfBricks() << " bricks ("
+              << (distance.GetMemorySize() >> 20) << " MB, dense " << (distance.GetDenseMemorySize() >> 20) << " MB)"
+              << std::endl;
+
+    return distance.ExtractSurface();
 }
 
 int main(int argc, char* argv[])
 {
     if (argc < 2)
     {
-        std::cout << "Usage: " << argv[0] << " Filename e.g mesh.ply texture.png(optional)" << std::endl;
+        std::cout << "Usage: " << argv[0] << " Filename e.g mesh.ply texture.png(optional, - for none) [resolution=256]"
+                  << std::endl;
+        std::cout << "resolution: voxels along the longest side of the grid point clouds are meshed on" << std::endl;
         return EXIT_FAILURE;
     }
+    int resolution = 256;
+    if (argc >= 4)
+    {
+        auto const* end = argv[3] + std::strlen(argv[3]);
+        auto const [last, error] = std::from_chars(argv[3], end, resolution);
+        if (error != std::errc() || last != end || resolution < 2)
+        {
+            std::cerr << "Invalid resolution " << argv[3] << ", expected an integer of at least 2" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    auto const has_texture = argc >= 3 && std::string(argv[2]) != "-";
 
     auto meshdata = ReadPolyData(argv[1]);
 
@@ -158,8 +164,10 @@ int main(int argc, char* argv[])
     std::cout << bounds[0] << ", " << bounds[1] << ", " << bounds[2] << ", " << bounds[3] << ", " << bounds[4] << ", "
               << bounds[5] << std::endl;
 
-    if (!HasPointNormals(meshdata))
-        meshdata = extract_surface(meshdata);
+    // point clouds and meshes without normals (the normals gen_mesh caches for a .xyz are checked against its
+    // settings, ReadPolyData leaves them out)
+    if (meshdata->GetNumberOfPolys() == 0 || !HasPointNormals(meshdata))
+        meshdata = extract_surface(meshdata, resolution);
     else
     {
         // mirror meshdata (done by CPU)
@@ -187,7 +195,7 @@ int main(int argc, char* argv[])
 
     vtkNew<vtkPolyDataMapper> meshMapper;
     vtkNew<vtkActor> meshActor;
-    if (argc == 3)
+    if (has_texture)
     {
         vtkNew<vtkImageReader2Factory> readerFactory;
         vtkSmartPointer<vtkImageReader2> textureFile;
@@ -278,6 +286,8 @@ int main(int argc, char* argv[])
     renderWindowInteractor->SetInteractorStyle(style);
 
     renderer->AddActor(meshActor);
+    // decimated levels are built in the background, drawn while rotating large scans
+    auto lod = SetupMeshLOD(meshActor, renderer, renderWindowInteractor);
 
     vtkNew<vtkCubeAxesActor> cubeAxisActor;
     cubeAxisActor->SetUseTextActor3D(1);
@@ -0,0 +1,418 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+#include <vtkPoints.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkCellArray.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "point_normals.h"
+#include "sparse_sdf.h"
+#include "xyz_reader.h"
+
+namespace
+{
+    // Out of core version of gen_mesh's extract_surface for scans larger than memory: .xyz text in, binary PLY
+    // (positions, normals, texture coordinates over the xy bounds) out, peak memory set by the tile size. The
+    // distance is a sparse narrow band (SparseSignedDistance), there is no hole filling like vtkExtractSurface's.
+    //  1. the text is streamed twice (StreamXYZPoints): once for the point count and bounds, once to spill every
+    //     point into a binary file per tile it falls in; the tiles split the xy bounds into columns, each with a
+    //     core of whole bricks and an overlap of two band radii and two voxels around it
+    //  2. the tile size follows the memory budget: the budget is split over as many concurrent tiles as keep the
+    //     cores at least four overlaps wide, and tiles are meshed that many at a time in parallel
+    //  3. a tile is meshed on its own: PointNormalEstimation, then SparseSignedDistance on the grid shared by all
+    //     tiles, so every voxel near a core border gets the same distance in both tiles that see it, and surface
+    //     nets restricted to the core
+    //  4. vertices of core cells go straight to the PLY, triangles to a side file; the quads along the lower core
+    //     borders use vertices of the neighbouring tiles, they are resolved by cell through the vertices kept of
+    //     the upper core borders once every tile is done, which welds the seams
+    // The normals of a tile are oriented on their own (graph traversal from its highest points), which is
+    // consistent between tiles for open height scans, the input of gen_mesh. The PLY is little endian and indexes
+    // its vertices with 32 bit ints, Execute fails on surfaces with more vertices than that.
+    class TiledSurfaceReconstruction
+    {
+    public:
+        void SetMemoryBudget(size_t bytes) { m_budget = std::max<size_t>(bytes, 1 << 20); }
+
+        // voxels along the longest side of the whole scan
+        void SetDimension(int dimension) { m_dimension = std::max(dimension, 2); }
+
+        // neighbours of the normal estimation
+        void SetSampleSize(int size) { m_sample_size = std::max(size, 3); }
+
+        int GetNumberOfTiles() const { return m_tiles[0] * m_tiles[1]; }
+
+        int GetConcurrency() const { return m_concurrency; }
+
+        std::int64_t GetNumberOfVertices() const { return m_vertices; }
+
+        std::int64_t GetNumberOfTriangles() const { return m_triangles; }
+
+        bool Execute(const char* xyz_file, const char* ply_file)
+        {
+            m_vertices = m_triangles = 0;
+            m_overflow = false;
+            m_seam.clear();
+            m_deferred.clear();
+
+            // point count and bounds
+            std::mutex mutex;
+            vtkIdType count = 0;
+            double bounds[6];
+            for (int i = 0; i < 3; i++)
+            {
+                bounds[i * 2] = std::numeric_limits<double>::max();
+                bounds[i * 2 + 1] = std::numeric_limits<double>::lowest();
+            }
+            auto const measured = StreamXYZPoints(xyz_file, [&](float const* xyz, vtkIdType n) {
+                float lo[3]{xyz[0], xyz[1], xyz[2]}, hi[3]{xyz[0], xyz[1], xyz[2]};
+                for (vtkIdType i = 0; i < n; i++)
+                    for (int c = 0; c < 3; c++)
+                    {
+                        lo[c] = std::min(lo[c], xyz[i * 3 + c]);
+                        hi[c] = std::max(hi[c], xyz[i * 3 + c]);
+                    }
+                std::lock_guard<std::mutex> lock(mutex);
+                count += n;
+                for (int c = 0; c < 3; c++)
+                {
+                    bounds[c * 2] = std::min<double>(bounds[c * 2], lo[c]);
+                    bounds[c * 2 + 1] = std::max<double>(bounds[c * 2 + 1], hi[c]);
+                }
+            });
+            if (!measured || count == 0 || !Layout(bounds, count)) return false;
+
+            m_spill_path = std::string(ply_file) + ".tiles";
+            std::error_code ec;
+            std::filesystem::create_directories(m_spill_path, ec);
+            if (ec) return false;
+            auto const opened = Spill(xyz_file) && OpenPly(ply_file);
+            auto written = false;
+            if (opened)
+            {
+                auto const tiles = GetNumberOfTiles();
+                for (int first = 0; first < tiles; first += m_concurrency)
+                    vtkSMPTools::For(first, std::min(first + m_concurrency, tiles), 1,
+                                     [&](vtkIdType begin, vtkIdType end) {
+                                         for (auto t = begin; t < end; t++)
+                                             MeshTile(static_cast<int>(t));
+                                     });
+                written = ClosePly();
+            }
+            // a PLY truncated by this run but not completed is removed rather than left half written
+            auto const truncated = m_ply.is_open();
+            m_ply.close();
+            m_faces.close();
+            std::filesystem::remove_all(m_spill_path, ec);
+            auto const succeeded = opened && written && !m_overflow;
+            if (truncated && !succeeded) std::filesystem::remove(ply_file, ec);
+            return succeeded;
+        }
+
+    private:
+        // spacing, band radius and grid from the bounds, the tiles and their concurrency from the budget
+        bool Layout(double const bounds[6], vtkIdType count)
+        {
+            constexpr int bs = SparseSignedDistance::brick_size;
+            auto const longest = std::max({bounds[1] - bounds[0], bounds[3] - bounds[2], bounds[5] - bounds[4]});
+            if (!(longest > 0)) return false;
+            m_spacing = longest / (m_dimension - 1);
+            // SparseSignedDistance's automatic radius with the point spacing of an even xy scan
+            auto const area = std::max((bounds[1] - bounds[0]) * (bounds[3] - bounds[2]), longest * m_spacing);
+            m_radius = std::max(4 * m_spacing, 3 * std::sqrt(area / count));
+            m_overlap = 2 * m_radius + 2 * m_spacing;
+            for (int i = 0; i < 3; i++)
+            {
+                m_origin[i] = bounds[i * 2] - m_radius - m_spacing;
+                m_bounds[i * 2] = bounds[i * 2];
+                m_bounds[i * 2 + 1] = bounds[i * 2 + 1];
+            }
+
+            // bytes per unit of xy area: the points with normals, locator and spill copy, and per surface cell the
+            // band of distances (rounded up to bricks) and the mesh
+            auto const band_voxels = 2 * m_radius / m_spacing + 2 * bs;
+            auto const per_area = count / area * 96 + (4 * band_voxels + 128) / (m_spacing * m_spacing);
+            auto const core_side = [&](double bytes) { return std::sqrt(bytes / per_area) - 2 * m_overlap; };
+            m_concurrency = std::max(vtkSMPTools::GetEstimatedNumberOfThreads(), 1);
+            while (m_concurrency > 1 && core_side(static_cast<double>(m_budget) / m_concurrency) < 4 * m_overlap)
+                m_concurrency /= 2;
+            auto const side = std::max(core_side(static_cast<double>(m_budget) / m_concurrency), 4 * m_overlap);
+            m_tile_cells = std::max(static_cast<int>(side / m_spacing) / bs, 1) * bs;
+            for (int i = 0; i < 2; i++)
+            {
+                auto const cells =
+                    static_cast<int>(std::ceil((bounds[i * 2 + 1] + m_radius - m_origin[i]) / m_spacing)) + 2;
+                m_tiles[i] = (cells + m_tile_cells - 1) / m_tile_cells;
+            }
+            m_concurrency = std::min(m_concurrency, GetNumberOfTiles());
+            return true;
+        }
+
+        std::string TilePath(int tile) const { return m_spill_path + "/tile_" + std::to_string(tile) + ".bin"; }
+
+        // every point into the spill file of each tile whose core plus overlap holds it
+        bool Spill(const char* xyz_file)
+        {
+            auto const tiles = GetNumberOfTiles();
+            std::unique_ptr<std::mutex[]> locks(new std::mutex[tiles]);
+            for (int t = 0; t < tiles; t++)
+                std::ofstream(TilePath(t), std::ios::binary | std::ios::trunc);
+            auto const tile_size = m_tile_cells * m_spacing;
+            std::atomic<bool> ok{true};
+            auto const streamed = StreamXYZPoints(xyz_file, [&](float const* xyz, vtkIdType n) {
+                std::vector<std::vector<float>> buckets(tiles);
+                for (vtkIdType i = 0; i < n; i++)
+                {
+                    auto const* p = xyz + i * 3;
+                    int lo[2], hi[2];
+                    for (int c = 0; c < 2; c++)
+                    {
+                        lo[c] = std::max(static_cast<int>((p[c] - m_overlap - m_origin[c]) / tile_size), 0);
+                        hi[c] = std::min(static_cast<int>((p[c] + m_overlap - m_origin[c]) / tile_size),
+                                         m_tiles[c] - 1);
+                    }
+                    for (int y = lo[1]; y <= hi[1]; y++)
+                        for (int x = lo[0]; x <= hi[0]; x++)
+                            buckets[y * m_tiles[0] + x].insert(buckets[y * m_tiles[0] + x].end(), p, p + 3);
+                }
+                for (int t = 0; t < tiles; t++)
+                {
+                    if (buckets[t].empty()) continue;
+                    std::lock_guard<std::mutex> lock(locks[t]);
+                    std::ofstream out(TilePath(t), std::ios::binary | std::ios::app);
+                    out.write(reinterpret_cast<char const*>(buckets[t].data()), buckets[t].size() * sizeof(float));
+                    if (!out) ok = false;
+                }
+            });
+            return streamed && ok;
+        }
+
+        void MeshTile(int tile)
+        {
+            auto const path = TilePath(tile);
+            std::error_code ec;
+            auto const count = static_cast<vtkIdType>(std::filesystem::file_size(path, ec) / (3 * sizeof(float)));
+            if (ec || count < 3 || m_overflow)
+            {
+                std::filesystem::remove(path, ec);
+                return;
+            }
+            vtkNew<vtkFloatArray> coords;
+            coords->SetNumberOfComponents(3);
+            coords->SetNumberOfTuples(count);
+            {
+                std::ifstream in(path, std::ios::binary);
+                in.read(reinterpret_cast<char*>(coords->GetPointer(0)), count * 3 * sizeof(float));
+            }
+            std::filesystem::remove(path, ec);
+            vtkNew<vtkPoints> points;
+            points->SetData(coords);
+            auto polydata = vtkSmartPointer<vtkPolyData>::New();
+            polydata->SetPoints(points);
+
+            PointNormalEstimation normals;
+            normals.SetSampleSize(m_sample_size);
+            normals.SetOrientationToGraphTraversal();
+            auto oriented = normals.Execute(polydata);
+
+            SparseSignedDistance distance;
+            distance.SetGrid(m_origin, m_spacing);
+            distance.SetRadius(m_radius);
+            if (!distance.Execute(oriented, normals.GetLocator())) return;
+
+            auto const x = tile % m_tiles[0], y = tile / m_tiles[0];
+            int const core[6]{x * m_tile_cells, (x + 1) * m_tile_cells, y * m_tile_cells, (y + 1) * m_tile_cells,
+                              0, INT_MAX};
+            std::vector<std::uint64_t> keys;
+            auto surface = distance.ExtractSurface(core, &keys);
+            Write(surface, keys, core);
+        }
+
+        // vertices of the core cells into the PLY, triangles into the side file or, when they use a vertex of a
+        // neighbouring tile, kept for the end
+        void Write(vtkPolyData* surface, std::vector<std::uint64_t> const& keys, int const core[6])
+        {
+            auto const count = surface->GetNumberOfPoints();
+            auto* normals = surface->GetPointData()->GetNormals();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_overflow) return;
+
+            std::vector<std::int64_t> ids(count, -1);
+            std::vector<float> records;
+            records.reserve(count * 8);
+            for (vtkIdType i = 0; i < count; i++)
+            {
+                int cell[3];
+                SparseSignedDistance::Unpack(keys[i], cell);
+                // the layer below the core belongs to the tiles at -x and -y
+                if (cell[0] < core[0] || cell[1] < core[2]) continue;
+                // the PLY indexes with 32 bit ints, give up rather than wrap
+                if (m_vertices > std::numeric_limits<std::int32_t>::max())
+                {
+                    m_overflow = true;
+                    return;
+                }
+                ids[i] = m_vertices++;
+                if (cell[0] == core[1] - 1 || cell[1] == core[3] - 1) m_seam.emplace(keys[i], ids[i]);
+                double p[3], n[3];
+                surface->GetPoint(i, p);
+                normals->GetTuple(i, n);
+                records.insert(records.end(), {static_cast<float>(p[0]), static_cast<float>(p[1]),
+                                               static_cast<float>(p[2]), static_cast<float>(n[0]),
+                                               static_cast<float>(n[1]), static_cast<float>(n[2])});
+                // like vtkTextureMapToPlane over the xy bounds
+                records.push_back(static_cast<float>((p[0] - m_bounds[0]) / (m_bounds[1] - m_bounds[0])));
+                records.push_back(static_cast<float>((p[1] - m_bounds[2]) / (m_bounds[3] - m_bounds[2])));
+            }
+            m_ply.write(reinterpret_cast<char const*>(records.data()), records.size() * sizeof(float));
+
+            std::vector<std::int32_t> faces;
+            auto* polys = surface->GetPolys();
+            vtkIdType size;
+            vtkIdType const* corners;
+            polys->InitTraversal();
+            while (polys->GetNextCell(size, corners))
+            {
+                if (ids[corners[0]] >= 0 && ids[corners[1]] >= 0 && ids[corners[2]] >= 0)
+                {
+                    for (int k = 0; k < 3; k++)
+                        faces.push_back(static_cast<std::int32_t>(ids[corners[k]]));
+                    continue;
+                }
+                Deferred deferred;
+                for (int k = 0; k < 3; k++)
+                {
+                    auto const foreign = ids[corners[k]] < 0;
+                    deferred.refs[k] = foreign ? keys[corners[k]] : static_cast<std::uint64_t>(ids[corners[k]]);
+                    deferred.foreign |= foreign << k;
+                }
+                m_deferred.push_back(deferred);
+            }
+            m_faces.write(reinterpret_cast<char const*>(faces.data()), faces.size() * sizeof(std::int32_t));
+            m_triangles += static_cast<std::int64_t>(faces.size() / 3);
+        }
+
+        // header with room for the final counts, patched by ClosePly
+        bool OpenPly(const char* ply_file)
+        {
+            m_ply.open(ply_file, std::ios::binary | std::ios::trunc);
+            m_faces.open(m_spill_path + "/faces.bin", std::ios::binary | std::ios::trunc);
+            if (!m_ply || !m_faces) return false;
+            m_ply << "ply\nformat binary_little_endian 1.0\nelement vertex ";
+            m_vertex_count_at = m_ply.tellp();
+            m_ply << std::string(count_width, ' ') << "\n";
+            for (auto const* name : {"x", "y", "z", "nx", "ny", "nz", "u", "v"})
+                m_ply << "property float " << name << "\n";
+            m_ply << "element face ";
+            m_face_count_at = m_ply.tellp();
+            m_ply << std::string(count_width, ' ') << "\nproperty list uchar int vertex_indices\nend_header\n";
+            return m_ply.good();
+        }
+
+        // seam triangles, then the faces behind the vertices and the counts into the header; false when a write
+        // failed
+        bool ClosePly()
+        {
+            std::vector<std::int32_t> faces;
+            for (auto const& deferred : m_deferred)
+            {
+                std::int32_t ids[3];
+                bool complete = true;
+                for (int k = 0; k < 3 && complete; k++)
+                {
+                    if (!(deferred.foreign >> k & 1))
+                    {
+                        ids[k] = static_cast<std::int32_t>(deferred.refs[k]);
+                        continue;
+                    }
+                    auto const it = m_seam.find(deferred.refs[k]);
+                    complete = it != m_seam.end();
+                    if (complete) ids[k] = static_cast<std::int32_t>(it->second);
+                }
+                if (complete) faces.insert(faces.end(), ids, ids + 3);
+            }
+            m_faces.write(reinterpret_cast<char const*>(faces.data()), faces.size() * sizeof(std::int32_t));
+            m_triangles += static_cast<std::int64_t>(faces.size() / 3);
+            m_faces.close();
+            m_seam.clear();
+            m_deferred.clear();
+            if (!m_faces || m_overflow) return false;
+
+            std::ifstream in(m_spill_path + "/faces.bin", std::ios::binary);
+            std::vector<std::int32_t> batch(3 << 16);
+            std::vector<char> records;
+            while (in)
+            {
+                in.read(reinterpret_cast<char*>(batch.data()), batch.size() * sizeof(std::int32_t));
+                auto const triangles = static_cast<size_t>(in.gcount()) / (3 * sizeof(std::int32_t));
+                records.resize(triangles * (1 + 3 * sizeof(std::int32_t)));
+                for (size_t i = 0; i < triangles; i++)
+                {
+                    auto* record = records.data() + i * (1 + 3 * sizeof(std::int32_t));
+                    record[0] = 3;
+                    std::memcpy(record + 1, batch.data() + i * 3, 3 * sizeof(std::int32_t));
+                }
+                m_ply.write(records.data(), records.size());
+            }
+            m_ply.seekp(m_vertex_count_at);
+            m_ply << m_vertices;
+            m_ply.seekp(m_face_count_at);
+            m_ply << m_triangles;
+            m_ply.close();
+            return m_ply.good();
+        }
+
+    private:
+        // a triangle with vertices of a neighbouring tile: global vertex ids, or cell keys where foreign is set
+        struct Deferred
+        {
+            std::uint64_t refs[3];
+            unsigned char foreign = 0;
+        };
+
+        static constexpr int count_width = 20;
+
+        size_t m_budget = size_t(4) << 30;
+        int m_dimension = 4096;
+        int m_sample_size = 10;
+
+        double m_bounds[6]{0, 0, 0, 0, 0, 0};
+        double m_origin[3]{0, 0, 0};
+        double m_spacing = 1;
+        double m_radius = 1;
+        double m_overlap = 1;
+        int m_tile_cells = SparseSignedDistance::brick_size;
+        int m_tiles[2]{1, 1};
+        int m_concurrency = 1;
+
+        std::string m_spill_path;
+        std::mutex m_mutex;
+        std::ofstream m_ply, m_faces;
+        std::streampos m_vertex_count_at, m_face_count_at;
+        std::int64_t m_vertices = 0;
+        std::int64_t m_triangles = 0;
+        std::atomic<bool> m_overflow{false}; // more vertices than 32 bit PLY indices address
+        std::unordered_map<std::uint64_t, std::int64_t> m_seam; // cell key -> vertex, upper core borders
+        std::vector<Deferred> m_deferred;
+    };
+} // namespace
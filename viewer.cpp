@@ -20,6 +20,9 @@
 #include <filesystem>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+
+#include "slab_projection.h"
 
 //#define DISPLAY_FPS
 
@@ -33,6 +36,7 @@ public:
     void setImageViewer(vtkImageViewer2* imageViewer, int slice_no = 0)
     {
         m_viewer = imageViewer;
+        m_volume = imageViewer->GetInput();
         m_slice_min = imageViewer->GetSliceMin();
         m_slice_max = imageViewer->GetSliceMax();
         m_slice = slice_no <= 0 ? (m_slice_min + m_slice_max) / 2 : slice_no;
@@ -47,6 +51,12 @@ public:
         ShowSliceText();
     }
 
+    void setSlabProjector(SlabProjector* slab)
+    {
+        m_slab = slab;
+        m_slab->SetInputData(m_volume);
+    }
+
     void setAutoWL()
     {
         if (!m_set_auto_wl)
@@ -68,8 +78,7 @@ private:
         {
             m_slice += 1;
 
-            m_viewer->SetSlice(m_slice);
-            ShowSliceText();
+            updateSlice();
         }
     }
 
@@ -79,25 +88,67 @@ private:
         {
             m_slice -= 1;
 
-            m_viewer->SetSlice(m_slice);
-            ShowSliceText();
+            updateSlice();
+        }
+    }
+
+    // show the slab around m_slice, or the plain slice when the slab is off
+    void updateSlice()
+    {
+        if (m_slab)
+        {
+            if (auto* slab = m_slab->Project(m_viewer->GetSliceOrientation(), m_slice); slab)
+            {
+                if (m_viewer->GetInput() != slab) m_viewer->SetInputData(slab);
+            }
+            else if (m_viewer->GetInput() != m_volume)
+                m_viewer->SetInputData(m_volume);
         }
+        m_viewer->SetSlice(m_slice);
+        ShowSliceText();
+    }
+
+    void setSliceOrientation(int orientation)
+    {
+        // the range of the new orientation comes from the volume, not from the current slab
+        m_viewer->SetInputData(m_volume);
+        m_viewer->SetSliceOrientation(orientation);
+        m_slice_min = m_viewer->GetSliceMin();
+        m_slice_max = m_viewer->GetSliceMax();
+        m_slice = m_viewer->GetSlice();
+        updateSlice();
     }
 
     void OnChar() override
     {
-        if (Interactor->GetKeyCode() == 'x')
-            m_viewer->SetSliceOrientationToYZ();
-        else if (Interactor->GetKeyCode() == 'y')
-            m_viewer->SetSliceOrientationToXZ();
-        else if (Interactor->GetKeyCode() == 'z')
-            m_viewer->SetSliceOrientationToXY();
+        auto key = Interactor->GetKeyCode();
+        if (key == 'x')
+            setSliceOrientation(vtkImageViewer2::SLICE_ORIENTATION_YZ);
+        else if (key == 'y')
+            setSliceOrientation(vtkImageViewer2::SLICE_ORIENTATION_XZ);
+        else if (key == 'z')
+            setSliceOrientation(vtkImageViewer2::SLICE_ORIENTATION_XY);
+        else if (m_slab && key == 'm') // cycle thick slab mode: off -> MIP -> MinIP -> Mean
+        {
+            m_slab->SetMode(static_cast<SlabMode>((static_cast<int>(m_slab->GetMode()) + 1) % 4));
+            updateSlice();
+        }
+        else if (m_slab && (key == '+' || key == '-')) // slab thickness in 5 mm steps
+        {
+            m_slab->SetThickness(std::clamp(m_slab->GetThickness() + (key == '+' ? 5.0 : -5.0), 5.0, 30.0));
+            updateSlice();
+        }
+        else
+            return;
+        m_viewer->Render();
     }
 
     void ShowSliceText()
     {
         std::stringstream ss;
         ss << m_slice << " / " << m_slice_max;
+        if (m_slab && m_slab->GetMode() != SlabMode::Off)
+            ss << "\n" << SlabModeName(m_slab->GetMode()) << " " << m_slab->GetThickness() << " mm";
         m_text->SetText(vtkCornerAnnotation::LowerRight, ss.str().c_str());
     }
 
@@ -134,6 +185,8 @@ private:
 
 private:
     vtkImageViewer2* m_viewer;
+    vtkImageData* m_volume = nullptr;
+    SlabProjector* m_slab = nullptr;
     int m_slice;
     int m_slice_min;
     int m_slice_max;
@@ -197,6 +250,9 @@ int main(int argc, char* argv[])
     vtkNew<myInteractorStyler> style;
     style->setImageViewer(viewer);
     style->setAutoWL();
+    // thick slab MIP/MinIP/Mean, 'm' switches the mode and '+'/'-' change the thickness
+    SlabProjector slab;
+    style->setSlabProjector(&slab);
     viewer->SetupInteractor(interactor);
     interactor->SetInteractorStyle(style);
 
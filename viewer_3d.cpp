@@ -35,6 +35,8 @@
 #include <fstream>
 #include <string>
 
+#include "mesh_lod.h"
+
 #define WITH_PATH
 
 vtkSmartPointer<vtkPolyData> ReadPolyData(const char* fileName)
@@ -145,17 +147,44 @@ protected:
             rwi->Render();
         }
     }
+    // the wheel steps along the path are one interaction, like a rotation, that ends once the wheel stayed idle
+    // for path_idle_ms: observers of the interaction (SetupMeshLOD) see it start and end, and the final frame is
+    // rendered after the end like vtkInteractorStyle::StopState does
+    void OnTimer() override
+    {
+        if (m_path_timer < 0 || Interactor->GetTimerEventId() != m_path_timer)
+        {
+            Superclass::OnTimer();
+            return;
+        }
+        endPathInteraction();
+    }
     virtual void moveCameraToNthPos(int n)
     {
+        if (m_path_timer < 0)
+            InvokeEvent(vtkCommand::StartInteractionEvent, nullptr);
+        else
+            Interactor->DestroyTimer(m_path_timer);
         auto* renderer = Interactor->GetRenderWindow()->GetRenderers()->GetFirstRenderer();
         auto* camera = renderer->GetActiveCamera();
         camera->SetPosition(m_path_data->GetPoint(n));
         camera->SetFocalPoint(m_path_data->GetPoint(n + 1));
         Interactor->Render();
+        m_path_timer = Interactor->CreateOneShotTimer(path_idle_ms);
+        if (m_path_timer <= 0) endPathInteraction();
     }
+    void endPathInteraction()
+    {
+        m_path_timer = -1;
+        InvokeEvent(vtkCommand::EndInteractionEvent, nullptr);
+        Interactor->Render();
+    }
+
+    static constexpr unsigned long path_idle_ms = 150;
 
     vtkPoints* m_path_data = nullptr;
     int m_current_camera_pos_index = 0;
+    int m_path_timer = -1;
 };
 vtkStandardNewMacro(myCameraMotionInteractorStyle);
 
@@ -358,7 +387,8 @@ int main(int argc, char* argv[])
     // fps
     DisplayFPS(m_renderer);
     // model
-    m_renderer->AddActor(GetObjActor(model_data));
+    auto obj_actor = GetObjActor(model_data);
+    m_renderer->AddActor(obj_actor);
 
 #ifdef WITH_PATH
     vtkNew<vtkPoints> m_path_points;
@@ -394,6 +424,8 @@ int main(int argc, char* argv[])
     vtkNew<vtkInteractorStyleTrackballCamera> style;
 #endif
     interactor->SetInteractorStyle(style);
+    // decimated levels are built in the background, drawn while rotating large models
+    auto lod = SetupMeshLOD(obj_actor, m_renderer, interactor);
 
     vtkNew<vtkRenderWindow> m_render_window;
     m_render_window->SetSize(500, 500);
@@ -39,6 +39,8 @@
 #include <filesystem>
 #include <iostream>
 
+#include "volume_lod.h"
+
 /*
 vtkImagePlaneWidget interaction with mouse:
 1. mouse wheel + cursor motion -> change widget orientation and position
@@ -373,6 +375,9 @@ int main(int argc, char* argv[])
 
     style->set_volume(volume);
 
+    // coarser copies of the volume, built in the background, rendered while rotating when a frame goes over budget
+    auto volume_lod = SetupVolumeLOD(volume, renderer, interactor);
+
     vtkNew<vtkCameraOrientationWidget> cam_orient_manipulator;
     cam_orient_manipulator->SetParentRenderer(renderer);
     vtkCameraOrientationRepresentation::SafeDownCast(cam_orient_manipulator->GetRepresentation())->AnchorToLowerRight();
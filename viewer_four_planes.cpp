@@ -34,9 +34,17 @@
 #include <string>
 #include <filesystem>
 #include <array>
+#include <algorithm>
+
+#include "brick_volume.h"
+#include "slab_projection.h"
 
 //#define M_DEBUG
 
+// feed the three slice viewers from a bricked copy of the volume, YZ/XZ slices are as cheap as XY ones but the
+// volume is held twice
+//#define USE_BRICKED_VOLUME
+
 class myCameraMotionInteractorStyle: public vtkInteractorStyleTrackballCamera
 {
 public:
@@ -58,13 +66,18 @@ public:
     }
 
     void setImageViewers(vtkImageViewer2* sagittal_viewer, vtkImageViewer2* coronal_viewer,
-                         vtkImageViewer2* axial_viewer)
+                         vtkImageViewer2* axial_viewer, vtkImageData* volume)
     {
         m_image_viewers[0] = sagittal_viewer;
         m_image_viewers[1] = coronal_viewer;
         m_image_viewers[2] = axial_viewer;
 
-        auto* dims = m_image_viewers[0]->GetInput()->GetDimensions();
+        // the viewers may only hold a single slab, take the extent from the whole volume
+        m_volume = volume;
+        auto* dims = volume->GetDimensions();
+        volume->GetSpacing(m_spacing);
+        for (auto i = 0; i < 3; i++)
+            m_slice_no[i] = m_image_viewers[i]->GetSlice();
 
         // YZ
         m_crossline_sources[0] = vtkSmartPointer<vtkLineSource>::New();
@@ -112,7 +125,45 @@ public:
         }
     }
 
+#ifdef USE_BRICKED_VOLUME
+    void setBrickedVolume(BrickedVolume* bricks) { m_bricks = bricks; }
+#endif
+
+    void setSlabProjector(SlabProjector* slab)
+    {
+        m_slab = slab;
+        m_slab->SetInputData(m_volume);
+    }
+
+    // slab mode and thickness in the upper left corner of the 3d view, next to the fps
+    void setSlabAnnotation(vtkCornerAnnotation* annotation)
+    {
+        m_slab_annotation = annotation;
+        updateSlabAnnotation();
+    }
+
 protected:
+    void OnChar() override
+    {
+        auto key = Interactor->GetKeyCode();
+        if (m_slab && key == 'm') // cycle thick slab mode: off -> MIP -> MinIP -> Mean
+            m_slab->SetMode(static_cast<SlabMode>((static_cast<int>(m_slab->GetMode()) + 1) % 4));
+        else if (m_slab && (key == '+' || key == '-')) // slab thickness in 5 mm steps
+            m_slab->SetThickness(std::clamp(m_slab->GetThickness() + (key == '+' ? 5.0 : -5.0), 5.0, 30.0));
+        else
+        {
+            Superclass::OnChar();
+            return;
+        }
+        updateSlabAnnotation();
+        for (auto i = 0; i < 3; i++)
+        {
+            setSlice(i, m_slice_no[i]);
+            m_image_viewers[i]->Render();
+        }
+        Interactor->Render();
+    }
+
     void OnMouseWheelForward() override
     {
         if (m_current_camera_pos_index < m_path_data->GetNumberOfPoints() - 1)
@@ -124,6 +175,16 @@ protected:
     }
 
 private:
+    void updateSlabAnnotation()
+    {
+        if (!m_slab || !m_slab_annotation) return;
+        // same text as viewer's, nothing while the slab is off
+        std::ostringstream out;
+        if (m_slab->GetMode() != SlabMode::Off)
+            out << SlabModeName(m_slab->GetMode()) << " " << m_slab->GetThickness() << " mm";
+        m_slab_annotation->SetText(vtkCornerAnnotation::UpperLeft, out.str().c_str());
+    }
+
     void moveCameraToNthPos(int n)
     {
         auto* camera = m_renderer->GetActiveCamera();
@@ -134,18 +195,31 @@ private:
         auto slice_no = point_to_slice(tgt_pos);
         for (auto i = 0; i < 3; i++)
         {
-            m_image_viewers[i]->SetSlice(slice_no[i]);
+            setSlice(i, slice_no[i]);
             draw_cross_line(tgt_pos, i);
         }
 
         Interactor->Render();
     }
 
+    // viewer i shows orientation i (YZ, XZ, XY), fed by the thick slab when it is on
+    void setSlice(int i, int slice)
+    {
+        m_slice_no[i] = slice;
+        vtkImageData* input = m_slab ? m_slab->Project(i, slice) : nullptr;
+#ifdef USE_BRICKED_VOLUME
+        if (!input) input = m_bricks->GetSlice(i, slice);
+#else
+        if (!input) input = m_volume;
+#endif
+        if (m_image_viewers[i]->GetInput() != input) m_image_viewers[i]->SetInputData(input);
+        m_image_viewers[i]->SetSlice(slice);
+    }
+
     [[nodiscard]] std::array<int, 3> point_to_slice(double* point) const
     {
-        auto* spacing = m_image_viewers[0]->GetInput()->GetSpacing();
-        return {static_cast<int>(point[0] / spacing[0]), static_cast<int>(point[1] / spacing[1]),
-                static_cast<int>(point[2] / spacing[2])};
+        return {static_cast<int>(point[0] / m_spacing[0]), static_cast<int>(point[1] / m_spacing[1]),
+                static_cast<int>(point[2] / m_spacing[2])};
     }
 
     void draw_cross_line(double* point, int viewer_idx)
@@ -210,6 +284,14 @@ private:
     int m_current_camera_pos_index = 0;
 
     vtkImageViewer2* m_image_viewers[3]{};
+    double m_spacing[3]{1, 1, 1};
+    int m_slice_no[3]{};
+    vtkImageData* m_volume = nullptr;
+    SlabProjector* m_slab = nullptr;
+    vtkCornerAnnotation* m_slab_annotation = nullptr;
+#ifdef USE_BRICKED_VOLUME
+    BrickedVolume* m_bricks = nullptr;
+#endif
 
 #ifdef M_DEBUG
     vtkSmartPointer<vtkSphereSource> m_sphere = {};
@@ -350,9 +432,27 @@ int main(int argc, char* argv[])
     style->setPathPoints(path_data);
     obj_interactor->SetInteractorStyle(style);
 
+#ifdef USE_BRICKED_VOLUME
+    BrickedVolume bricks;
+    bricks.SetInputData(dicom_reader->GetOutput());
+    std::cout << "bricked volume: " << bricks.GetMemorySize() / (1024 * 1024) << " MB" << std::endl;
+    int volume_center[3];
+    for (auto i = 0; i < 3; i++)
+    {
+        int range[2];
+        bricks.GetSliceRange(i, range);
+        volume_center[i] = (range[0] + range[1]) / 2;
+    }
+    style->setBrickedVolume(&bricks);
+#endif
+
     // sagittal viewer
     vtkNew<vtkImageViewer2> sagittal_viewer;
+#ifdef USE_BRICKED_VOLUME
+    sagittal_viewer->SetInputData(bricks.GetSlice(vtkImageViewer2::SLICE_ORIENTATION_YZ, volume_center[0]));
+#else
     sagittal_viewer->SetInputConnection(dicom_reader->GetOutputPort());
+#endif
     sagittal_viewer->GetWindowLevel()->SetWindow(500);
     sagittal_viewer->SetSliceOrientationToYZ();
     // correct orientation
@@ -364,7 +464,11 @@ int main(int argc, char* argv[])
 
     // coronal viewer
     vtkNew<vtkImageViewer2> coronal_viewer;
+#ifdef USE_BRICKED_VOLUME
+    coronal_viewer->SetInputData(bricks.GetSlice(vtkImageViewer2::SLICE_ORIENTATION_XZ, volume_center[1]));
+#else
     coronal_viewer->SetInputConnection(dicom_reader->GetOutputPort());
+#endif
     coronal_viewer->GetWindowLevel()->SetWindow(500);
     coronal_viewer->SetSliceOrientationToXZ();
     // correct orientation
@@ -384,7 +488,11 @@ int main(int argc, char* argv[])
 
     // axial viewer
     vtkNew<vtkImageViewer2> axial_viewer;
+#ifdef USE_BRICKED_VOLUME
+    axial_viewer->SetInputData(bricks.GetSlice(vtkImageViewer2::SLICE_ORIENTATION_XY, volume_center[2]));
+#else
     axial_viewer->SetInputConnection(dicom_reader->GetOutputPort());
+#endif
     axial_viewer->GetWindowLevel()->SetWindow(500);
     axial_viewer->SetSliceOrientationToXY();
     axial_viewer->Render();
@@ -396,7 +504,11 @@ int main(int argc, char* argv[])
     sagittal_viewer->GetRenderWindow()->SetInteractor(it);
 #endif
 
-    style->setImageViewers(sagittal_viewer, coronal_viewer, axial_viewer);
+    style->setImageViewers(sagittal_viewer, coronal_viewer, axial_viewer, dicom_reader->GetOutput());
+    // thick slab MIP/MinIP/Mean on the three slice viewers, 'm' switches the mode and '+'/'-' change the thickness
+    SlabProjector slab;
+    style->setSlabProjector(&slab);
+    style->setSlabAnnotation(corner_overlay);
 
     vtkNew<vtkRenderWindow> m_render_window;
     m_render_window->SetSize(500, 500);
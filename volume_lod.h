@@ -0,0 +1,299 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkWeakPointer.h>
+#include <vtkObjectFactory.h>
+#include <vtkCommand.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkSMPTools.h>
+#include <vtkVolume.h>
+#include <vtkVolumeMapper.h>
+#include <vtkFixedPointVolumeRayCastMapper.h>
+#include <vtkGPUVolumeRayCastMapper.h>
+#include <vtkSmartVolumeMapper.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkInteractorObserver.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    // Downsampled copies of a volume: level k averages 2^k x 2^k x 2^k voxels of the input (level 0 is the input
+    // itself). BuildAsync returns at once, the levels are built one after the other on a background thread
+    // (each level in parallel from the previous one) and become available through GetLevel as they are done.
+    class VolumePyramid
+    {
+    public:
+        VolumePyramid() = default;
+        VolumePyramid(VolumePyramid const&) = delete;
+        VolumePyramid& operator=(VolumePyramid const&) = delete;
+        ~VolumePyramid() { Wait(); }
+
+        void BuildAsync(vtkImageData* img, int levels = 3)
+        {
+            Wait();
+            m_levels.assign(levels + 1, nullptr);
+            m_ready.reset(new std::atomic<bool>[levels + 1]);
+            for (int i = 0; i <= levels; i++)
+                m_ready[i] = false;
+            m_levels[0] = img;
+            m_ready[0] = true;
+            m_worker = std::thread([this, levels]() {
+                for (int i = 1; i <= levels; i++)
+                {
+                    m_levels[i] = Downsample(m_levels[i - 1]);
+                    if (!m_levels[i]) break;
+                    m_ready[i].store(true, std::memory_order_release);
+                }
+            });
+        }
+
+        // block until every level is built
+        void Wait()
+        {
+            if (m_worker.joinable()) m_worker.join();
+        }
+
+        int GetNumberOfLevels() const { return static_cast<int>(m_levels.size()); }
+
+        // nullptr while the level is still being built
+        vtkImageData* GetLevel(int level) const
+        {
+            if (level < 0 || level >= GetNumberOfLevels() || !m_ready[level].load(std::memory_order_acquire))
+                return nullptr;
+            return m_levels[level];
+        }
+
+        // 2x2x2 average (fewer voxels on odd borders), voxel centers at the center of the averaged block
+        static vtkSmartPointer<vtkImageData> Downsample(vtkImageData* img)
+        {
+            if (!img || !img->GetPointData()->GetScalars()) return nullptr;
+            int dims[3], out_dims[3];
+            double origin[3], spacing[3];
+            img->GetDimensions(dims);
+            img->GetOrigin(origin);
+            img->GetSpacing(spacing);
+            for (int i = 0; i < 3; i++)
+            {
+                out_dims[i] = (dims[i] + 1) / 2;
+                // a single voxel axis stays as it is
+                if (dims[i] > 1)
+                {
+                    origin[i] += spacing[i] / 2;
+                    spacing[i] *= 2;
+                }
+            }
+
+            auto out = vtkSmartPointer<vtkImageData>::New();
+            out->SetOrigin(origin);
+            out->SetSpacing(spacing);
+            out->SetDirectionMatrix(img->GetDirectionMatrix());
+            out->SetExtent(0, out_dims[0] - 1, 0, out_dims[1] - 1, 0, out_dims[2] - 1);
+            out->AllocateScalars(img->GetScalarType(), img->GetNumberOfScalarComponents());
+            switch (img->GetScalarType())
+            {
+                vtkTemplateMacro(Average(static_cast<VTK_TT const*>(img->GetScalarPointer()), dims,
+                                         static_cast<VTK_TT*>(out->GetScalarPointer()), out_dims,
+                                         img->GetNumberOfScalarComponents()));
+            default:
+                return nullptr;
+            }
+            return out;
+        }
+
+    private:
+        template <typename T>
+        static void Average(T const* in, int const dims[3], T* out, int const out_dims[3], int components)
+        {
+            auto const nx = static_cast<vtkIdType>(dims[0]), nxy = nx * dims[1];
+            vtkSMPTools::For(0, out_dims[2], [&](vtkIdType begin, vtkIdType end) {
+                std::vector<double> sum(components);
+                for (auto k = begin; k < end; k++)
+                    for (int j = 0; j < out_dims[1]; j++)
+                    {
+                        auto* row = out + ((k * out_dims[1] + j) * out_dims[0]) * components;
+                        for (int i = 0; i < out_dims[0]; i++)
+                        {
+                            std::fill(sum.begin(), sum.end(), 0.0);
+                            int count = 0;
+                            for (auto z = 2 * k; z < std::min<vtkIdType>(2 * k + 2, dims[2]); z++)
+                                for (auto y = 2 * j; y < std::min(2 * j + 2, dims[1]); y++)
+                                    for (auto x = 2 * i; x < std::min(2 * i + 2, dims[0]); x++)
+                                    {
+                                        auto const* voxel = in + (z * nxy + y * nx + x) * components;
+                                        for (int c = 0; c < components; c++)
+                                            sum[c] += voxel[c];
+                                        count++;
+                                    }
+                            for (int c = 0; c < components; c++)
+                            {
+                                auto const mean = sum[c] / count;
+                                row[i * components + c] =
+                                    static_cast<T>(std::is_integral<T>::value ? std::floor(mean + 0.5) : mean);
+                            }
+                        }
+                    }
+            });
+        }
+
+    private:
+        std::vector<vtkSmartPointer<vtkImageData>> m_levels;
+        std::unique_ptr<std::atomic<bool>[]> m_ready;
+        std::thread m_worker;
+    };
+
+    // same rendering settings on a mapper of a coarser level, sample distances scaled by the level spacing
+    void CopyVolumeMapperSettings(vtkVolumeMapper* src, vtkVolumeMapper* dst, double scale)
+    {
+        dst->SetBlendMode(src->GetBlendMode());
+        dst->SetCropping(src->GetCropping());
+        dst->SetCroppingRegionPlanes(src->GetCroppingRegionPlanes());
+        dst->SetCroppingRegionFlags(src->GetCroppingRegionFlags());
+        dst->SetClippingPlanes(src->GetClippingPlanes());
+        if (auto* fixed = vtkFixedPointVolumeRayCastMapper::SafeDownCast(src))
+        {
+            auto* out = vtkFixedPointVolumeRayCastMapper::SafeDownCast(dst);
+            out->SetAutoAdjustSampleDistances(fixed->GetAutoAdjustSampleDistances());
+            out->SetSampleDistance(static_cast<float>(fixed->GetSampleDistance() * scale));
+            out->SetImageSampleDistance(fixed->GetImageSampleDistance());
+        }
+        else if (auto* gpu = vtkGPUVolumeRayCastMapper::SafeDownCast(src))
+        {
+            auto* out = vtkGPUVolumeRayCastMapper::SafeDownCast(dst);
+            out->SetAutoAdjustSampleDistances(gpu->GetAutoAdjustSampleDistances());
+            out->SetSampleDistance(static_cast<float>(gpu->GetSampleDistance() * scale));
+            out->SetImageSampleDistance(gpu->GetImageSampleDistance());
+        }
+        else if (auto* smart = vtkSmartVolumeMapper::SafeDownCast(src))
+        {
+            auto* out = vtkSmartVolumeMapper::SafeDownCast(dst);
+            out->SetRequestedRenderMode(smart->GetRequestedRenderMode());
+            out->SetAutoAdjustSampleDistances(smart->GetAutoAdjustSampleDistances());
+            out->SetSampleDistance(static_cast<float>(smart->GetSampleDistance() * scale));
+        }
+    }
+
+    // Frame budget level of detail for a vtkVolume.
+    // While the interactor style is interacting, the renderer's last render time (the one the FPS overlays show)
+    // picks the pyramid level of the next frame: a frame over budget switches to the next coarser level that is
+    // ready, a frame well under budget (a finer level costs about twice as much) switches back to a finer one.
+    // The time is smoothed over a few frames so a single slow frame does not flip the level. Every level has its
+    // own mapper, switching only swaps the volume's mapper and never re-uploads the data. When the interaction
+    // ends the full resolution comes back for the render the style does then.
+    class MVolumeLOD: public vtkCommand
+    {
+    public:
+        static MVolumeLOD* New();
+        vtkTypeMacro(MVolumeLOD, vtkCommand);
+
+        // the volume's mapper input is level 0, budget in seconds per frame
+        void Setup(vtkVolume* volume, vtkRenderer* renderer, vtkRenderWindowInteractor* interactor,
+                   double budget = 1.0 / 15, int levels = 3)
+        {
+            m_volume = volume;
+            m_budget = budget;
+            m_mappers.assign(levels + 1, nullptr);
+            m_mappers[0] = vtkVolumeMapper::SafeDownCast(volume->GetMapper());
+            if (!m_mappers[0]) return;
+            m_pyramid.BuildAsync(vtkImageData::SafeDownCast(m_mappers[0]->GetDataSetInput()), levels);
+
+            renderer->AddObserver(vtkCommand::EndEvent, this);
+            auto* style = interactor->GetInteractorStyle();
+            style->AddObserver(vtkCommand::StartInteractionEvent, this);
+            style->AddObserver(vtkCommand::EndInteractionEvent, this);
+        }
+
+        int GetLevel() const { return m_level; }
+
+        void Execute(vtkObject* caller, unsigned long eventId, void*) override
+        {
+            if (!m_volume || !m_mappers[0]) return;
+            switch (eventId)
+            {
+            case vtkCommand::StartInteractionEvent:
+                // start where the last interaction settled
+                m_interacting = true;
+                m_smoothed_time = 0;
+                SetLevel(m_interactive_level);
+                break;
+            case vtkCommand::EndInteractionEvent:
+                m_interacting = false;
+                m_interactive_level = m_level;
+                // the style renders right after this event
+                if (m_level != 0) SetLevel(0);
+                break;
+            case vtkCommand::EndEvent:
+                if (m_interacting) Update(static_cast<vtkRenderer*>(caller)->GetLastRenderTimeInSeconds());
+                break;
+            default:
+                break;
+            }
+        }
+
+    private:
+        void Update(double seconds)
+        {
+            m_smoothed_time = m_smoothed_time > 0 ? 0.5 * m_smoothed_time + 0.5 * seconds : seconds;
+            if (m_smoothed_time > m_budget)
+            {
+                for (auto level = m_level + 1; level < m_pyramid.GetNumberOfLevels(); level++)
+                    if (m_pyramid.GetLevel(level))
+                    {
+                        SetLevel(level);
+                        m_smoothed_time = 0;
+                        break;
+                    }
+            }
+            else if (m_level > 0 && 2 * m_smoothed_time < 0.8 * m_budget)
+            {
+                SetLevel(m_level - 1);
+                m_smoothed_time = 0;
+            }
+        }
+
+        void SetLevel(int level)
+        {
+            auto* img = m_pyramid.GetLevel(level);
+            if (!img) return;
+            if (!m_mappers[level])
+            {
+                m_mappers[level].TakeReference(m_mappers[0]->NewInstance());
+                m_mappers[level]->SetInputData(img);
+            }
+            // the full resolution mapper may have changed since (cropping, clipping, sample distances)
+            if (level > 0) CopyVolumeMapperSettings(m_mappers[0], m_mappers[level], 1 << level);
+            m_volume->SetMapper(m_mappers[level]);
+            m_level = level;
+        }
+
+    private:
+        vtkWeakPointer<vtkVolume> m_volume;
+        VolumePyramid m_pyramid;
+        std::vector<vtkSmartPointer<vtkVolumeMapper>> m_mappers;
+        double m_budget = 1.0 / 15;
+        double m_smoothed_time = 0;
+        bool m_interacting = false;
+        int m_level = 0;
+        int m_interactive_level = 0;
+    };
+    vtkStandardNewMacro(MVolumeLOD);
+
+    // build the pyramid of the volume's input in the background and drop to coarser levels while interacting
+    vtkSmartPointer<MVolumeLOD> SetupVolumeLOD(vtkVolume* volume, vtkRenderer* renderer,
+                                               vtkRenderWindowInteractor* interactor, double budget = 1.0 / 15)
+    {
+        auto lod = vtkSmartPointer<MVolumeLOD>::New();
+        lod->Setup(volume, renderer, interactor, budget);
+        return lod;
+    }
+} // namespace
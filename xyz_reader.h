@@ -0,0 +1,240 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkNew.h>
+#include <vtkFloatArray.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // read only view of a whole file, mapped instead of read so the parser works on the page cache directly;
+    // copy_on_write maps it writable, writes stay private to the process and never reach the file
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile const&) = delete;
+        ~MappedFile() { Close(); }
+
+        bool Open(const char* file_name, bool copy_on_write = false)
+        {
+            Close();
+#ifdef _WIN32
+            m_file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                 FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(m_file, &size)) return false;
+            m_size = static_cast<size_t>(size.QuadPart);
+            if (m_size == 0) return true;
+            m_mapping =
+                CreateFileMappingA(m_file, nullptr, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+            if (!m_mapping) return false;
+            m_data =
+                static_cast<char*>(MapViewOfFile(m_mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+            return m_data != nullptr;
+#else
+            m_file = open(file_name, O_RDONLY);
+            if (m_file < 0) return false;
+            struct stat st;
+            if (fstat(m_file, &st) != 0) return false;
+            m_size = static_cast<size_t>(st.st_size);
+            if (m_size == 0) return true;
+            auto const protection = copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ;
+            auto* data = mmap(nullptr, m_size, protection, MAP_PRIVATE, m_file, 0);
+            if (data == MAP_FAILED) return false;
+            madvise(data, m_size, MADV_SEQUENTIAL);
+            m_data = static_cast<char*>(data);
+            return true;
+#endif
+        }
+
+        void Close()
+        {
+#ifdef _WIN32
+            if (m_data) UnmapViewOfFile(m_data);
+            if (m_mapping) CloseHandle(m_mapping);
+            if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+            m_mapping = nullptr;
+            m_file = INVALID_HANDLE_VALUE;
+#else
+            if (m_data) munmap(m_data, m_size);
+            if (m_file >= 0) close(m_file);
+            m_file = -1;
+#endif
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+        const char* GetData() const { return m_data; }
+
+        // only to be written when opened copy_on_write
+        char* GetWritableData() { return m_data; }
+
+        size_t GetSize() const { return m_size; }
+
+    private:
+#ifdef _WIN32
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#else
+        int m_file = -1;
+#endif
+        char* m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+    // x y z of one line into xyz, separated by spaces, tabs, commas or semicolons, extra columns ignored;
+    // false for header, blank or malformed lines
+    bool ParseXYZLine(const char* begin, const char* end, float xyz[3])
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == ',' || *begin == ';' || *begin == '\r'))
+                begin++;
+            auto const [ptr, ec] = std::from_chars(begin, end, xyz[i]);
+            if (ec != std::errc()) return false;
+            begin = ptr;
+        }
+        return true;
+    }
+
+    // offsets of chunks + 1 boundaries splitting data into about equal chunks of whole lines
+    std::vector<size_t> SplitLines(const char* data, size_t size, size_t chunks)
+    {
+        std::vector<size_t> starts(chunks + 1, size);
+        starts[0] = 0;
+        for (size_t c = 1; c < chunks; c++)
+        {
+            auto const nominal = std::max(size * c / chunks, starts[c - 1]);
+            auto const* eol = static_cast<const char*>(std::memchr(data + nominal, '\n', size - nominal));
+            starts[c] = eol ? static_cast<size_t>(eol - data) + 1 : size;
+        }
+        return starts;
+    }
+
+    // Point cloud of a text file with one "x y z" per line (the .xyz height data of gen_mesh), nullptr when the
+    // file cannot be opened.
+    // The mapped file is split into newline aligned chunks. A first parallel pass counts the lines of every chunk,
+    // which sizes the float array once and gives every chunk its slot; the second pass parses the chunks in
+    // parallel with std::from_chars straight into their slots. Lines that do not parse are dropped and the slots
+    // closed up afterwards.
+    vtkSmartPointer<vtkPoints> ReadXYZPoints(const char* file_name)
+    {
+        MappedFile file;
+        if (!file.Open(file_name)) return nullptr;
+        auto const* data = file.GetData();
+        auto const size = file.GetSize();
+
+        // a few chunks per thread for load balance, at least 1 MB each
+        constexpr size_t min_chunk = 1 << 20;
+        auto const chunks = std::max<size_t>(
+            std::min<size_t>(size / min_chunk, static_cast<size_t>(vtkSMPTools::GetEstimatedNumberOfThreads()) * 4),
+            1);
+        auto const starts = SplitLines(data, size, chunks);
+
+        std::vector<vtkIdType> lines(chunks + 1, 0);
+        vtkSMPTools::For(0, static_cast<vtkIdType>(chunks), 1, [&](vtkIdType begin, vtkIdType end) {
+            for (auto c = begin; c < end; c++)
+            {
+                auto const* first = data + starts[c];
+                auto const* last = data + starts[c + 1];
+                lines[c + 1] = std::count(first, last, '\n') + (last > first && last[-1] != '\n' ? 1 : 0);
+            }
+        });
+        for (size_t c = 0; c < chunks; c++)
+            lines[c + 1] += lines[c];
+
+        vtkNew<vtkFloatArray> coords;
+        coords->SetNumberOfComponents(3);
+        coords->SetNumberOfTuples(lines[chunks]);
+        auto* values = coords->GetPointer(0);
+        std::vector<vtkIdType> parsed(chunks, 0);
+        vtkSMPTools::For(0, static_cast<vtkIdType>(chunks), 1, [&](vtkIdType begin, vtkIdType end) {
+            for (auto c = begin; c < end; c++)
+            {
+                auto* out = values + lines[c] * 3;
+                auto const* line = data + starts[c];
+                auto const* last = data + starts[c + 1];
+                vtkIdType count = 0;
+                while (line < last)
+                {
+                    auto const* eol = static_cast<const char*>(std::memchr(line, '\n', last - line));
+                    if (!eol) eol = last;
+                    if (ParseXYZLine(line, eol, out + count * 3)) count++;
+                    line = eol + 1;
+                }
+                parsed[c] = count;
+            }
+        });
+
+        vtkIdType count = 0;
+        for (size_t c = 0; c < chunks; c++)
+        {
+            if (count != lines[c])
+                std::memmove(values + count * 3, values + lines[c] * 3, parsed[c] * 3 * sizeof(float));
+            count += parsed[c];
+        }
+        coords->SetNumberOfTuples(count);
+
+        auto points = vtkSmartPointer<vtkPoints>::New();
+        points->SetData(coords);
+        return points;
+    }
+
+    // Parse a text file like ReadXYZPoints without holding its points: the mapped file is parsed in chunks of about
+    // chunk_size bytes on the vtkSMPTools threads and callback(float const* xyz, vtkIdType count) receives the
+    // points of every chunk, concurrently from several threads. Memory is a chunk of floats per thread, however
+    // large the file. false when the file cannot be opened.
+    template <typename Callback>
+    bool StreamXYZPoints(const char* file_name, Callback&& callback, size_t chunk_size = 16 << 20)
+    {
+        MappedFile file;
+        if (!file.Open(file_name)) return false;
+        auto const* data = file.GetData();
+        auto const size = file.GetSize();
+        auto const chunks = std::max<size_t>(size / std::max<size_t>(chunk_size, 1), 1);
+        auto const starts = SplitLines(data, size, chunks);
+
+        vtkSMPThreadLocal<std::vector<float>> buffers;
+        vtkSMPTools::For(0, static_cast<vtkIdType>(chunks), 1, [&](vtkIdType begin, vtkIdType end) {
+            auto& xyz = buffers.Local();
+            for (auto c = begin; c < end; c++)
+            {
+                xyz.clear();
+                auto const* line = data + starts[c];
+                auto const* last = data + starts[c + 1];
+                float p[3];
+                while (line < last)
+                {
+                    auto const* eol = static_cast<const char*>(std::memchr(line, '\n', last - line));
+                    if (!eol) eol = last;
+                    if (ParseXYZLine(line, eol, p)) xyz.insert(xyz.end(), p, p + 3);
+                    line = eol + 1;
+                }
+                if (!xyz.empty()) callback(xyz.data(), static_cast<vtkIdType>(xyz.size() / 3));
+            }
+        });
+        return true;
+    }
+} // namespace